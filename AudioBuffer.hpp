@@ -0,0 +1,145 @@
+/*******************************************************************************
+ *
+ * Multichannel audio buffer with cache-line aligned, padded storage.
+ *
+ * The buffer holds its channels either planar, i.e., one vector per
+ * channel, or interleaved, i.e., one vector of frames, and hands them to
+ * the processing classes through lightweight views. Every planar channel
+ * and the interleaved vector start on a 64-byte boundary, and their
+ * lengths are padded to a multiple of 64 bytes, hence vector loads and
+ * stores never straddle a cache line at the start of a channel, two
+ * channels never share a cache line, e.g., when processed by different
+ * threads, and full vectors at the end of a channel stay within the
+ * allocation. The padding is zeroed on allocation.
+ *
+ * The views promise the alignment to the kernels, which can then tell the
+ * compiler through AssumeAligned; raw pointers carry no such promise and
+ * take the unaligned path.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+#include <algorithm>
+
+static const size_t audioAlignment = 64;
+
+/* Returns the pointer, telling the compiler that it is aligned to
+ * audioAlignment bytes when aligned is true. */
+template<bool aligned, typename T>
+static inline T* AssumeAligned(T* p) {
+#if defined(__GNUC__)
+    return aligned ? static_cast<T*>(__builtin_assume_aligned(p, audioAlignment)) : p;
+#else
+    return p;
+#endif
+}
+
+/* Planar channels of an AudioBuffer, each aligned to audioAlignment bytes
+ * and padded. */
+template<typename sample>
+struct AudioPlanarView {
+    sample* const* channels;
+    size_t numberOfChannels;
+    size_t frames;
+};
+
+/* Interleaved frames of an AudioBuffer, aligned to audioAlignment bytes
+ * and padded. */
+template<typename sample>
+struct AudioInterleavedView {
+    sample* data;
+    size_t numberOfChannels;
+    size_t frames;
+};
+
+template<typename sample>
+class AudioBuffer {
+    public:
+        enum Layout { planar, interleaved };
+
+    private:
+        Layout layout = planar;
+        size_t numberOfChannels = 0;
+        size_t frames = 0;
+        size_t channelLen = 0; // Padded length of each planar channel, or of the interleaved vector.
+        sample* data = nullptr;
+        std::vector<sample*> channels;
+
+        void Free() {
+            std::free(data);
+            data = nullptr;
+        };
+
+    public:
+        void Resize(size_t _numberOfChannels, size_t _frames, Layout _layout = planar);
+        void Clear();
+        Layout GetLayout() const { return layout; };
+        size_t GetNumberOfChannels() const { return numberOfChannels; };
+        size_t GetFrames() const { return frames; };
+        size_t GetPaddedLen() const { return channelLen; };
+        sample* GetChannel(size_t channel) { return channels[channel]; };
+        sample* GetData() { return data; };
+        sample* const* GetChannels() { return channels.data(); };
+
+        /* The views of the other layout are empty. */
+        AudioPlanarView<sample> Planar() {
+            AudioPlanarView<sample> view = { channels.data(), layout == planar ? numberOfChannels : 0,
+                layout == planar ? frames : 0 };
+            return view;
+        };
+        AudioInterleavedView<sample> Interleaved() {
+            AudioInterleavedView<sample> view = { layout == interleaved ? data : nullptr,
+                layout == interleaved ? numberOfChannels : 0, layout == interleaved ? frames : 0 };
+            return view;
+        };
+        AudioBuffer() { };
+        AudioBuffer(size_t _numberOfChannels, size_t _frames, Layout _layout = planar) {
+            Resize(_numberOfChannels, _frames, _layout);
+        };
+        AudioBuffer(const AudioBuffer&) = delete;
+        AudioBuffer& operator=(const AudioBuffer&) = delete;
+        ~AudioBuffer() { Free(); };
+};
+
+/* Allocates the buffer, whose contents are zeroed. Not real-time safe. */
+template<typename sample>
+void AudioBuffer<sample>::Resize(size_t _numberOfChannels, size_t _frames, Layout _layout) {
+    static_assert(audioAlignment % sizeof(sample) == 0 || sizeof(sample) % 2 == 1,
+        "The sample size must divide the alignment or be odd, e.g., packed 24-bit samples.");
+    Free();
+    layout = _layout;
+    numberOfChannels = _numberOfChannels;
+    frames = _frames;
+    size_t samples = layout == planar ? frames : frames * numberOfChannels;
+    size_t vectors = layout == planar ? numberOfChannels : 1;
+
+    /* The padded length is a multiple of the samples in 64 bytes, i.e.,
+     * of 64 samples for odd sample sizes. */
+    size_t step = sizeof(sample) % 2 == 1 ? audioAlignment : audioAlignment / sizeof(sample);
+    channelLen = (samples + step - 1) / step * step;
+    size_t bytes = std::max<size_t>(audioAlignment, vectors * channelLen * sizeof(sample));
+    data = static_cast<sample*>(std::aligned_alloc(audioAlignment, bytes));
+    if (data == nullptr) {
+        throw std::bad_alloc();
+    }
+    std::memset(static_cast<void*>(data), 0, bytes);
+    channels.assign(numberOfChannels, nullptr);
+    for (size_t c = 0; c < numberOfChannels; c++) {
+        channels[c] = layout == planar ? data + c * channelLen : data + c;
+    }
+}
+
+template<typename sample>
+void AudioBuffer<sample>::Clear() {
+    size_t vectors = layout == planar ? numberOfChannels : 1;
+    std::memset(static_cast<void*>(data), 0, vectors * channelLen * sizeof(sample));
+}
@@ -0,0 +1,207 @@
+/*******************************************************************************
+ *
+ * Binary dump of signals for offline analysis (POSIX, little-endian hosts).
+ *
+ * The BinaryDump class writes rows of one sample per column, e.g., the
+ * input, output, gain, and detection envelopes of a limiter, either as a
+ * NumPy .npy file, i.e., a 128-byte header describing the type and the
+ * shape followed by the rows, which numpy.load reads directly, or as raw
+ * samples with no header. The rows are gathered in a large buffer and
+ * written with few system calls, so that dumping long renders costs about
+ * as much as copying them, unlike formatted text. The header is written
+ * when the file is opened and updated with the final number of rows when
+ * it is closed.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "BinaryDump writes little-endian files.");
+
+/* NumPy type descriptors. */
+template<typename T>
+struct NpyType;
+template<>
+struct NpyType<float> { static const char* Descr() { return "<f4"; }; };
+template<>
+struct NpyType<double> { static const char* Descr() { return "<f8"; }; };
+template<>
+struct NpyType<int16_t> { static const char* Descr() { return "<i2"; }; };
+template<>
+struct NpyType<int32_t> { static const char* Descr() { return "<i4"; }; };
+
+template<typename T>
+class BinaryDump {
+    public:
+        enum Format { npy, raw };
+        static const size_t headerLen = 128;
+
+    private:
+        int fd = -1;
+        Format format = npy;
+        size_t numberOfColumns = 0;
+        size_t rows = 0;
+        bool failed = false;
+        std::vector<T> buffer;
+        size_t filled = 0; // Samples in the buffer.
+
+        bool WriteAll(const void* data, size_t len);
+        bool WriteHeader();
+        void Flush();
+
+    public:
+        bool Open(const char* path, size_t _numberOfColumns, Format _format = npy,
+            size_t bufferBytes = size_t(1) << 22);
+        void Write(const T* const* columns, size_t frames);
+        void WriteRows(const T* data, size_t frames);
+        bool Close();
+        size_t GetRows() const { return rows; };
+        bool Failed() const { return failed; };
+        BinaryDump() { };
+        BinaryDump(const BinaryDump&) = delete;
+        BinaryDump& operator=(const BinaryDump&) = delete;
+        ~BinaryDump() { Close(); };
+};
+
+template<typename T>
+const size_t BinaryDump<T>::headerLen;
+
+template<typename T>
+bool BinaryDump<T>::WriteAll(const void* data, size_t len) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    size_t written = 0;
+    while (written < len) {
+        ssize_t result = write(fd, bytes + written, len - written);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return false;
+        }
+        written += size_t(result);
+    }
+    return true;
+}
+
+/* Version 1.0 header, padded with spaces to headerLen bytes, which leaves
+ * room for any shape and keeps the data aligned. */
+template<typename T>
+bool BinaryDump<T>::WriteHeader() {
+    char header[headerLen];
+    std::memset(header, ' ', headerLen);
+    std::memcpy(header, "\x93NUMPY\x01\x00", 8);
+    uint16_t dictLen = uint16_t(headerLen - 10);
+    header[8] = char(dictLen & 0xFF);
+    header[9] = char(dictLen >> 8);
+    int len = std::snprintf(header + 10, headerLen - 10,
+        "{'descr': '%s', 'fortran_order': False, 'shape': (%zu, %zu), }",
+        NpyType<T>::Descr(), rows, numberOfColumns);
+    header[10 + len] = ' ';
+    header[headerLen - 1] = '\n';
+    return pwrite(fd, header, headerLen, 0) == ssize_t(headerLen);
+}
+
+template<typename T>
+void BinaryDump<T>::Flush() {
+    if (filled > 0 && !WriteAll(buffer.data(), filled * sizeof(T))) {
+        failed = true;
+    }
+    filled = 0;
+}
+
+/* Creates or truncates the file. Not real-time safe. */
+template<typename T>
+bool BinaryDump<T>::Open(const char* path, size_t _numberOfColumns, Format _format, size_t bufferBytes) {
+    Close();
+    numberOfColumns = std::max<size_t>(1, _numberOfColumns);
+    format = _format;
+    rows = 0;
+    filled = 0;
+    failed = false;
+    size_t rowsPerBuffer = std::max<size_t>(1, bufferBytes / (numberOfColumns * sizeof(T)));
+    buffer.assign(rowsPerBuffer * numberOfColumns, T(0));
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        failed = true;
+        return false;
+    }
+    if (format == npy) {
+        failed = !WriteHeader() || lseek(fd, off_t(headerLen), SEEK_SET) != off_t(headerLen);
+    }
+    return !failed;
+}
+
+/* Appends frames rows, given one vector per column. */
+template<typename T>
+void BinaryDump<T>::Write(const T* const* columns, size_t frames) {
+    if (fd < 0) {
+        return;
+    }
+    size_t done = 0;
+    while (done < frames) {
+        size_t len = std::min(frames - done, (buffer.size() - filled) / numberOfColumns);
+        T* out = buffer.data() + filled;
+        for (size_t c = 0; c < numberOfColumns; c++) {
+            const T* in = columns[c] + done;
+            for (size_t n = 0; n < len; n++) {
+                out[n * numberOfColumns + c] = in[n];
+            }
+        }
+        filled += len * numberOfColumns;
+        done += len;
+        if (filled + numberOfColumns > buffer.size()) {
+            Flush();
+        }
+    }
+    rows += frames;
+}
+
+/* Appends frames rows that are already interleaved; large blocks bypass the
+ * buffer. */
+template<typename T>
+void BinaryDump<T>::WriteRows(const T* data, size_t frames) {
+    if (fd < 0) {
+        return;
+    }
+    size_t len = frames * numberOfColumns;
+    if (filled + len > buffer.size()) {
+        Flush();
+    }
+    if (len > buffer.size()) {
+        failed = failed || !WriteAll(data, len * sizeof(T));
+    } else {
+        std::copy(data, data + len, buffer.data() + filled);
+        filled += len;
+    }
+    rows += frames;
+}
+
+/* Writes the remaining rows and the final header, and returns false if any
+ * write failed. */
+template<typename T>
+bool BinaryDump<T>::Close() {
+    if (fd < 0) {
+        return !failed;
+    }
+    Flush();
+    if (format == npy && !WriteHeader()) {
+        failed = true;
+    }
+    if (close(fd) != 0) {
+        failed = true;
+    }
+    fd = -1;
+    return !failed;
+}
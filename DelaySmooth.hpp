@@ -2,14 +2,34 @@
  *
  * Mono-input, mono-output delay line with an efficient wrap-around method.
  * The reading and writing heads use fixed-width unsigned int types, 
- * which can overflow safely. The limitation of this design is that buffers 
- * allocation is limited to 2^8, 2^16, 2^32, or 2^64 elements. Of course,
- * only the first two sizes are feasible, hence this technique is convenient
- * for delays that are 256 or 65536 samples maximum.
+ * which can overflow safely. The buffers have a power-of-two length that 
+ * divides the range of the head type, so that the heads are mapped onto 
+ * the buffers with a mask. By default, the length is the range of the head
+ * type up to 65536 samples; with wider heads, e.g., uint32_t, SetMaxDelay 
+ * sizes the buffers to the smallest power of two holding the maximum delay,
+ * which is also useful to shrink the buffers for short delays.
  *
  * The delay line uses two parallel delay lines among which crossfade takes 
  * place for click-free and Doppler-free delay variations.
  *
+ * Alternatively, ProcessView applies the same delay lines to input kept by
+ * the caller, e.g., a host's own ring of previous blocks, without writing
+ * to or needing the internal buffers.
+ *
+ * For building other processes on top of the buffers, e.g., multi-tap 
+ * delays or analysis, Write stores a block in the buffers and ReadSpan 
+ * returns the delayed block as at most two contiguous spans into them,
+ * without copying.
+ *
+ * The buffers can store the signals with a type other than the processing
+ * type, e.g., float for double processing, or 16-bit and packed 24-bit 
+ * integers for fixed-point sources, which reduces the memory footprint and
+ * bandwidth of the delay line. Integer storage covers the range [-1; 1) 
+ * and saturates outside it.
+ *
+ * The allocator of the buffers is a template parameter, e.g., 
+ * HugePageAllocator in HugePages.hpp for large banks of delay lines.
+ *
  * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
  *
  * ****************************************************************************/
@@ -17,17 +37,65 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
 #include <cmath>
 #include <vector>
+#include <memory>
 #include <algorithm>
+#include "Numerics.hpp"
+#include "Pcm.hpp" // Int24.
+
+/* Conversion between the processing type and the storage type of the 
+ * delay buffers. The conversions are simple enough to be vectorised in the
+ * block loops. */
+template<typename real, typename storage>
+struct DelayStorage {
+    static const bool fixedPoint = false;
+    static storage Store(real x) { return storage(x); };
+    static real Load(storage x) { return real(x); };
+};
 
-template<typename head, typename real>
+template<typename real>
+struct DelayStorage<real, int16_t> {
+    static const bool fixedPoint = true;
+    static int16_t Store(real x) {
+        real v = std::max<real>(-32768.0, std::min<real>(32767.0, x * real(32768.0)));
+        return int16_t(std::floor(v + real(.5)));
+    };
+    static real Load(int16_t x) { return real(x) * real(1.0 / 32768.0); };
+};
+
+template<typename real>
+struct DelayStorage<real, Int24> {
+    static const bool fixedPoint = true;
+    static Int24 Store(real x) {
+        real v = std::max<real>(-8388608.0, std::min<real>(8388607.0, x * real(8388608.0)));
+        int32_t i = int32_t(std::floor(v + real(.5)));
+        Int24 y = { { uint8_t(i), uint8_t(i >> 8), uint8_t(i >> 16) } };
+        return y;
+    };
+    static real Load(Int24 x) {
+        int32_t i = int32_t(uint32_t(x.bytes[0]) << 8 | uint32_t(x.bytes[1]) << 16 | 
+            uint32_t(x.bytes[2]) << 24) >> 8;
+        return real(i) * real(1.0 / 8388608.0);
+    };
+};
+
+template<typename head, typename real, typename storage = real, typename allocator = std::allocator<storage>, 
+    typename numerics = StrictNumerics>
 class DelaySmooth {
     
+    static_assert(numerics::available, "Strict numerics are not available with -ffast-math.");
+    
     private:
-        /* Compute the buffer size as the largest representable 
-         * int with a head-type variable. */
-        const size_t bufferLen = 2l << (8 * sizeof(head) - 1);
+        /* The largest buffer size is the range of the head type; the 
+         * default size is capped at 65536 samples. */
+        static size_t HeadRange() {
+            return sizeof(head) >= sizeof(size_t) ? 
+                ~size_t(0) : size_t(1) << (8 * sizeof(head));
+        };
+        size_t bufferLen = std::min<size_t>(HeadRange(), 65536);
+        size_t mask = bufferLen - 1;
 
         size_t delay = 0; // System output delay in samples.
         size_t interpolationTime = 1024; // Interpolation time in samples.
@@ -37,27 +105,84 @@ class DelaySmooth {
         real interpolationStep = 1.0 / real(interpolationTime); // Interpolation segment slope.
         real increment = interpolationStep; // Helper var for interpolation coefficient calculation.
         
-        /* Reading and writing heads. These will cycle continuously from 0
-         * to bufferLen - 1. The reading heads will be offset appropriately
-         * to set the delay. */
+        /* Reading and writing heads. These will cycle continuously over the
+         * range of the head type and they are masked to index the buffers. 
+         * The reading heads will be offset appropriately to set the delay. */
         head lowerReadPtr = 0;
         head upperReadPtr = 0;
         head writePtr = 0;
     
-        std::vector<real> bufferLeft;
-        std::vector<real> bufferRight;
+        typedef std::vector<storage, allocator> Buffer;
+        Buffer bufferLeft;
+        Buffer bufferRight;
+
+        void Step();
 
     public:
+        /* Delayed block as at most two contiguous runs of samples in a 
+         * buffer: len[0] samples at data[0] followed by len[1] samples at
+         * data[1]. */
+        struct Span {
+            const storage* data[2];
+            size_t len[2];
+        };
+        typedef DelayStorage<real, storage> Storage;
+
         void SetDelay(size_t _delay) { delay = _delay; };
+        size_t GetDelay() const { return delay; };
+        size_t GetBufferLen() const { return bufferLen; };
+
+        /* Buffer length that SetMaxDelay chooses for the given delay. */
+        static size_t GetBufferLenFor(size_t maxDelay) {
+            size_t len = 1;
+            while (len <= maxDelay && len < HeadRange() / 2 + 1) {
+                len <<= 1;
+            }
+            return std::min(len, HeadRange());
+        };
+
+        /* Resizes and clears the buffers to hold delays of up to maxDelay 
+         * samples, not to be called while processing. */
+        void SetMaxDelay(size_t maxDelay) {
+            bufferLen = GetBufferLenFor(maxDelay);
+            mask = bufferLen - 1;
+            if (!bufferLeft.empty()) {
+                AllocateBuffers(true);
+            }
+        };
+
+        /* True when no crossfade is active or pending, in which case 
+         * Process is equivalent to Write followed by ReadSpan with the 
+         * current delay. */
+        bool IsSteady() const {
+            return lowerDelay == delay && upperDelay == delay &&
+                ((interpolation == 1.0 && increment >= 0.0) || 
+                    (interpolation == 0.0 && increment <= 0.0));
+        };
+        void Write(const real* const* xVec, size_t vecLen);
+        Span ReadSpan(size_t channel, size_t _delay, size_t vecLen) const;
         void SetInterpolationTime(size_t _interpolationTime) {
             interpolationTime = std::max<size_t>(1, _interpolationTime);
             interpolationStep = 1.0 / real(interpolationTime);
         };
         void Reset() {
-            std::fill(bufferLeft.begin(), bufferLeft.end(), .0);
-            std::fill(bufferRight.begin(), bufferRight.end(), .0);
+            std::fill(bufferLeft.begin(), bufferLeft.end(), Storage::Store(0.0));
+            std::fill(bufferRight.begin(), bufferRight.end(), Storage::Store(0.0));
         };
         void Process(real** xVec, real** yVec, size_t vecLen);
+        void ProcessView(const real* const* historyVec, size_t historyLen, 
+            const real* const* xVec, size_t offset, real** yVec, size_t vecLen);
+
+        /* The buffers can be released when only ProcessView is used, and 
+         * they must be allocated again before Process is called. */
+        void AllocateBuffers(bool allocate) {
+            Buffer().swap(bufferLeft);
+            Buffer().swap(bufferRight);
+            if (allocate) {
+                bufferLeft.resize(bufferLen);
+                bufferRight.resize(bufferLen);
+            }
+        };
         DelaySmooth() {
             bufferLeft.resize(bufferLen);
             bufferRight.resize(bufferLen);
@@ -65,13 +190,71 @@ class DelaySmooth {
         DelaySmooth(size_t _delay, size_t _interpolationTime);
 };
 
+/* This function advances the crossfade between the two delay lines by one 
+ * sample. It is shared by the ring-buffer and the history-view processing. */
+template<typename head, typename real, typename storage, typename allocator, typename numerics>
+inline void DelaySmooth<head, real, storage, allocator, numerics>::Step() {
+
+    /* Compute the necessary Boolean conditions to trigger a new
+     * interpolation and set a new delay or interpolation time. 
+     * The mechanism for smooth delay variations works by linearly
+     * interpolating from the currently active delay line to the
+     * inactive one, which is set with the new delay. Note that a new delay 
+     * or interpolation time can be set only after the transition has been 
+     * completed. */
+    bool lowerReach = interpolation == 0.0;
+    bool upperReach = interpolation == 1.0;
+    bool lowerDelayChanged = delay != lowerDelay;
+    bool upperDelayChanged = delay != upperDelay;
+    bool startDownwardInterp = upperReach && upperDelayChanged;
+    bool startUpwardInterp = lowerReach && lowerDelayChanged;
+
+    /* Following a branchless programming paradigm, we compute the paths 
+     * for the variables with bifurcation and assign the results using
+     * Boolean array-fetching, which is faster than two multiplications 
+     * by bools. 
+     * 
+     * If we have completed an upward interpolation and the delay has 
+     * changed, we assign a negative incremental step to trigger a
+     * downward interpolation; alternatively, if we are at the bottom 
+     * edge and the delay has changed, we assign a positive incremental 
+     * step; otherwise, we leave the incremental step unaltered. 
+     *
+     * The delay is set to whatever delay line becomes inactive after
+     * completing the interpolation. Otherwise, it stays unaltered
+     * during the transition. */
+    real incrementPathsUp[2] = {
+        increment, 
+        interpolationStep
+    };
+    real incrementPathsDown[2] = {
+        incrementPathsUp[startUpwardInterp], 
+        -interpolationStep
+    };
+    increment = incrementPathsDown[startDownwardInterp];
+    size_t lowerDelayPaths[2] = {
+        lowerDelay, 
+        delay
+    };
+    size_t upperDelayPaths[2] = {
+        upperDelay, 
+        delay
+    };
+    lowerDelay = lowerDelayPaths[upperReach];
+    upperDelay = upperDelayPaths[lowerReach];
+
+    /* Compute the interpolation coefficient for the current sample. */
+    interpolation = 
+        std::max<real>(0.0, std::min<real>(1.0, interpolation + increment));
+}
+
 /* This function computes a click-free and Doppler-free variable delay line
  * by linearly crossfading between two independent integer delay lines.
  * Once a crossfade has been completed, the inactive delay line can be
  * set with a new delay and a new crossafed can start. During the crossfade,
  * neither the delay or interpolation time can be changed. */
-template<typename head, typename real>
-void DelaySmooth<head, real>::Process(real** xVec, real** yVec, size_t vecLen) {
+template<typename head, typename real, typename storage, typename allocator, typename numerics>
+void DelaySmooth<head, real, storage, allocator, numerics>::Process(real** xVec, real** yVec, size_t vecLen) {
     for (size_t n = 0; n < vecLen; n++) { // Level-0 for-loop.
         real* xLeft = xVec[0];
         real* xRight = xVec[1];
@@ -79,77 +262,125 @@ void DelaySmooth<head, real>::Process(real** xVec, real** yVec, size_t vecLen) {
         real* yRight = yVec[1];
 
         /* Fill the delay buffers with the input signals. */
-        bufferLeft[writePtr] = xLeft[n];
-        bufferRight[writePtr] = xRight[n];
-
-        /* Compute the necessary Boolean conditions to trigger a new
-         * interpolation and set a new delay or interpolation time. 
-         * The mechanism for smooth delay variations works by linearly
-         * interpolating from the currently active delay line to the
-         * inactive one, which is set with the new delay. Note that a new delay 
-         * or interpolation time can be set only after the transition has been 
-         * completed. */
-        bool lowerReach = interpolation == 0.0;
-        bool upperReach = interpolation == 1.0;
-        bool lowerDelayChanged = delay != lowerDelay;
-        bool upperDelayChanged = delay != upperDelay;
-        bool startDownwardInterp = upperReach && upperDelayChanged;
-        bool startUpwardInterp = lowerReach && lowerDelayChanged;
-
-        /* Following a branchless programming paradigm, we compute the paths 
-         * for the variables with bifurcation and assign the results using
-         * Boolean array-fetching, which is faster than two multiplications 
-         * by bools. 
-         * 
-         * If we have completed an upward interpolation and the delay has 
-         * changed, we assign a negative incremental step to trigger a
-         * downward interpolation; alternatively, if we are at the bottom 
-         * edge and the delay has changed, we assign a positive incremental 
-         * step; otherwise, we leave the incremental step unaltered. 
-         *
-         * The delay is set to whatever delay line becomes inactive after
-         * completing the interpolation. Otherwise, it stays unaltered
-         * during the transition. */
-        real incrementPathsUp[2] = {
-            increment, 
-            interpolationStep
-        };
-        real incrementPathsDown[2] = {
-            incrementPathsUp[startUpwardInterp], 
-            -interpolationStep
-        };
-        increment = incrementPathsDown[startDownwardInterp];
-        size_t lowerDelayPaths[2] = {
-            lowerDelay, 
-            delay
-        };
-        size_t upperDelayPaths[2] = {
-            upperDelay, 
-            delay
-        };
-        lowerDelay = lowerDelayPaths[upperReach];
-        upperDelay = upperDelayPaths[lowerReach];
+        bufferLeft[writePtr & mask] = Storage::Store(xLeft[n]);
+        bufferRight[writePtr & mask] = Storage::Store(xRight[n]);
+
+        Step();
 
         /* Compute the delays reading heads and increment the writing head. */
         lowerReadPtr = writePtr - lowerDelay;
         upperReadPtr = writePtr - upperDelay;
         writePtr++;
 
-        /* Compute the interpolation and assign the result to the output. */
-        interpolation = 
-            std::max<real>(0.0, std::min<real>(1.0, interpolation + increment));
-        yLeft[n] = interpolation * 
-            (bufferLeft[upperReadPtr] - bufferLeft[lowerReadPtr]) +
-                bufferLeft[lowerReadPtr];
-        yRight[n] = interpolation * 
-            (bufferRight[upperReadPtr] - bufferRight[lowerReadPtr]) +
-                bufferRight[lowerReadPtr];
+        /* Assign the interpolated delay lines to the output. */
+        real lowerLeft = Storage::Load(bufferLeft[lowerReadPtr & mask]);
+        real lowerRight = Storage::Load(bufferRight[lowerReadPtr & mask]);
+        yLeft[n] = numerics::MulAdd(interpolation, 
+            Storage::Load(bufferLeft[upperReadPtr & mask]) - lowerLeft, lowerLeft);
+        yRight[n] = numerics::MulAdd(interpolation, 
+            Storage::Load(bufferRight[upperReadPtr & mask]) - lowerRight, lowerRight);
 
     } // End of level-0 for-loop.
 }
 
-template<typename head, typename real>
-DelaySmooth<head, real>::DelaySmooth(size_t _delay, size_t _interpolationTime) {
+/* This function computes the same crossfading delay lines as Process, but 
+ * it reads the delayed samples from signals kept by the caller instead of 
+ * the internal buffers, which are neither written nor needed. xVec points to
+ * the current input block, of which the vecLen samples starting at offset are
+ * processed, and historyVec points to the historyLen input samples preceding
+ * the current block, i.e., historyVec[c][historyLen - 1] precedes
+ * xVec[c][0]. Samples older than the history are read as zeros. The output 
+ * must not overlap with the input or the history. */
+template<typename head, typename real, typename storage, typename allocator, typename numerics>
+void DelaySmooth<head, real, storage, allocator, numerics>::ProcessView(const real* const* historyVec, size_t historyLen, 
+        const real* const* xVec, size_t offset, real** yVec, size_t vecLen) {
+    const ptrdiff_t oldest = -ptrdiff_t(historyLen);
+
+    /* Without an active or pending crossfade, both delay lines read the 
+     * same samples, hence the output is a plain copy of at most two spans. */
+    if (IsSteady()) {
+        ptrdiff_t begin = ptrdiff_t(offset) - ptrdiff_t(delay);
+        ptrdiff_t end = begin + ptrdiff_t(vecLen);
+        for (size_t c = 0; c < 2; c++) {
+            real* y = yVec[c];
+            for (ptrdiff_t position = begin; position < std::min<ptrdiff_t>(end, oldest); position++) {
+                *y++ = 0.0;
+            }
+            ptrdiff_t historyBegin = std::max(begin, oldest);
+            ptrdiff_t historyEnd = std::min<ptrdiff_t>(end, 0);
+            if (historyBegin < historyEnd) {
+                y = std::copy(historyVec[c] + historyLen + historyBegin, 
+                    historyVec[c] + historyLen + historyEnd, y);
+            }
+            ptrdiff_t blockBegin = std::max<ptrdiff_t>(begin, 0);
+            if (blockBegin < end) {
+                std::copy(xVec[c] + blockBegin, xVec[c] + end, y);
+            }
+        }
+        return;
+    }
+
+    /* Non-negative positions are in the current block, negative ones in the
+     * history. */
+    auto Fetch = [&](size_t channel, ptrdiff_t position) -> real {
+        if (position >= 0) {
+            return xVec[channel][position];
+        }
+        return position >= oldest ? historyVec[channel][historyLen + position] : real(0.0);
+    };
+
+    for (size_t n = 0; n < vecLen; n++) {
+        Step();
+        ptrdiff_t position = ptrdiff_t(offset + n);
+        ptrdiff_t lowerPosition = position - ptrdiff_t(lowerDelay);
+        ptrdiff_t upperPosition = position - ptrdiff_t(upperDelay);
+        for (size_t c = 0; c < 2; c++) {
+            real lower = Fetch(c, lowerPosition);
+            yVec[c][n] = numerics::MulAdd(interpolation, Fetch(c, upperPosition) - lower, lower);
+        }
+    }
+}
+
+/* This function stores a block of vecLen samples per channel in the 
+ * buffers, at most bufferLen, and advances the writing head. It does not 
+ * advance the crossfade, hence it should only be mixed with Process in 
+ * steady state. */
+template<typename head, typename real, typename storage, typename allocator, typename numerics>
+void DelaySmooth<head, real, storage, allocator, numerics>::Write(const real* const* xVec, size_t vecLen) {
+    size_t start = size_t(writePtr) & mask;
+    size_t first = std::min(vecLen, bufferLen - start);
+    Buffer* buffers[2] = { &bufferLeft, &bufferRight };
+    for (size_t c = 0; c < 2; c++) {
+        storage* buffer = buffers[c]->data();
+        const real* x = xVec[c];
+        storage* y = buffer + start;
+        for (size_t n = 0; n < first; n++) {
+            y[n] = Storage::Store(x[n]);
+        }
+        for (size_t n = first; n < vecLen; n++) {
+            buffer[n - first] = Storage::Store(x[n]);
+        }
+    }
+    writePtr += vecLen;
+}
+
+/* This function returns the last written vecLen samples of a channel 
+ * delayed by _delay samples, i.e., the samples written _delay + vecLen to 
+ * _delay samples ago, with _delay + vecLen not exceeding bufferLen. The 
+ * spans stay valid until the next write, and their samples are converted 
+ * to the processing type with Storage::Load. */
+template<typename head, typename real, typename storage, typename allocator, typename numerics>
+typename DelaySmooth<head, real, storage, allocator, numerics>::Span DelaySmooth<head, real, storage, allocator, numerics>::ReadSpan(
+        size_t channel, size_t _delay, size_t vecLen) const {
+    const Buffer& buffer = channel == 0 ? bufferLeft : bufferRight;
+    size_t start = size_t(head(writePtr - head(vecLen) - head(_delay))) & mask;
+    size_t first = std::min(vecLen, bufferLen - start);
+    Span span = { { buffer.data() + start, buffer.data() }, { first, vecLen - first } };
+    return span;
+}
+
+template<typename head, typename real, typename storage, typename allocator, typename numerics>
+DelaySmooth<head, real, storage, allocator, numerics>::DelaySmooth(size_t _delay, size_t _interpolationTime) {
     bufferLeft.resize(bufferLen);
     bufferRight.resize(bufferLen);
     delay = _delay;
@@ -0,0 +1,359 @@
+/*******************************************************************************
+ *
+ * Delivery quality control of stereo signals, accumulated while they are
+ * written, e.g., by the final output loop of the Limiter class, so that
+ * deliverables need no second read for checking.
+ *
+ * The class measures the sample peak, the true peak, i.e., the peak of the
+ * signal upsampled by four with the polyphase interpolator of ITU-R
+ * BS.1770-4, Annex 2, and the DC offset of each channel, and it counts
+ * sample overs above a given threshold, e.g., the limiting threshold, true
+ * peaks above a ceiling, and runs of consecutive samples at or above a
+ * clipping level. The measurements run on sub-blocks with vectorisable
+ * loops, the interpolator folding the symmetry of its phases; only the
+ * sub-blocks reaching the threshold, the ceiling, or the clipping level
+ * are scanned sample by sample, and the positions of their violations are
+ * stored, up to a given number, together with the channel and the level or
+ * run length. True-peak positions refer to the sample
+ * preceding the inter-sample peak.
+ *
+ * Integer PCM is measured in full-scale units, see Pcm.hpp.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "Pcm.hpp"
+
+template<typename real>
+class DeliveryQC {
+    public:
+        enum ViolationKind { overViolation, truePeakViolation, clipRunViolation };
+        struct Violation {
+            uint64_t frame; // First frame of clipping runs.
+            uint32_t channel;
+            ViolationKind kind;
+            real value; // Absolute level, or run length for clipping runs.
+        };
+        struct Report {
+            uint64_t frames;
+            real samplePeak[2];
+            real truePeak[2];
+            double dc[2];
+            uint64_t overs;
+            uint64_t truePeakOvers;
+            uint64_t clipRuns;
+            uint64_t longestClipRun;
+            uint64_t droppedViolations; // Violations beyond the stored ones.
+        };
+
+    private:
+        static const size_t phases = 4;
+        static const size_t taps = 12;
+        static const size_t truePeakDelay = 6; // Delay of the interpolator in samples.
+        static const size_t blockLen = 256;
+        static const size_t lanes = 8; // Partial results of the vector loops.
+
+        real truePeakCeiling = 1.0;
+        real clipLevel = real(32767.0 / 32768.0);
+        size_t minClipRun = 3;
+        size_t maxViolations = 1024;
+
+        uint64_t frames = 0;
+        real history[2][taps - 1] = { { 0 } }; // Last samples of each channel, the oldest first.
+        real samplePeak[2] = { 0 };
+        real truePeak[2] = { 0 };
+        double sum[2] = { 0 };
+        uint64_t overs = 0;
+        uint64_t truePeakOvers = 0;
+        uint64_t clipRuns = 0;
+        uint64_t longestClipRun = 0;
+        uint64_t clipRun[2] = { 0 }; // Length of the current run of each channel.
+        uint64_t droppedViolations = 0;
+        std::vector<Violation> violations;
+
+        static real Coeff(size_t phase, size_t tap);
+        void AddViolation(uint64_t frame, size_t channel, ViolationKind kind, real value);
+        void EndClipRun(size_t channel, uint64_t frame);
+        void ProcessChunk(size_t channel, const real* x, size_t vecLen, real threshold);
+
+    public:
+        void SetTruePeakCeiling(real _dBTruePeakCeiling) { truePeakCeiling = std::pow(real(10.0), _dBTruePeakCeiling / real(20.0)); };
+        void SetClipLevel(real _clipLevel) { clipLevel = _clipLevel; };
+        void SetMinClipRun(size_t _minClipRun) { minClipRun = std::max<size_t>(1, _minClipRun); };
+        void SetMaxViolations(size_t _maxViolations);
+        void Reset();
+        template<size_t stride, typename sample>
+        void Process(const sample* yLeft, const sample* yRight, size_t vecLen, real threshold);
+        Report GetReport() const;
+        const std::vector<Violation>& GetViolations() const { return violations; };
+        std::string Summary() const;
+        DeliveryQC() { violations.reserve(maxViolations); };
+};
+
+template<typename real>
+const size_t DeliveryQC<real>::phases;
+template<typename real>
+const size_t DeliveryQC<real>::taps;
+template<typename real>
+const size_t DeliveryQC<real>::truePeakDelay;
+template<typename real>
+const size_t DeliveryQC<real>::blockLen;
+template<typename real>
+const size_t DeliveryQC<real>::lanes;
+
+/* Polyphase coefficients of the true-peak interpolator; phases 2 and 3 are
+ * phases 1 and 0 reversed. */
+template<typename real>
+real DeliveryQC<real>::Coeff(size_t phase, size_t tap) {
+    static const real h[2][taps] = {
+        { 0.0017089843750, 0.0109863281250, -0.0196533203125, 0.0332031250000, -0.0594482421875, 0.1373291015625,
+            0.9721679687500, -0.1022949218750, 0.0476074218750, -0.0266113281250, 0.0148925781250, -0.0083007812500 },
+        { -0.0291748046875, 0.0292968750000, -0.0517578125000, 0.0891113281250, -0.1665039062500, 0.4650878906250,
+            0.7797851562500, -0.2003173828125, 0.1015625000000, -0.0582275390625, 0.0330810546875, -0.0189208984375 }
+    };
+    return phase < 2 ? h[phase][tap] : h[3 - phase][taps - 1 - tap];
+}
+
+/* Violations are stored up to the given number, which is allocated here
+ * rather than while processing. */
+template<typename real>
+void DeliveryQC<real>::SetMaxViolations(size_t _maxViolations) {
+    maxViolations = _maxViolations;
+    violations.reserve(maxViolations);
+}
+
+template<typename real>
+void DeliveryQC<real>::Reset() {
+    frames = 0;
+    for (size_t c = 0; c < 2; c++) {
+        for (size_t k = 0; k < taps - 1; k++) {
+            history[c][k] = real(0.0);
+        }
+        samplePeak[c] = real(0.0);
+        truePeak[c] = real(0.0);
+        sum[c] = .0;
+        clipRun[c] = 0;
+    }
+    overs = 0;
+    truePeakOvers = 0;
+    clipRuns = 0;
+    longestClipRun = 0;
+    droppedViolations = 0;
+    violations.clear();
+}
+
+template<typename real>
+void DeliveryQC<real>::AddViolation(uint64_t frame, size_t channel, ViolationKind kind, real value) {
+    if (violations.size() < maxViolations) {
+        Violation violation = { frame, uint32_t(channel), kind, value };
+        violations.push_back(violation);
+    } else {
+        droppedViolations++;
+    }
+}
+
+/* Closes the current run of a channel, which ends before the given frame. */
+template<typename real>
+void DeliveryQC<real>::EndClipRun(size_t channel, uint64_t frame) {
+    uint64_t len = clipRun[channel];
+    if (len >= minClipRun) {
+        clipRuns++;
+        longestClipRun = std::max(longestClipRun, len);
+        AddViolation(frame - len, channel, clipRunViolation, real(len));
+    }
+    clipRun[channel] = 0;
+}
+
+/* Measures vecLen samples of a channel, at most blockLen, preceded in x by
+ * the taps - 1 previous samples. x holds blockLen samples, and those after
+ * vecLen only pad the interpolation to whole lanes. */
+template<typename real>
+void DeliveryQC<real>::ProcessChunk(size_t channel, const real* x, size_t vecLen, real threshold) {
+    const real* in = x + taps - 1;
+
+    /* Sample peak and sum, with partial results in lanes so that the loop
+     * vectorises without reassociating floating-point operations. */
+    real peakLanes[lanes] = { 0 };
+    real sumLanes[lanes] = { 0 };
+    size_t n = 0;
+    for (; n + lanes <= vecLen; n += lanes) {
+        for (size_t l = 0; l < lanes; l++) {
+            peakLanes[l] = std::max(peakLanes[l], std::fabs(in[n + l]));
+            sumLanes[l] += in[n + l];
+        }
+    }
+    for (; n < vecLen; n++) {
+        peakLanes[0] = std::max(peakLanes[0], std::fabs(in[n]));
+        sumLanes[0] += in[n];
+    }
+    real peak = real(0.0);
+    for (size_t l = 0; l < lanes; l++) {
+        peak = std::max(peak, peakLanes[l]);
+        sum[channel] += double(sumLanes[l]);
+    }
+    samplePeak[channel] = std::max(samplePeak[channel], peak);
+
+    /* True-peak level of each sample, i.e., the largest magnitude of its
+     * four upsampled phases. Phases 3 and 2 are phases 0 and 1 reversed,
+     * so each pair of samples k and taps - 1 - k is folded into its sum and
+     * difference, which accumulate the half sums and half differences of
+     * the two pairs of phases; the phases are their sums and differences,
+     * with two thirds of the operations of four convolutions. The loops run
+     * tap by tap over the whole sub-block, padded to a multiple of lanes,
+     * hence they vectorise without a scalar epilogue. */
+    real folded[phases][blockLen]; // Half sums of phases 0 and 1, then half differences.
+    const size_t padded = (vecLen + lanes - 1) / lanes * lanes;
+    for (size_t p = 0; p < phases; p++) {
+        std::fill(folded[p], folded[p] + padded, real(0.0));
+    }
+    for (size_t k = 0; k < taps / 2; k++) {
+        real halfSum[2];
+        real halfDifference[2];
+        for (size_t p = 0; p < 2; p++) {
+            halfSum[p] = real(0.5) * (Coeff(p, k) + Coeff(p, taps - 1 - k));
+            halfDifference[p] = real(0.5) * (Coeff(p, k) - Coeff(p, taps - 1 - k));
+        }
+        const real* newer = in - k;
+        const real* older = in - (taps - 1 - k);
+        for (n = 0; n < padded; n++) {
+            real pairSum = newer[n] + older[n];
+            real pairDifference = newer[n] - older[n];
+            folded[0][n] += halfSum[0] * pairSum;
+            folded[1][n] += halfSum[1] * pairSum;
+            folded[2][n] += halfDifference[0] * pairDifference;
+            folded[3][n] += halfDifference[1] * pairDifference;
+        }
+    }
+    real level[blockLen];
+    for (n = 0; n < padded; n++) {
+        real sum0 = folded[0][n];
+        real sum1 = folded[1][n];
+        real difference0 = folded[2][n];
+        real difference1 = folded[3][n];
+        real phase0 = std::fabs(sum0 + difference0);
+        real phase1 = std::fabs(sum1 + difference1);
+        real phase2 = std::fabs(sum1 - difference1);
+        real phase3 = std::fabs(sum0 - difference0);
+        level[n] = std::max(std::max(phase0, phase1), std::max(phase2, phase3));
+    }
+    real tpLanes[lanes] = { 0 };
+    for (n = 0; n + lanes <= vecLen; n += lanes) {
+        for (size_t l = 0; l < lanes; l++) {
+            tpLanes[l] = std::max(tpLanes[l], level[n + l]);
+        }
+    }
+    for (; n < vecLen; n++) {
+        tpLanes[0] = std::max(tpLanes[0], level[n]);
+    }
+    real tp = real(0.0);
+    for (size_t l = 0; l < lanes; l++) {
+        tp = std::max(tp, tpLanes[l]);
+    }
+    truePeak[channel] = std::max(truePeak[channel], tp);
+
+    /* Sample-by-sample scans, only for the sub-blocks that need them. */
+    if (peak > threshold) {
+        for (n = 0; n < vecLen; n++) {
+            if (std::fabs(in[n]) > threshold) {
+                overs++;
+                AddViolation(frames + n, channel, overViolation, std::fabs(in[n]));
+            }
+        }
+    }
+    if (tp > truePeakCeiling) {
+        for (n = 0; n < vecLen; n++) {
+            if (level[n] > truePeakCeiling) {
+                truePeakOvers++;
+                uint64_t frame = frames + n;
+                AddViolation(frame > truePeakDelay ? frame - truePeakDelay : 0, channel, truePeakViolation, level[n]);
+            }
+        }
+    }
+    if (peak >= clipLevel) {
+        for (n = 0; n < vecLen; n++) {
+            if (std::fabs(in[n]) >= clipLevel) {
+                clipRun[channel]++;
+            } else if (clipRun[channel] > 0) {
+                EndClipRun(channel, frames + n);
+            }
+        }
+    } else if (clipRun[channel] > 0) {
+        EndClipRun(channel, frames);
+    }
+}
+
+/* Measures vecLen frames read with the given stride, i.e., 1 for planar
+ * channels and 2 for interleaved stereo frames. */
+template<typename real>
+template<size_t stride, typename sample>
+void DeliveryQC<real>::Process(const sample* yLeft, const sample* yRight, size_t vecLen, real threshold) {
+    typedef PcmFormat<sample> Format;
+    const real scale = real(Format::scale);
+    const sample* y[2] = { yLeft, yRight };
+    real x[taps - 1 + blockLen] = { 0 };
+    for (size_t offset = 0; offset < vecLen; offset += blockLen) {
+        size_t len = std::min(blockLen, vecLen - offset);
+        for (size_t c = 0; c < 2; c++) {
+            const sample* in = y[c] + offset * stride;
+            std::copy(history[c], history[c] + taps - 1, x);
+            for (size_t n = 0; n < len; n++) {
+                x[taps - 1 + n] = Format::template Read<real>(in[n * stride]) * scale;
+            }
+            ProcessChunk(c, x, len, threshold);
+            std::copy(x + len, x + len + taps - 1, history[c]);
+        }
+        frames += len;
+    }
+}
+
+/* Runs still open count as if they ended with the last frame. */
+template<typename real>
+typename DeliveryQC<real>::Report DeliveryQC<real>::GetReport() const {
+    Report report;
+    report.frames = frames;
+    report.overs = overs;
+    report.truePeakOvers = truePeakOvers;
+    report.clipRuns = clipRuns;
+    report.longestClipRun = longestClipRun;
+    report.droppedViolations = droppedViolations;
+    for (size_t c = 0; c < 2; c++) {
+        report.samplePeak[c] = samplePeak[c];
+        report.truePeak[c] = truePeak[c];
+        report.dc[c] = frames > 0 ? sum[c] / double(frames) : .0;
+        if (clipRun[c] >= minClipRun) {
+            report.clipRuns++;
+            report.longestClipRun = std::max(report.longestClipRun, clipRun[c]);
+        }
+    }
+    return report;
+}
+
+/* One-line report with levels in dB relative to full scale. */
+template<typename real>
+std::string DeliveryQC<real>::Summary() const {
+    Report r = GetReport();
+    double dB[6];
+    double levels[6] = { double(r.samplePeak[0]), double(r.samplePeak[1]), double(r.truePeak[0]),
+        double(r.truePeak[1]), std::fabs(r.dc[0]), std::fabs(r.dc[1]) };
+    for (size_t i = 0; i < 6; i++) {
+        dB[i] = 20.0 * std::log10(std::max(1e-30, levels[i]));
+    }
+    char text[512];
+    std::snprintf(text, sizeof(text),
+        "frames %llu | peak %.2f / %.2f dBFS | true peak %.2f / %.2f dBTP | overs %llu | "
+        "true-peak overs %llu | DC %.1f / %.1f dBFS | clip runs %llu (longest %llu) | violations %zu (+%llu)",
+        (unsigned long long)r.frames, dB[0], dB[1], dB[2], dB[3], (unsigned long long)r.overs,
+        (unsigned long long)r.truePeakOvers, dB[4], dB[5], (unsigned long long)r.clipRuns,
+        (unsigned long long)r.longestClipRun, violations.size(), (unsigned long long)r.droppedViolations);
+    return std::string(text);
+}
@@ -0,0 +1,133 @@
+/*******************************************************************************
+ *
+ * TPDF dither and noise shaping for the quantisation of stereo signals to
+ * integer PCM, see Pcm.hpp.
+ *
+ * The dither is the sum of two independent uniform variables spanning one
+ * least significant bit each, i.e., triangular noise in (-1; 1) LSB, which
+ * makes the first two moments of the quantisation error independent of
+ * the signal. Rather than from a recursive generator, the noise is obtained
+ * by hashing the frame index and the channel, so each sample is computed
+ * independently of the others and the quantisation loops vectorise; the
+ * frame index advances with the processed blocks.
+ *
+ * The optional noise shaping feeds the past quantisation errors back into
+ * the signal before quantisation, so that the total error is the
+ * quantisation error filtered by 1 - H(z), where H(z) are the feedback
+ * coefficients. The first-order filter is a first difference; the
+ * fifth-order filter is the E-weighted design by Lipshitz, Vanderkooy, and
+ * Wannamaker (1991), which moves the noise away from the frequencies where
+ * the ear is most sensitive. The feedback makes the loop serial.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include "Pcm.hpp"
+#include "Numerics.hpp"
+
+enum NoiseShaping {
+    noNoiseShaping,
+    firstOrderNoiseShaping,
+    eWeightedNoiseShaping
+};
+
+template<typename real>
+class Dither {
+    private:
+        static const size_t maxOrder = 5;
+
+        real amplitude = 1.0; // 0 with the dither off.
+        const double* coeff = nullptr; // maxOrder feedback coefficients, null without noise shaping.
+        uint32_t seed = 0x9E3779B9u;
+        uint32_t frame = 0; // Index of the next frame to be quantised.
+        real error[2][maxOrder] = { { 0 } }; // Past errors of each channel, the most recent first.
+
+        /* Integer hash by Chris Wellons (lowbias32). */
+        static uint32_t Hash(uint32_t x) {
+            x ^= x >> 16;
+            x *= 0x7FEB352Du;
+            x ^= x >> 15;
+            x *= 0x846CA68Bu;
+            x ^= x >> 16;
+            return x;
+        };
+
+    public:
+        void SetDither(bool _active) { amplitude = _active ? real(1.0) : real(0.0); };
+        void SetSeed(uint32_t _seed) { seed = _seed; };
+        void SetNoiseShaping(NoiseShaping _noiseShaping);
+        real GetAmplitude() const { return amplitude; };
+        uint32_t GetSeed() const { return seed; };
+        bool IsShaped() const { return coeff != nullptr; };
+        uint32_t GetFrame() const { return frame; };
+        void Advance(size_t frames) { frame += uint32_t(frames); };
+        void Reset();
+
+        /* Returns the dither of the given frame and channel in LSB. The two
+         * 16-bit halves of the hash are the uniform variables. Block loops
+         * can keep the seed and the amplitude in local variables and call 
+         * this function directly, as stores to the output may alias the 
+         * members. */
+        static real Noise(uint32_t seed, uint32_t index, size_t channel) {
+            uint32_t h = Hash((2u * index + uint32_t(channel)) ^ seed);
+            return real(int32_t(h & 0xFFFFu) + int32_t(h >> 16) - 65535) * real(1.0 / 65536.0);
+        };
+
+        /* Quantises x, given in LSB, for the given frame and channel. The
+         * multiply-adds follow the numerics policy, see Numerics.hpp. */
+        template<typename sample, typename numerics = StrictNumerics>
+        sample Quantise(real x, uint32_t index, size_t channel) const {
+            return PcmFormat<sample>::template Write<real>(numerics::MulAdd(amplitude, Noise(seed, index, channel), x));
+        };
+
+        /* Same as above with noise shaping; the samples of each channel must
+         * be quantised in order. The error fed back is clipped to a few LSB
+         * so that saturated samples cannot destabilise the loop. */
+        template<typename sample, typename numerics = StrictNumerics>
+        sample QuantiseShaped(real x, uint32_t index, size_t channel) {
+            real* e = error[channel];
+            real shaped = x;
+            for (size_t k = 0; k < maxOrder; k++) {
+                shaped = numerics::MulAdd(-real(coeff[k]), e[k], shaped);
+            }
+            sample y = PcmFormat<sample>::template Write<real>(numerics::MulAdd(amplitude, Noise(seed, index, channel), shaped));
+            for (size_t k = maxOrder - 1; k > 0; k--) {
+                e[k] = e[k - 1];
+            }
+            e[0] = std::max<real>(-4.0, std::min<real>(4.0, PcmFormat<sample>::template Read<real>(y) - shaped));
+            return y;
+        };
+};
+
+template<typename real>
+void Dither<real>::SetNoiseShaping(NoiseShaping _noiseShaping) {
+    static const double firstOrder[maxOrder] = { 1.0, .0, .0, .0, .0 };
+    static const double eWeighted[maxOrder] = { 2.033, -2.165, 1.959, -1.590, .6149 };
+    switch (_noiseShaping) {
+        case firstOrderNoiseShaping:
+            coeff = firstOrder;
+            break;
+        case eWeightedNoiseShaping:
+            coeff = eWeighted;
+            break;
+        default:
+            coeff = nullptr;
+    }
+    Reset();
+}
+
+/* The frame index is kept, so that the dither does not repeat. */
+template<typename real>
+void Dither<real>::Reset() {
+    for (size_t c = 0; c < 2; c++) {
+        for (size_t k = 0; k < maxOrder; k++) {
+            error[c][k] = real(0.0);
+        }
+    }
+}
@@ -3,6 +3,10 @@
  * Mono-input, mono-output exponential smoother via cascaded one-pole filters
  * with 2π*tau time constant.
  *
+ * The state of the sections can be stored with a compact type, e.g., float
+ * for double processing, so that it packs densely into cache lines and 
+ * vector registers.
+ *
  * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
  *
  * ****************************************************************************/
@@ -11,50 +15,74 @@
 
 #include <cmath>
 #include <algorithm>
+#include <cstring>
 #include <limits>
+#include "Numerics.hpp"
+
+/* The coefficients only depend on the settings, so that instances with the
+ * same settings can share them, whatever their state type. */
+template<size_t stages, typename real, typename numerics = StrictNumerics>
+struct ExpSmootherCoefficients {
+
+    /* Coefficient correction factor to maintain consistent attack and
+     * decay rates when cascading multiple one-pole sections. */
+    real coeffCorrection =
+        1.0 / std::sqrt(std::pow(2.0, 1.0 / real(stages)) - 1.0);
+
+    real epsilon = std::numeric_limits<real>::epsilon();
+    real SR = 48000.0; // Samplerate as a float variable for later calculations.
+    real T = 1.0 / SR; // Sampling period.
+    real twoPiC = 2.0 * M_PI * coeffCorrection;
+    real twoPiCT = twoPiC * T;
+    real attTime = .001; // Attack time in seconds.
+    real relTime = .01; // Release time in seconds.
+
+    /* We store the release and attack coefficients in an array for
+     * efficient Boolean fetching without branching. */
+    real coeff[2] = {
+        numerics::Exp(-twoPiCT / relTime),
+        numerics::Exp(-twoPiCT / attTime)
+    };
+
+    void SetSR(real _SR);
+    void SetAttTime(real _attTime);
+    void SetRelTime(real _relTime);
+};
 
-template<size_t stages, typename real>
+template<size_t stages, typename real, typename stateType = real, typename numerics = StrictNumerics>
 class ExpSmootherCascade {
     
     static_assert(stages > 0, "The ExpSmootherCascade class expects one or more stages.");
+    static_assert(numerics::available, "Strict numerics are not available with -ffast-math.");
     
-    private:
-    
-        /* Coefficient correction factor to maintain consistent attack and
-         * decay rates when cascading multiple one-pole sections. */
-        const real coeffCorrection =
-            1.0 / std::sqrt(std::pow(2.0, 1.0 / real(stages)) - 1.0);
-    
-        const real epsilon = std::numeric_limits<real>::epsilon();
-        real SR = 48000.0; // Samplerate as a float variable for later calculations.
-        real T = 1.0 / SR; // Sampling period.
-        const real twoPiC = 2.0 * M_PI * coeffCorrection;
-        real twoPiCT = twoPiC * T;
-        real attTime = .001; // Attack time in seconds.
-        real relTime = .01; // Release time in seconds.
-        real attCoeff = std::exp(-twoPiCT / attTime);
-        real relCoeff = std::exp(-twoPiCT / relTime);
-    
-        /* We store the coefficients in an array for efficient Boolean
-         * fetching without branching. */
-        real coeff[2] = {
-            relCoeff,
-            attCoeff
+    public:
+        typedef ExpSmootherCoefficients<stages, real, numerics> Coefficients;
+        struct State {
+            stateType output[stages] = { .0 };
+
+            void Reset() { memset(output, 0, sizeof(output)); };
         };
-        real output[stages] = { .0 };
+        static void Process(const Coefficients& coefficients, State& state, 
+            real* xVec, real* yVec, size_t vecLen);
+
+    private:
+        Coefficients coefficients;
+        State state;
 
     public:
-        void SetSR(real _SR);
-        void SetAttTime(real _attTime);
-        void SetRelTime(real _relTime);
-        void Reset() { memset(output, 0, stages); };
-        void Process(real* xVec, real* yVec, size_t vecLen);
+        void SetSR(real _SR) { coefficients.SetSR(_SR); };
+        void SetAttTime(real _attTime) { coefficients.SetAttTime(_attTime); };
+        void SetRelTime(real _relTime) { coefficients.SetRelTime(_relTime); };
+        void Reset() { state.Reset(); };
+        void Process(real* xVec, real* yVec, size_t vecLen) {
+            Process(coefficients, state, xVec, yVec, vecLen);
+        };
         ExpSmootherCascade() { };
         ExpSmootherCascade(real _SR, real _attTime, real _relTime);
 };
 
-template<size_t stages, typename real>
-void ExpSmootherCascade<stages, real>::SetSR(real _SR) {
+template<size_t stages, typename real, typename numerics>
+void ExpSmootherCoefficients<stages, real, numerics>::SetSR(real _SR) {
     SR = std::max<real>(1.0, _SR);
     T = 1.0 / SR;
     twoPiCT = twoPiC * T;
@@ -63,24 +91,25 @@ void ExpSmootherCascade<stages, real>::SetSR(real _SR) {
 /* We store attack and relelease phases coefficients in an array for look-up 
  * table selection using a Boolean index, which is faster than two 
  * multiplications by bools. */
-template<size_t stages, typename real>
-void ExpSmootherCascade<stages, real>::SetAttTime(real _attTime) {
+template<size_t stages, typename real, typename numerics>
+void ExpSmootherCoefficients<stages, real, numerics>::SetAttTime(real _attTime) {
     attTime = std::max<real>(epsilon, _attTime);
-    attCoeff = std::exp(-twoPiCT / attTime);
-    coeff[1] = attCoeff;
+    coeff[1] = numerics::Exp(-twoPiCT / attTime);
 }
 
-template<size_t stages, typename real>
-void ExpSmootherCascade<stages, real>::SetRelTime(real _relTime) {
+template<size_t stages, typename real, typename numerics>
+void ExpSmootherCoefficients<stages, real, numerics>::SetRelTime(real _relTime) {
     relTime = std::max<real>(epsilon, _relTime);
-    relCoeff = std::exp(-twoPiCT / relTime);
-    coeff[0] = relCoeff;
+    coeff[0] = numerics::Exp(-twoPiCT / relTime);
 }
 
 /* Given input and output vectors, the function processes a block of vecLen
  * samples of the input signal and stores it in the output vector. */
-template<size_t stages, typename real>
-void ExpSmootherCascade<stages, real>::Process(real* xVec, real* yVec, size_t vecLen) {
+template<size_t stages, typename real, typename stateType, typename numerics>
+void ExpSmootherCascade<stages, real, stateType, numerics>::Process(const Coefficients& coefficients, State& state, 
+        real* xVec, real* yVec, size_t vecLen) {
+    const real* coeff = coefficients.coeff;
+    stateType* output = state.output;
     for (size_t n = 0; n < vecLen; n++) { // Level-0 for-loop.
         
         /* Outside of the inner for-loop, we assign the input vector sample 
@@ -98,8 +127,8 @@ void ExpSmootherCascade<stages, real>::Process(real* xVec, real* yVec, size_t ve
 
             /* Compute the output of the one-pole section "stage" using the
              * corresponding attack or release coefficient. */
-            output[stage] =
-                input + coeff[isAttackPhase] * (output[stage] - input);
+            output[stage] = stateType(numerics::MulAdd(coeff[isAttackPhase], 
+                real(output[stage] - input), input));
 
             /* We can now update the input to the next section with the 
              * output of the current one. */
@@ -114,18 +143,9 @@ void ExpSmootherCascade<stages, real>::Process(real* xVec, real* yVec, size_t ve
     } // End of level-0 for-loop.
 }
 
-/* We store attack and relelease phases coefficients in an array for look-up
- * table selection using a Boolean index, which is faster than two
- * multiplications by bools. */
-template<size_t stages, typename real>
-ExpSmootherCascade<stages, real>::ExpSmootherCascade(real _SR, real _attTime, real _relTime) {
-    SR = std::max<real>(1.0, _SR);
-    T = 1.0 / SR;
-    twoPiCT = twoPiC * T;
-    attTime = std::max<real>(epsilon, _attTime);
-    relTime = std::max<real>(epsilon, _relTime);
-    attCoeff = std::exp(-twoPiCT / attTime);
-    relCoeff = std::exp(-twoPiCT / relTime);
-    coeff[0] = relCoeff;
-    coeff[1] = attCoeff;
+template<size_t stages, typename real, typename stateType, typename numerics>
+ExpSmootherCascade<stages, real, stateType, numerics>::ExpSmootherCascade(real _SR, real _attTime, real _relTime) {
+    coefficients.SetSR(_SR);
+    coefficients.SetAttTime(_attTime);
+    coefficients.SetRelTime(_relTime);
 }
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <cmath>
+#include <cstdint>
 
 template<typename real>
 class Generators {
@@ -51,7 +52,7 @@ void Generators<real>::ProcessSine(real* vec, int vecLen) {
 template<typename real>
 void Generators<real>::ProcessNoise(real* vec, int vecLen) {
     for (int i = 0; i < vecLen; i++) {
-        state = state * 1103515245 + seed;
+        state = int32_t(uint32_t(state) * 1103515245u + uint32_t(seed));
         vec[i] = state / real(MAX);
     }
 }
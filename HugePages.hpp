@@ -0,0 +1,207 @@
+/*******************************************************************************
+ *
+ * Memory pool backed by 2 MiB huge pages (Linux), for banks of thousands of
+ * limiters whose delay buffers and state would otherwise be spread over
+ * as many 4 KiB pages, each needing its own TLB entry.
+ *
+ * The pool maps chunks of 2 MiB, or larger for larger requests, trying in
+ * order explicit huge pages with MAP_HUGETLB, which need pages reserved in
+ * /proc/sys/vm/nr_hugepages, then transparent huge pages with
+ * madvise(MADV_HUGEPAGE) on a 2 MiB-aligned mapping, and finally regular
+ * pages. Blocks are carved from the chunks with power-of-two sizes, and
+ * freed blocks are kept in per-size free lists for reuse; the chunks are
+ * never returned to the system.
+ *
+ * HugePageAllocator is a stateless allocator on the shared pool, e.g., for
+ * the delay buffers through the last template parameter of the Limiter
+ * class, and MakeHugePage allocates whole objects, e.g., the limiters
+ * themselves, so that the state of consecutive instances shares pages.
+ * Allocation takes a lock and is not meant for the audio thread.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+#include <mutex>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <sys/mman.h>
+
+class HugePagePool {
+    public:
+        enum Backing { regularPages, transparentHugePages, explicitHugePages };
+
+    private:
+        static const size_t hugePageLen = size_t(1) << 21;
+        static const size_t minBlockLen = 64; // Cache-line alignment of every block.
+        static const size_t numberOfClasses = 8 * sizeof(size_t);
+
+        std::mutex mutex;
+        bool explicitAvailable = true;
+        Backing backing = explicitHugePages;
+        uint8_t* chunk = nullptr; // Chunk being carved.
+        size_t chunkUsed = 0;
+        size_t chunkLen = 0;
+        size_t mappedBytes = 0;
+        std::vector<void*> freeBlocks[numberOfClasses];
+
+        static size_t SizeClass(size_t bytes) {
+            size_t sizeClass = 0;
+            while ((minBlockLen << sizeClass) < bytes) {
+                sizeClass++;
+            }
+            return sizeClass;
+        };
+
+        /* Maps len bytes, a multiple of the huge page size, with the best
+         * backing available. The backing reported is the worst one used. */
+        uint8_t* Map(size_t len) {
+            void* memory = MAP_FAILED;
+#ifdef MAP_HUGETLB
+            if (explicitAvailable) {
+                memory = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+                explicitAvailable = memory != MAP_FAILED;
+            }
+#endif
+            if (memory != MAP_FAILED) {
+                mappedBytes += len;
+                return static_cast<uint8_t*>(memory);
+            }
+
+            /* Transparent huge pages need 2 MiB-aligned ranges, hence we
+             * over-allocate by one page and trim both ends. */
+            size_t paddedLen = len + hugePageLen;
+            memory = mmap(nullptr, paddedLen, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED) {
+                return nullptr;
+            }
+            uintptr_t start = reinterpret_cast<uintptr_t>(memory);
+            uintptr_t aligned = (start + hugePageLen - 1) & ~uintptr_t(hugePageLen - 1);
+            if (aligned > start) {
+                munmap(memory, aligned - start);
+            }
+            if (aligned + len < start + paddedLen) {
+                munmap(reinterpret_cast<void*>(aligned + len), start + paddedLen - aligned - len);
+            }
+            Backing mapped = regularPages;
+#ifdef MADV_HUGEPAGE
+            if (madvise(reinterpret_cast<void*>(aligned), len, MADV_HUGEPAGE) == 0) {
+                mapped = transparentHugePages;
+            }
+#endif
+            backing = std::min(backing, mapped);
+            mappedBytes += len;
+            return reinterpret_cast<uint8_t*>(aligned);
+        };
+
+    public:
+        static HugePagePool& Instance() {
+            static HugePagePool pool;
+            return pool;
+        };
+
+        void* Allocate(size_t bytes) {
+            std::lock_guard<std::mutex> lock(mutex);
+            size_t sizeClass = SizeClass(bytes);
+            size_t blockLen = minBlockLen << sizeClass;
+            if (!freeBlocks[sizeClass].empty()) {
+                void* block = freeBlocks[sizeClass].back();
+                freeBlocks[sizeClass].pop_back();
+                return block;
+            }
+
+            /* Blocks of at least a huge page get their own mapping. */
+            if (blockLen >= hugePageLen) {
+                void* block = Map(blockLen);
+                if (block == nullptr) {
+                    throw std::bad_alloc();
+                }
+                return block;
+            }
+
+            /* Blocks are carved contiguously, and the rest of the current
+             * chunk is lost when a new one is needed. */
+            size_t offset = chunkUsed;
+            if (chunk == nullptr || offset + blockLen > chunkLen) {
+                chunk = Map(hugePageLen);
+                if (chunk == nullptr) {
+                    throw std::bad_alloc();
+                }
+                chunkLen = hugePageLen;
+                offset = 0;
+            }
+            chunkUsed = offset + blockLen;
+            return chunk + offset;
+        };
+
+        void Deallocate(void* block, size_t bytes) {
+            if (block == nullptr) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            freeBlocks[SizeClass(bytes)].push_back(block);
+        };
+
+        Backing GetBacking() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return mappedBytes == 0 ? regularPages : backing;
+        };
+        size_t GetMappedBytes() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return mappedBytes;
+        };
+};
+
+template<typename T>
+struct HugePageAllocator {
+    typedef T value_type;
+
+    HugePageAllocator() { };
+    template<typename U>
+    HugePageAllocator(const HugePageAllocator<U>&) { };
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(HugePagePool::Instance().Allocate(n * sizeof(T)));
+    };
+    void deallocate(T* p, size_t n) {
+        HugePagePool::Instance().Deallocate(p, n * sizeof(T));
+    };
+};
+
+template<typename T, typename U>
+bool operator==(const HugePageAllocator<T>&, const HugePageAllocator<U>&) { return true; }
+
+template<typename T, typename U>
+bool operator!=(const HugePageAllocator<T>&, const HugePageAllocator<U>&) { return false; }
+
+/* Objects allocated from the pool are destroyed and returned to it by the
+ * deleter of the unique_ptr. */
+template<typename T>
+struct HugePageDeleter {
+    void operator()(T* object) const {
+        object->~T();
+        HugePagePool::Instance().Deallocate(object, sizeof(T));
+    };
+};
+
+template<typename T, typename... Args>
+std::unique_ptr<T, HugePageDeleter<T>> MakeHugePage(Args&&... args) {
+    static_assert(alignof(T) <= 64, "The pool aligns blocks to 64 bytes.");
+    void* memory = HugePagePool::Instance().Allocate(sizeof(T));
+    try {
+        return std::unique_ptr<T, HugePageDeleter<T>>(new (memory) T(std::forward<Args>(args)...));
+    } catch (...) {
+        HugePagePool::Instance().Deallocate(memory, sizeof(T));
+        throw;
+    }
+}
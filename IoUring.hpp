@@ -0,0 +1,179 @@
+/*******************************************************************************
+ *
+ * Minimal io_uring wrapper over the raw Linux system calls, so that no
+ * external library is needed. It covers what the batch renderer uses:
+ * ring setup, buffer registration, submission queue entries, batched
+ * submission, and completion reaping.
+ *
+ * Init returns false when io_uring is not available, e.g., on non-Linux
+ * systems, on old kernels, or when the system call is filtered, in which
+ * case the caller falls back to plain read/write calls.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <cerrno>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define LIMITER_HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#ifdef LIMITER_HAVE_IO_URING
+
+class IoUring {
+    private:
+        int ringFd = -1;
+        void* sqRing = MAP_FAILED;
+        void* cqRing = MAP_FAILED;
+        size_t sqRingSize = 0;
+        size_t cqRingSize = 0;
+        io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+        size_t sqesSize = 0;
+
+        unsigned* sqHead = nullptr;
+        unsigned* sqTail = nullptr;
+        unsigned* sqArray = nullptr;
+        unsigned sqMask = 0;
+        unsigned sqEntries = 0;
+        unsigned* cqHead = nullptr;
+        unsigned* cqTail = nullptr;
+        unsigned cqMask = 0;
+        io_uring_cqe* cqes = nullptr;
+
+        unsigned localTail = 0; // Tail including the entries not yet published.
+        unsigned toSubmit = 0;
+
+        void Release() {
+            if (sqes != MAP_FAILED) {
+                munmap(sqes, sqesSize);
+            }
+            if (cqRing != MAP_FAILED && cqRing != sqRing) {
+                munmap(cqRing, cqRingSize);
+            }
+            if (sqRing != MAP_FAILED) {
+                munmap(sqRing, sqRingSize);
+            }
+            if (ringFd >= 0) {
+                close(ringFd);
+            }
+            ringFd = -1;
+            sqRing = cqRing = MAP_FAILED;
+            sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+        };
+
+    public:
+        bool Init(unsigned entries) {
+            io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+            ringFd = int(syscall(__NR_io_uring_setup, entries, &params));
+            if (ringFd < 0) {
+                return false;
+            }
+            sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+            if (singleMmap) {
+                sqRingSize = cqRingSize = sqRingSize > cqRingSize ? sqRingSize : cqRingSize;
+            }
+            sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+            cqRing = singleMmap ? sqRing : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+            sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+            if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+                Release();
+                return false;
+            }
+            char* sq = static_cast<char*>(sqRing);
+            char* cq = static_cast<char*>(cqRing);
+            sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+            sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+            sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            sqEntries = params.sq_entries;
+            cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+            localTail = *sqTail;
+            return true;
+        };
+
+        bool RegisterBuffers(const iovec* buffers, unsigned numberOfBuffers) {
+            return syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS,
+                buffers, numberOfBuffers) == 0;
+        };
+
+        /* Returns a cleared entry, or nullptr if the submission queue is
+         * full, in which case Submit must be called first. */
+        io_uring_sqe* GetSqe() {
+            unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+            if (localTail - head >= sqEntries) {
+                return nullptr;
+            }
+            unsigned index = localTail & sqMask;
+            sqArray[index] = index;
+            localTail++;
+            toSubmit++;
+            io_uring_sqe* sqe = &sqes[index];
+            std::memset(sqe, 0, sizeof(*sqe));
+            return sqe;
+        };
+
+        /* Returns a cleared entry like GetSqe, first submitting the 
+         * prepared entries if the submission queue is full. Returns nullptr
+         * only if the submission fails. */
+        io_uring_sqe* GetSqeOrSubmit() {
+            io_uring_sqe* sqe = GetSqe();
+            while (sqe == nullptr) {
+                if (Submit(0) < 0 && errno != EINTR) {
+                    return nullptr;
+                }
+                sqe = GetSqe();
+            }
+            return sqe;
+        };
+
+        /* Publishes the prepared entries and submits them with a single
+         * system call, optionally waiting for minComplete completions. */
+        int Submit(unsigned minComplete) {
+            __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+            unsigned flags = minComplete > 0 ? IORING_ENTER_GETEVENTS : 0;
+            int result = int(syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete,
+                flags, nullptr, 0));
+            if (result >= 0) {
+                toSubmit -= unsigned(result) < toSubmit ? unsigned(result) : toSubmit;
+            }
+            return result;
+        };
+
+        /* Copies the oldest completion, if any, and frees its slot. */
+        bool PopCqe(io_uring_cqe& cqe) {
+            unsigned head = *cqHead;
+            if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                return false;
+            }
+            cqe = cqes[head & cqMask];
+            __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+            return true;
+        };
+
+        IoUring() { };
+        IoUring(const IoUring&) = delete;
+        IoUring& operator=(const IoUring&) = delete;
+        ~IoUring() { Release(); };
+};
+
+#endif
@@ -11,6 +11,22 @@
  * cascaded one-pole smoothers, which allow for smooth amplitude following
  * and very low total harmonic distortion.
  *
+ * The detection, i.e., the parameter smoothing, the peak-holders, the 
+ * smoothers, and the gain computation, runs with the real type, while the
+ * audio path, i.e., the input and output, the delay line, and the gain 
+ * multiplication, runs with audioReal, by default the same type. The 
+ * gain is converted at the boundary between the two. LimiterMixedPrecision
+ * combines a double-precision detection, whose recursions need it at long
+ * time constants, with a float audio path and delay line.
+ *
+ * Process and ProcessInterleaved read and write integer PCM as well as
+ * floating-point samples. Integer outputs are dithered and quantised in 
+ * the loop applying the attenuation gain, with optional noise shaping, see
+ * Dither.hpp. Given the aligned and padded channels of an AudioBuffer,
+ * see AudioBuffer.hpp, the kernels assume aligned inputs and outputs.
+ * A DeliveryQC given to SetQC measures the output as it is written, see
+ * DeliveryQC.hpp.
+ *
  * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
  *
  * ****************************************************************************/
@@ -21,38 +37,147 @@
 #include <algorithm>
 #include <limits>
 #include <cstdint>
+#include <memory>
 #include "DelaySmooth.hpp"
 #include "PeakHoldCascade.hpp"
 #include "ExpSmootherCascade.hpp"
+#include "LimiterPreset.hpp"
+#include "Pcm.hpp"
+#include "Dither.hpp"
+#include "AudioBuffer.hpp"
+#include "DeliveryQC.hpp"
 
-template<typename real>
+template<typename real, size_t numberOfPeakHoldSections = 8, size_t numberOfSmoothSections = 4, typename delayStorage = real, 
+    typename delayAllocator = std::allocator<delayStorage>, typename detectorState = real, typename numerics = StrictNumerics, 
+    typename audioReal = real>
 class Limiter {
+    public:
+        typedef LimiterCoefficients<real, numberOfPeakHoldSections, numberOfSmoothSections, numerics> Coefficients;
+        typedef LimiterPreset<real, numberOfPeakHoldSections, numberOfSmoothSections, numerics> Preset;
+
+        /* Detection signals that can be captured for analysis: the stereo
+         * peak after the pre gain, the peak-hold envelope, the envelope 
+         * clipped to the threshold, the smoothed envelope, and the gain. 
+         * SetCapture takes numberOfSignals vectors, null for the signals 
+         * not needed, which the following blocks fill from their start; it
+         * is called again, e.g., before each block, before they fill up,
+         * and with null to stop. With decimated detection, only the gain is
+         * captured. */
+        enum CaptureSignal { peakSignal, holdSignal, clipSignal, smoothSignal, gainSignal, numberOfSignals };
+
     private:
-        real SR = 48000.0; // Samplerate as a float variable for later calculations.
-        real T = 1.0 / SR; // Sampling period.
-        const real twoPi = 2.0 * M_PI;
-        const real epsilon = std::numeric_limits<real>::epsilon();
-        const real smoothParamCutoff = 20.0; // Hz.
-        real attack = .01; // Attack time in seconds.
-        real hold = .0; // Hold time in seconds, useful to improve THD at lower frequencies.
-        real release = .05; // Release time in seconds.
-        real dBThreshold = -.3; // Threshold in dB.
-        real linThreshold = std::pow(10.0, dBThreshold * .05); // Linear threshold value.
-        real dBPreGain = .0; // Input gain before processing in dB.
-        real linPreGain = 1.0; // Linear gain.
-        real smoothPreGain = .0; // Smoothed out linear gain for click-free variations.
-        real smoothThreshold = .0; // Smoothed out limiting threshold for click-free variations.
-    
-        /* Coefficient for a one-pole low-pass filter. */
-        real smoothParamCoeff = std::exp(-twoPi * smoothParamCutoff * T);
-    
-        size_t lookaheadDelay = 0;
-        DelaySmooth<uint16_t, real> delay;
-        const static size_t numberOfPeakHoldSections = 8;
-        const static size_t numberOfSmoothSections = 4;
-        const real oneOverPeakSections = 1.0 / real(numberOfPeakHoldSections);
-        PeakHoldCascade<numberOfPeakHoldSections, real> peakHolder;
-        ExpSmootherCascade<numberOfSmoothSections, real> expSmoother;
+        /* The hold timers never exceed the hold time of a section in 
+         * samples, hence 32 bits are plenty and half the size of size_t. 
+         * The held and smoothed envelopes can be stored as float for double
+         * audio through detectorState, which is close but not bit-exact. */
+        typedef PeakHoldCascade<numberOfPeakHoldSections, real, uint32_t, detectorState> PeakHolder;
+        typedef ExpSmootherCascade<numberOfSmoothSections, real, detectorState, numerics> ExpSmoother;
+
+        /* The signal state updated at every sample is kept together at the 
+         * start of the object, aligned to a cache line, and followed by the
+         * delay line; the settings and coefficients, which are only read, 
+         * are kept in a separate, possibly shared block. The processing 
+         * functions copy the state to local variables for the duration of 
+         * a sub-block. The detection and the application paths may run on
+         * different threads, see LimiterPipelined.hpp, hence the state 
+         * written by each has its own cache lines. Reset clears the signal
+         * state, while the smoothed parameters keep their values. */
+        struct alignas(64) State {
+
+            /* Written by the detection path. */
+            real smoothPreGain = .0; // Smoothed out linear gain for click-free variations.
+            real smoothThreshold = .0; // Smoothed out limiting threshold for click-free variations.
+
+            /* State of the decimated detection. */
+            real groupMax = .0;
+            real gainPrevious = 1.0; // Last two gains computed at the decimated rate.
+            real gainCurrent = 1.0;
+            size_t groupPosition = 0; // Samples of the current group seen so far.
+
+            typename ExpSmoother::State expSmoother;
+            typename PeakHolder::State peakHolder;
+
+            /* Written by the application path. */
+            alignas(64) real smoothPreGainAudio = .0; // Smoothed out linear gain of the delayed audio path.
+        };
+        State state;
+        DelaySmooth<uint32_t, audioReal, delayStorage, delayAllocator, numerics> delay; // See DelaySmooth.hpp for the storage types.
+        typedef DelayStorage<audioReal, delayStorage> Storage;
+        Dither<audioReal> dither; // Only used for integer outputs.
+
+        /* Settings and derived coefficients, see LimiterPreset.hpp. The 
+         * block in use is either owned by the instance, and possibly shared
+         * with its copies, in which case the setters first make a private
+         * copy, or acquired from the preset the instance is attached to. */
+        std::shared_ptr<const Coefficients> privateCoefficients = std::make_shared<Coefficients>();
+        typename Preset::Reference presetCoefficients;
+        const Coefficients* coefficients = privateCoefficients.get();
+        const Preset* preset = nullptr;
+        uint64_t presetVersion = 0;
+
+        /* Vectors receiving the detection signals, see SetCapture, and the
+         * position of the next sample within them. */
+        real* const* captureVec = nullptr;
+        size_t captureOffset = 0;
+
+        /* Delivery checks fed with the output, see SetQC. */
+        DeliveryQC<audioReal>* qc = nullptr;
+
+        /* Scratch vectors for the intermediate signals. Blocks larger than
+         * internalBlockLen are processed in sub-blocks, which keeps the
+         * scratch memory small and allows for in-place processing. The 
+         * vectors only hold data within a call, hence they are shared by 
+         * all the instances running on the same thread, which keeps them 
+         * in the cache when many instances are processed in turn. The 
+         * vectors are aligned to a cache line like those of AudioBuffer. */
+        static const size_t internalBlockLen = Coefficients::internalBlockLen;
+        struct alignas(audioAlignment) Scratch {
+            audioReal audioLeft[internalBlockLen];
+            audioReal audioRight[internalBlockLen];
+            real envelope[internalBlockLen];
+            real threshold[internalBlockLen];
+            audioReal gain[internalBlockLen];
+            audioReal audioGain[internalBlockLen];
+            audioReal output[internalBlockLen]; // Channel scaled to LSB before quantisation.
+            audioReal noise[internalBlockLen]; // Dither of the channel.
+        };
+        static Scratch& GetScratch() {
+            static thread_local Scratch scratch;
+            return scratch;
+        };
+
+        Coefficients& ModifyCoefficients();
+        void UpdateDelay();
+        void Capture(size_t signal, const real* x, size_t vecLen) {
+            if (captureVec != nullptr && captureVec[signal] != nullptr) {
+                std::copy(x, x + vecLen, captureVec[signal] + captureOffset);
+            }
+        };
+        void CaptureGain(const audioReal* gainVec, size_t vecLen);
+        template<size_t stride, typename outputSample>
+        void CheckOutput(const outputSample* yLeft, const outputSample* yRight, size_t vecLen) {
+            if (qc != nullptr) {
+                qc->template Process<stride>(yLeft, yRight, vecLen, audioReal(coefficients->linThreshold));
+            }
+        };
+        template<size_t stride, bool aligned, typename sample>
+        void DetectBlock(const sample* xLeft, const sample* xRight, audioReal* gainVec, size_t vecLen);
+        template<size_t stride, bool aligned, typename sample>
+        void DetectBlockDecimated(const sample* xLeft, const sample* xRight, audioReal* gainVec, size_t vecLen);
+        template<size_t stride, bool aligned, typename sample, typename outputSample>
+        void ApplyBlock(const sample* xLeft, const sample* xRight, const audioReal* gainVec, 
+            outputSample* yLeft, outputSample* yRight, size_t vecLen);
+        template<size_t stride, bool aligned, typename outputSample>
+        void WriteDelayed(const audioReal* gainVec, outputSample* y, size_t channel, size_t vecLen);
+        template<size_t stride, bool aligned, typename input, typename outputSample>
+        void WriteOutput(const audioReal* gainVec, const input* x, outputSample* y, 
+            size_t channel, size_t frame, size_t vecLen);
+        template<bool aligned, typename sample, typename outputSample>
+        void ProcessBlocks(const sample* const* xVec, outputSample* const* yVec, size_t vecLen);
+        template<bool aligned, typename sample, typename outputSample>
+        void ProcessInterleavedBlocks(const sample* xVec, outputSample* yVec, size_t vecLen);
+        void ApplyHistoryBlock(const audioReal* const* xVec, const audioReal* const* historyVec, size_t historyLen, 
+            size_t offset, const audioReal* gainVec, audioReal* const* yVec, size_t vecLen);
     
     public:
         void SetSR(real _SR);
@@ -61,151 +186,670 @@ class Limiter {
         void SetRelTime(real _release);
         void SetThreshold(real _threshold);
         void SetPreGain(real _preGain);
+        void SetLookaheadSlack(size_t _lookaheadSlack);
+        void SetMaxAttTime(real _maxAttack);
+        void SetDecimatedDetection(bool _decimatedDetection);
+        void SetHistoryMode(bool _historyMode) { delay.AllocateBuffers(!_historyMode); };
+        void SetCapture(real* const* _captureVec) { captureVec = _captureVec; captureOffset = 0; };
+        void SetDither(bool _dither) { dither.SetDither(_dither); };
+        void SetDitherSeed(uint32_t _seed) { dither.SetSeed(_seed); };
+        void SetNoiseShaping(NoiseShaping _noiseShaping) { dither.SetNoiseShaping(_noiseShaping); };
+        void SetQC(DeliveryQC<audioReal>* _qc) { qc = _qc; };
+        void SetPreset(const Preset* _preset);
+        bool UpdatePreset();
+        const Coefficients& GetCoefficients() const { return *coefficients; };
         void Reset();
-        void Process(real** xVec, real** yVec, size_t vecLen);
+        size_t GetLatency() const { return coefficients->lookaheadDelay; };
+        void Process(const audioReal* const* xVec, audioReal* const* yVec, size_t vecLen) {
+            Process<audioReal, audioReal>(xVec, yVec, vecLen);
+        };
+        void ProcessInterleaved(const audioReal* xVec, audioReal* yVec, size_t vecLen) {
+            ProcessInterleaved<audioReal, audioReal>(xVec, yVec, vecLen);
+        };
+        template<typename sample, typename outputSample>
+        void Process(const sample* const* xVec, outputSample* const* yVec, size_t vecLen) {
+            ProcessBlocks<false>(xVec, yVec, vecLen);
+        };
+        template<typename sample, typename outputSample>
+        void ProcessInterleaved(const sample* xVec, outputSample* yVec, size_t vecLen) {
+            ProcessInterleavedBlocks<false>(xVec, yVec, vecLen);
+        };
+
+        /* The views must hold two channels each, otherwise nothing is
+         * processed; the functions return the number of frames processed. */
+        template<typename sample, typename outputSample>
+        size_t Process(const AudioPlanarView<sample>& x, const AudioPlanarView<outputSample>& y) {
+            size_t frames = x.numberOfChannels == 2 && y.numberOfChannels == 2 ? std::min(x.frames, y.frames) : 0;
+            ProcessBlocks<true>(x.channels, y.channels, frames);
+            return frames;
+        };
+        template<typename sample, typename outputSample>
+        size_t ProcessInterleaved(const AudioInterleavedView<sample>& x, const AudioInterleavedView<outputSample>& y) {
+            size_t frames = x.numberOfChannels == 2 && y.numberOfChannels == 2 ? std::min(x.frames, y.frames) : 0;
+            ProcessInterleavedBlocks<true>(x.data, y.data, frames);
+            return frames;
+        };
+        void ProcessGain(const audioReal* const* xVec, audioReal* gainVec, size_t vecLen);
+        void ApplyGain(const audioReal* const* xVec, const audioReal* gainVec, audioReal* const* yVec, size_t vecLen);
+        void ProcessHistory(const audioReal* const* xVec, const audioReal* const* historyVec, size_t historyLen, 
+            audioReal* const* yVec, size_t vecLen);
         Limiter() { };
         Limiter(real _SR, real _dBPreGain, real _attack, real _hold, real _release, real _dBThreshold);
 };
 
-template<typename real>
-void Limiter<real>::SetSR(real _SR) {
-    SR = std::max<real>(1.0, _SR);
-    T = 1.0 / SR;
-    smoothParamCoeff = std::exp(-twoPi * smoothParamCutoff * T);
-    peakHolder.SetSR(SR);
-    expSmoother.SetSR(SR);
+/* Definition for the odr-uses of the sub-block size, e.g., std::min. */
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+const size_t Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::internalBlockLen;
+
+/* Setters modify the coefficient block in place when the instance is its 
+ * only user, otherwise they detach the instance from the shared block and 
+ * from the preset with a private copy. The blocks are created non-const,
+ * which makes the cast safe. */
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+typename Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::Coefficients& Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::ModifyCoefficients() {
+    if (preset != nullptr || privateCoefficients.use_count() != 1) {
+        privateCoefficients = std::make_shared<Coefficients>(*coefficients);
+        coefficients = privateCoefficients.get();
+        presetCoefficients.Reset();
+        preset = nullptr;
+    }
+    return const_cast<Coefficients&>(*coefficients);
 }
 
-template<typename real>
-void Limiter<real>::SetAttTime(real _attack) {
-    attack = std::max<real>(epsilon, _attack);
-    
-    /* We compute the delay so that it matches the hold time of the
-     * peak-holder section for correct input-attenuation synchronisation.
-     * Both hold and delay times are dependent on the attack time. */
-    lookaheadDelay =
-        rint(attack * oneOverPeakSections * SR) * numberOfPeakHoldSections;
-    
-    /* We set the interpolation time equal to the delay for minimum
-     * overshooting during attack variations. */
-    delay.SetDelay(lookaheadDelay);
-    delay.SetInterpolationTime(lookaheadDelay);
+/* The delay line follows the look-ahead and the buffer length of the 
+ * current block. Resizing the buffers clears them. */
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::UpdateDelay() {
+    const Coefficients& c = *coefficients;
+    if (delay.GetBufferLen() != c.delayBufferLen) {
+        delay.SetMaxDelay(c.delayBufferLen - 1);
+    }
+    if (delay.GetDelay() != c.lookaheadDelay) {
     
-    expSmoother.SetAttTime(attack);
-    peakHolder.SetHoldTime(attack + hold);
+        /* We set the interpolation time equal to the delay for minimum
+         * overshooting during attack variations. */
+        delay.SetDelay(c.lookaheadDelay);
+        delay.SetInterpolationTime(c.lookaheadDelay);
+    }
 }
 
-template<typename real>
-void Limiter<real>::SetHoldTime(real _hold) {
-    hold = std::max<real>(.0, _hold);
-    
-    /* The hold time is simply an extension of the peak-holder period
-     * that allows for better convergence to the target amplitude. The
-     * parameter is particularly useful to reduce THD at low frequencies. */
-    peakHolder.SetHoldTime(attack + hold);
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::SetSR(real _SR) {
+    ModifyCoefficients().SetSR(_SR);
+    UpdateDelay();
 }
 
-template<typename real>
-void Limiter<real>::SetRelTime(real _release) {
-    release = std::max<real>(epsilon, _release);
-    expSmoother.SetRelTime(release);
+/* By default, the delay buffers hold 65536 samples, i.e., the look-ahead
+ * is limited to about 1.36 seconds at 48 kHz or 170 ms at 384 kHz. This 
+ * function sizes the buffers to the smallest power of two holding the 
+ * delay of the given attack time at the current sample rate, and the 
+ * buffers follow later sample rate changes. Attack times beyond the 
+ * capacity of the buffers are clipped. Not to be called while processing. */
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::SetMaxAttTime(real _maxAttack) {
+    ModifyCoefficients().SetMaxAttTime(_maxAttack);
+    UpdateDelay();
 }
 
-template<typename real>
-void Limiter<real>::SetThreshold(real _threshold) {
-    dBThreshold = std::max<real>(-120.0, _threshold);
-    linThreshold = std::pow(10.0, dBThreshold * .05);
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::SetDecimatedDetection(bool _decimatedDetection) {
+    ModifyCoefficients().SetDecimatedDetection(_decimatedDetection);
+    UpdateDelay();
 }
 
-template<typename real>
-void Limiter<real>::SetPreGain(real _preGain) {
-    dBPreGain = _preGain;
-    linPreGain = std::pow(10.0, dBPreGain * .05);
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::SetAttTime(real _attack) {
+    ModifyCoefficients().SetAttTime(_attack);
+    UpdateDelay();
 }
 
-template<typename real>
-void Limiter<real>::Reset() {
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::SetLookaheadSlack(size_t _lookaheadSlack) {
+    ModifyCoefficients().SetLookaheadSlack(_lookaheadSlack);
+    UpdateDelay();
+}
+
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::SetHoldTime(real _hold) {
+    ModifyCoefficients().SetHoldTime(_hold);
+}
+
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::SetRelTime(real _release) {
+    ModifyCoefficients().SetRelTime(_release);
+}
+
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::SetThreshold(real _threshold) {
+    ModifyCoefficients().SetThreshold(_threshold);
+}
+
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::SetPreGain(real _preGain) {
+    ModifyCoefficients().SetPreGain(_preGain);
+}
+
+/* Attaches the instance to a preset, whose blocks are then picked up by 
+ * Process, ProcessInterleaved, and ProcessHistory at the start of each 
+ * block; with ProcessGain and ApplyGain, UpdatePreset must be called 
+ * between blocks when neither path is running. Picking up a block takes
+ * no locks and frees no memory, see LimiterPreset.hpp. A null preset 
+ * detaches the instance, which keeps the current settings. Note that
+ * changing the maximum attack time of a preset resizes the delay buffers
+ * of the instances, which is not real-time safe. */
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::SetPreset(const Preset* _preset) {
+    if (_preset == nullptr) {
+        if (preset != nullptr) {
+            privateCoefficients = std::make_shared<Coefficients>(*coefficients);
+            coefficients = privateCoefficients.get();
+            presetCoefficients.Reset();
+        }
+        preset = nullptr;
+        return;
+    }
+    preset = _preset;
+    presetVersion = preset->GetVersion();
+    presetCoefficients = preset->Acquire();
+    coefficients = presetCoefficients.Get();
+    privateCoefficients.reset();
+    UpdateDelay();
+}
+
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+bool Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::UpdatePreset() {
+    if (preset == nullptr) {
+        return false;
+    }
+    uint64_t version = preset->GetVersion();
+    if (version == presetVersion) {
+        return false;
+    }
+    presetVersion = version;
+    presetCoefficients = preset->Acquire();
+    coefficients = presetCoefficients.Get();
+    UpdateDelay();
+    return true;
+}
+
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::Reset() {
     delay.Reset();
-    peakHolder.Reset();
-    expSmoother.Reset();
-}
-
-/* This function computes a lookahead limiting process deploying eight cascaded
- * peak-holder sections as approximation of a max filter, and four cascaded
- * one-pole smoothers for envelope following. Note that the process introduces
- * a delay in the input signal equal to the attack time. Given input and output
- * vectors, the function processes a block of vecLen samples of the input signal
- * and stores it in the output vector. */
-template<typename real>
-void Limiter<real>::Process(real** xVec, real** yVec, size_t vecLen) {
-    real* xLeft = xVec[0];
-    real* xRight = xVec[1];
-    real* yLeft = yVec[0];
-    real* yRight = yVec[1];
+    dither.Reset();
+    state.groupMax = .0;
+    state.gainPrevious = 1.0;
+    state.gainCurrent = 1.0;
+    state.groupPosition = 0;
+    state.expSmoother.Reset();
+    state.peakHolder.Reset();
+}
+
+/* This function computes the attenuation gain of a lookahead limiting 
+ * process deploying cascaded peak-holder sections (eight by default) as 
+ * approximation of a max filter, and cascaded one-pole smoothers (four by 
+ * default) for envelope following. The function processes a sub-block of at 
+ * most internalBlockLen frames, reading the input with the given stride,
+ * i.e., 1 for planar channels and 2 for interleaved stereo frames, and it
+ * stores the gain in gainVec. With aligned, the input vectors start on a
+ * cache line, which holds for the interleaved left channel only. */
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+template<size_t stride, bool aligned, typename sample>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::DetectBlock(
+        const sample* xLeft, const sample* xRight, audioReal* gainVec, size_t vecLen) {
+    const Coefficients& c = *coefficients;
+    if (c.decimation > 1) {
+        DetectBlockDecimated<stride, aligned>(xLeft, xRight, gainVec, vecLen);
+        return;
+    }
+    xLeft = AssumeAligned<aligned>(xLeft);
+    xRight = AssumeAligned<aligned && stride == 1>(xRight);
+    const real linPreGain = c.linPreGain;
+    const real linThreshold = c.linThreshold;
+    const real smoothParamCoeff = c.smoothParamCoeff;
+    real smoothPreGain = state.smoothPreGain;
+    real smoothThreshold = state.smoothThreshold;
+    Scratch& scratch = GetScratch();
+    real* envelope = AssumeAligned<true>(scratch.envelope);
+    real* threshold = AssumeAligned<true>(scratch.threshold);
+    typedef PcmFormat<sample> Format;
+    const real scale = real(Format::scale);
     
-    /* Apply the pre gain to the input samples. */
+    /* Apply the pre gain to the input samples and compute the max between 
+     * their absolute values for stereo processing. The scale of integer 
+     * samples is folded into the pre gain, which gives the same result as
+     * converting them first as the scale is a power of two. */
     for (size_t n = 0; n < vecLen; n++) {
-        smoothPreGain =
-            linPreGain + smoothParamCoeff * (smoothPreGain - linPreGain);
-        xLeft[n] *= smoothPreGain;
-        xRight[n] *= smoothPreGain;
+        smoothPreGain = numerics::MulAdd(smoothParamCoeff, smoothPreGain - linPreGain, linPreGain);
+        real inputGain = smoothPreGain * scale;
+        envelope[n] = std::max<real>(std::fabs(Format::template Read<real>(xLeft[n * stride]) * inputGain), 
+            std::fabs(Format::template Read<real>(xRight[n * stride]) * inputGain));
     }
 
-    /* Compute the max between inputs absolute values for stereo
-     * processing and store it in the left output vector. */
-    for (size_t n = 0; n < vecLen; n++) {
-        yLeft[n] = std::max<real>(std::fabs(xLeft[n]), std::fabs(xRight[n]));
-    }
-    
-    /* Compute the peak-hold envelope of the left and right input vectors and
-     * store it in the corresponding output vector. */
-    peakHolder.Process(yLeft, yLeft, vecLen);
+    /* Compute the peak-hold envelope of the stereo peak vector. */
+    Capture(peakSignal, envelope, vecLen);
+    PeakHolder::Process(c.peakHolder, state.peakHolder, 
+        envelope, envelope, vecLen);
+    Capture(holdSignal, envelope, vecLen);
 
     /* We clip the resulting vector to the threshold value so that input
-     * signals below this value are unaltered. We store the resulting
-     * values in the left output vector. Similarly, we store the
-     * smoothed out threshold parameter in the right output vector for
-     * later use. yLeft now contains the clipped peak-hold envelope,
-     * while yRight contains the smoothed out threshold parameter. */
+     * signals below this value are unaltered. Similarly, we store the
+     * smoothed out threshold parameter in the threshold vector for later use. 
+     * The envelope vector now contains the clipped peak-hold envelope. */
     for (size_t n = 0; n < vecLen; n++) {
-        smoothThreshold =
-            linThreshold + smoothParamCoeff * (smoothThreshold - linThreshold);
-        yLeft[n] = std::max<real>(yLeft[n], smoothThreshold);
-        yRight[n] = smoothThreshold;
+        smoothThreshold = numerics::MulAdd(smoothParamCoeff, smoothThreshold - linThreshold, linThreshold);
+        envelope[n] = std::max<real>(envelope[n], smoothThreshold);
+        threshold[n] = smoothThreshold;
     }
+    Capture(clipSignal, envelope, vecLen);
 
-    /* We smooth out the clipped peak envelope using four cascaded one-pole
+    /* We smooth out the clipped peak envelope using cascaded one-pole
      * branching sections with independent attack and release times.
-     * yLeft now contains a smooth envelope profile of the input signal. */
-    expSmoother.Process(yLeft, yLeft, vecLen);
+     * The envelope vector now contains a smooth envelope profile of the 
+     * input signal. */
+    ExpSmoother::Process(c.expSmoother, state.expSmoother, 
+        envelope, envelope, vecLen);
+    Capture(smoothSignal, envelope, vecLen);
 
     /* We compute the attenuation gain as the ratio between the limiting
-     * threshold and the envelope profile. Finally, we copy the resulting
-     * vector to both output vectors as the attenuation gain will be the
-     * same for both inputs. */
+     * threshold and the envelope profile. The attenuation gain is the same 
+     * for both inputs, and it is converted to the audio type here. */
     for (size_t n = 0; n < vecLen; n++) {
-        yLeft[n] = yRight[n] / yLeft[n];
-        yRight[n] = yLeft[n];
+        gainVec[n] = audioReal(numerics::Divide(threshold[n], envelope[n]));
     }
+    CaptureGain(gainVec, vecLen);
+    state.smoothPreGain = smoothPreGain;
+    state.smoothThreshold = smoothThreshold;
+}
+
+/* Stores the gain of a sub-block in the capture vectors and moves on to 
+ * the next sub-block. */
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::CaptureGain(
+        const audioReal* gainVec, size_t vecLen) {
+    if (captureVec == nullptr) {
+        return;
+    }
+    if (captureVec[gainSignal] != nullptr) {
+        real* y = captureVec[gainSignal] + captureOffset;
+        for (size_t n = 0; n < vecLen; n++) {
+            y[n] = real(gainVec[n]);
+        }
+    }
+    captureOffset += vecLen;
+}
+
+/* This function is the counterpart of DetectBlock for decimated detection.
+ * The stereo peaks are reduced to their maximum over groups of decimation 
+ * samples, which may span sub-blocks, and the peak-holder, the threshold
+ * clipping, and the smoother process one value per group. During each 
+ * group, the gain is interpolated between the last two group gains, i.e., 
+ * with a latency of up to two groups, which is taken from the look-ahead. */
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+template<size_t stride, bool aligned, typename sample>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::DetectBlockDecimated(
+        const sample* xLeft, const sample* xRight, audioReal* gainVec, size_t vecLen) {
+    xLeft = AssumeAligned<aligned>(xLeft);
+    xRight = AssumeAligned<aligned && stride == 1>(xRight);
+    const Coefficients& c = *coefficients;
+    const real linPreGain = c.linPreGain;
+    const real linThreshold = c.linThreshold;
+    const real smoothParamCoeff = c.smoothParamCoeff;
+    const size_t decimation = c.decimation;
+    const real oneOverDecimation = c.oneOverDecimation;
+    real smoothPreGain = state.smoothPreGain;
+    real smoothThreshold = state.smoothThreshold;
+    real groupMax = state.groupMax;
+    real gainPrevious = state.gainPrevious;
+    real gainCurrent = state.gainCurrent;
+    size_t groupPosition = state.groupPosition;
+    Scratch& scratch = GetScratch();
+    real* envelope = AssumeAligned<true>(scratch.envelope);
+    real* threshold = AssumeAligned<true>(scratch.threshold);
+    typedef PcmFormat<sample> Format;
+    const real scale = real(Format::scale);
+    
+    /* Group the stereo peaks. The envelope vector stores the group maxima 
+     * and the threshold vector stores the threshold at the end of each
+     * group. */
+    size_t groups = 0;
+    size_t position = groupPosition;
+    for (size_t n = 0; n < vecLen; n++) {
+        smoothPreGain = numerics::MulAdd(smoothParamCoeff, smoothPreGain - linPreGain, linPreGain);
+        smoothThreshold = numerics::MulAdd(smoothParamCoeff, smoothThreshold - linThreshold, linThreshold);
+        real inputGain = smoothPreGain * scale;
+        real peak = std::max<real>(std::fabs(Format::template Read<real>(xLeft[n * stride]) * inputGain), 
+            std::fabs(Format::template Read<real>(xRight[n * stride]) * inputGain));
+        groupMax = std::max<real>(groupMax, peak);
+        if (++position == decimation) {
+            envelope[groups] = groupMax;
+            threshold[groups] = smoothThreshold;
+            groups++;
+            groupMax = .0;
+            position = 0;
+        }
+    }
+
+    /* Compute the gain of each group as in DetectBlock. */
+    PeakHolder::Process(c.peakHolder, state.peakHolder, 
+        envelope, envelope, groups);
+    for (size_t k = 0; k < groups; k++) {
+        envelope[k] = std::max<real>(envelope[k], threshold[k]);
+    }
+    ExpSmoother::Process(c.expSmoother, state.expSmoother, 
+        envelope, envelope, groups);
+    for (size_t k = 0; k < groups; k++) {
+        envelope[k] = numerics::Divide(threshold[k], envelope[k]);
+    }
+
+    /* Interpolate the gain at the full rate. */
+    size_t k = 0;
+    for (size_t n = 0; n < vecLen; n++) {
+        groupPosition++;
+        gainVec[n] = audioReal(numerics::MulAdd(gainCurrent - gainPrevious, 
+            real(groupPosition) * oneOverDecimation, gainPrevious));
+        if (groupPosition == decimation) {
+            gainPrevious = gainCurrent;
+            gainCurrent = envelope[k++];
+            groupPosition = 0;
+        }
+    }
+    CaptureGain(gainVec, vecLen);
+    state.smoothPreGain = smoothPreGain;
+    state.smoothThreshold = smoothThreshold;
+    state.groupMax = groupMax;
+    state.gainPrevious = gainPrevious;
+    state.gainCurrent = gainCurrent;
+    state.groupPosition = groupPosition;
+}
+
+/* This function applies the pre gain and the look-ahead delay to a 
+ * sub-block of the input and multiplies the result by the given attenuation
+ * gain. Note that the process introduces a delay in the input signal equal 
+ * to the attack time. The delayed signals are kept in the internal scratch 
+ * vectors, hence the input and output may point to the same memory. The 
+ * pre gain is smoothed independently of the detection path, which produces 
+ * the same values and allows the two paths to run on different threads. */
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+template<size_t stride, bool aligned, typename sample, typename outputSample>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::ApplyBlock(
+        const sample* xLeft, const sample* xRight, const audioReal* gainVec, 
+        outputSample* yLeft, outputSample* yRight, size_t vecLen) {
+    xLeft = AssumeAligned<aligned>(xLeft);
+    xRight = AssumeAligned<aligned && stride == 1>(xRight);
+    const real linPreGain = coefficients->linPreGain;
+    const real smoothParamCoeff = coefficients->smoothParamCoeff;
+    real smoothPreGainAudio = state.smoothPreGainAudio;
+    Scratch& scratch = GetScratch();
+    audioReal* audioLeft = AssumeAligned<true>(scratch.audioLeft);
+    audioReal* audioRight = AssumeAligned<true>(scratch.audioRight);
+    audioReal* audioGain = AssumeAligned<true>(scratch.audioGain);
+    audioReal* audio[2] = { audioLeft, audioRight };
+    const audioReal* outputGain = gainVec;
+    typedef PcmFormat<sample> Format;
+    const real scale = real(Format::scale);
+    if (Storage::fixedPoint) {
+
+        /* Fixed-point delay buffers cannot hold the amplified signal, hence 
+         * the pre gain is applied after the delay together with the 
+         * attenuation gain. */
+        for (size_t n = 0; n < vecLen; n++) {
+            smoothPreGainAudio = 
+                numerics::MulAdd(smoothParamCoeff, smoothPreGainAudio - linPreGain, linPreGain);
+            audioLeft[n] = Format::template Read<audioReal>(xLeft[n * stride]) * audioReal(scale);
+            audioRight[n] = Format::template Read<audioReal>(xRight[n * stride]) * audioReal(scale);
+            audioGain[n] = gainVec[n] * audioReal(smoothPreGainAudio);
+        }
+        outputGain = audioGain;
+    } else {
+        for (size_t n = 0; n < vecLen; n++) {
+            smoothPreGainAudio = 
+                numerics::MulAdd(smoothParamCoeff, smoothPreGainAudio - linPreGain, linPreGain);
+            audioReal inputGain = audioReal(smoothPreGainAudio * scale);
+            audioLeft[n] = Format::template Read<audioReal>(xLeft[n * stride]) * inputGain;
+            audioRight[n] = Format::template Read<audioReal>(xRight[n * stride]) * inputGain;
+        }
+    }
+    state.smoothPreGainAudio = smoothPreGainAudio;
 
     /* We apply the look-ahead delay to synchronise the input signals and the
-     * attenuation gain. */
-    delay.Process(xVec, xVec, vecLen);
+     * attenuation gain. Without an active crossfade, the delayed inputs are 
+     * read in place from the delay buffers. */
+    if (delay.IsSteady()) {
+        delay.Write(audio, vecLen);
+        WriteDelayed<stride, aligned>(outputGain, yLeft, 0, vecLen);
+        WriteDelayed<stride, aligned && stride == 1>(outputGain, yRight, 1, vecLen);
+        dither.Advance(vecLen);
+        CheckOutput<stride>(yLeft, yRight, vecLen);
+        return;
+    }
+    delay.Process(audio, audio, vecLen);
 
     /* Lastly, we apply the attenuation gain to the delayed inputs and store
      * the result in the output vectors. */
+    WriteOutput<stride, aligned>(outputGain, audioLeft, yLeft, 0, 0, vecLen);
+    WriteOutput<stride, aligned && stride == 1>(outputGain, audioRight, yRight, 1, 0, vecLen);
+    dither.Advance(vecLen);
+    CheckOutput<stride>(yLeft, yRight, vecLen);
+}
+
+/* This function writes a channel read in place from the delay buffer, 
+ * which may wrap around in two spans; the second span does not start on a
+ * cache line of the output. */
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+template<size_t stride, bool aligned, typename outputSample>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::WriteDelayed(
+        const audioReal* gainVec, outputSample* y, size_t channel, size_t vecLen) {
+    typename DelaySmooth<uint32_t, audioReal, delayStorage, delayAllocator, numerics>::Span span = 
+        delay.ReadSpan(channel, delay.GetDelay(), vecLen);
+    WriteOutput<stride, aligned>(gainVec, span.data[0], y, channel, 0, span.len[0]);
+    WriteOutput<stride, false>(gainVec + span.len[0], span.data[1], y + span.len[0] * stride, 
+        channel, span.len[0], span.len[1]);
+}
+
+/* This function multiplies vecLen samples of a delayed channel, held as
+ * audioReal or in the delay storage, by the attenuation gain and stores the
+ * result in the output with the given stride. Integer outputs are scaled to
+ * LSB, dithered, and quantised; frame is the position of the samples in the
+ * current sub-block, which indexes the dither. Without noise shaping, the
+ * scaled channel and the dither are computed into contiguous scratch
+ * vectors first, and they are summed through the numerics policy, so that
+ * every loop vectorises and only the last one uses the stride. */
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+template<size_t stride, bool aligned, typename input, typename outputSample>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::WriteOutput(
+        const audioReal* gainVec, const input* x, outputSample* y, 
+        size_t channel, size_t frame, size_t vecLen) {
+    y = AssumeAligned<aligned>(y);
+    typedef PcmFormat<outputSample> Format;
+    typedef DelayStorage<audioReal, input> Input;
+    if (!Format::integer) {
+        for (size_t n = 0; n < vecLen; n++) {
+            y[n * stride] = Format::template Write<audioReal>(gainVec[n] * Input::Load(x[n]));
+        }
+        return;
+    }
+    const audioReal outputScale = audioReal(1.0 / Format::scale);
+    const uint32_t index = dither.GetFrame() + uint32_t(frame);
+    const uint32_t seed = dither.GetSeed();
+    const audioReal amplitude = dither.GetAmplitude();
+    if (dither.IsShaped()) {
+        for (size_t n = 0; n < vecLen; n++) {
+            y[n * stride] = dither.template QuantiseShaped<outputSample, numerics>(
+                gainVec[n] * Input::Load(x[n]) * outputScale, index + uint32_t(n), channel);
+        }
+        return;
+    }
+    Scratch& scratch = GetScratch();
+    audioReal* output = AssumeAligned<true>(scratch.output);
+    audioReal* noise = AssumeAligned<true>(scratch.noise);
+    for (size_t n = 0; n < vecLen; n++) {
+        output[n] = gainVec[n] * Input::Load(x[n]);
+    }
+    /* The noise is hashed in groups of a fixed number of lanes, which
+     * vectorise also under the cheap cost model of -O2; the last group may
+     * run past vecLen into the scratch, whose length is a multiple of it. */
+    const size_t lanes = 16;
+    static_assert(internalBlockLen % lanes == 0, "The scratch must hold whole groups of lanes.");
+    for (size_t n = 0; n < vecLen; n += lanes) {
+        for (size_t l = 0; l < lanes; l++) {
+            noise[n + l] = amplitude * Dither<audioReal>::Noise(seed, index + uint32_t(n + l), channel);
+        }
+    }
+    numerics::MulAddVec(output, outputScale, noise, output, vecLen);
+    for (size_t n = 0; n < vecLen; n++) {
+        y[n * stride] = Format::template Write<audioReal>(output[n]);
+    }
+}
+
+/* This function is the counterpart of ApplyBlock for ProcessHistory: the 
+ * delayed input is read from the current block and from the history kept by 
+ * the caller, hence the pre gain is applied to the delayed signal together
+ * with the attenuation gain. */
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::ApplyHistoryBlock(
+        const audioReal* const* xVec, const audioReal* const* historyVec, size_t historyLen, 
+        size_t offset, const audioReal* gainVec, audioReal* const* yVec, size_t vecLen) {
+    const real linPreGain = coefficients->linPreGain;
+    const real smoothParamCoeff = coefficients->smoothParamCoeff;
+    real smoothPreGainAudio = state.smoothPreGainAudio;
+    Scratch& scratch = GetScratch();
+    audioReal* audioLeft = scratch.audioLeft;
+    audioReal* audioRight = scratch.audioRight;
+    audioReal* audio[2] = { audioLeft, audioRight };
+    delay.ProcessView(historyVec, historyLen, xVec, offset, audio, vecLen);
     for (size_t n = 0; n < vecLen; n++) {
-        yLeft[n] *= xLeft[n];
-        yRight[n] *= xRight[n];
+        smoothPreGainAudio = 
+            numerics::MulAdd(smoothParamCoeff, smoothPreGainAudio - linPreGain, linPreGain);
+        audioReal totalGain = gainVec[n] * audioReal(smoothPreGainAudio);
+        yVec[0][offset + n] = totalGain * audioLeft[n];
+        yVec[1][offset + n] = totalGain * audioRight[n];
+    }
+    state.smoothPreGainAudio = smoothPreGainAudio;
+    CheckOutput<1>(yVec[0] + offset, yVec[1] + offset, vecLen);
+}
+
+/* Given input and output vectors, the function processes a block of vecLen
+ * samples of the input signal and stores the attenuation gain in gainVec. 
+ * Together with ApplyGain, this splits Process into a detection and an
+ * application path that only share the parameters. */
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::ProcessGain(const audioReal* const* xVec, audioReal* gainVec, size_t vecLen) {
+    for (size_t offset = 0; offset < vecLen; offset += internalBlockLen) {
+        size_t blockLen = std::min(internalBlockLen, vecLen - offset);
+        DetectBlock<1, false>(xVec[0] + offset, xVec[1] + offset, gainVec + offset, blockLen);
+    }
+}
+
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::ApplyGain(const audioReal* const* xVec, const audioReal* gainVec, audioReal* const* yVec, size_t vecLen) {
+    for (size_t offset = 0; offset < vecLen; offset += internalBlockLen) {
+        size_t blockLen = std::min(internalBlockLen, vecLen - offset);
+        ApplyBlock<1, false>(xVec[0] + offset, xVec[1] + offset, gainVec + offset, 
+            yVec[0] + offset, yVec[1] + offset, blockLen);
+    }
+}
+
+/* Given planar input and output vectors, the function processes a block of 
+ * vecLen samples of the input signal and stores it in the output vector. 
+ * The processing can take place in place. The input and the output can 
+ * also be integer PCM, see Pcm.hpp, which is converted while it is read
+ * and dithered and quantised while it is written. The vectors are aligned
+ * when given as the planar views of AudioBuffer; the sub-blocks keep the
+ * alignment as internalBlockLen samples span whole cache lines. */
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+template<bool aligned, typename sample, typename outputSample>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::ProcessBlocks(const sample* const* xVec, outputSample* const* yVec, size_t vecLen) {
+    UpdatePreset();
+    audioReal* gain = AssumeAligned<true>(GetScratch().gain);
+    for (size_t offset = 0; offset < vecLen; offset += internalBlockLen) {
+        size_t blockLen = std::min(internalBlockLen, vecLen - offset);
+        DetectBlock<1, aligned>(xVec[0] + offset, xVec[1] + offset, gain, blockLen);
+        ApplyBlock<1, aligned>(xVec[0] + offset, xVec[1] + offset, gain, 
+            yVec[0] + offset, yVec[1] + offset, blockLen);
+    }
+}
+
+/* Given planar input and output vectors, the function processes a block of 
+ * vecLen samples like Process, but the look-ahead delay reads the input 
+ * directly from the current block and from the history kept by the caller
+ * rather than from the internal delay buffers, so no input is copied. 
+ * historyVec points to the historyLen input samples of each channel that 
+ * precede the current block, e.g., the previous block, and historyLen should 
+ * be at least GetLatency() samples; older samples are read as zeros. The 
+ * output must not overlap with the input or the history. With 
+ * SetHistoryMode(true), the internal delay buffers are released; Process, 
+ * ProcessInterleaved, and ApplyGain must not be called in this mode. */
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::ProcessHistory(
+        const audioReal* const* xVec, const audioReal* const* historyVec, size_t historyLen, 
+        audioReal* const* yVec, size_t vecLen) {
+    UpdatePreset();
+    audioReal* gain = AssumeAligned<true>(GetScratch().gain);
+    for (size_t offset = 0; offset < vecLen; offset += internalBlockLen) {
+        size_t blockLen = std::min(internalBlockLen, vecLen - offset);
+        DetectBlock<1, false>(xVec[0] + offset, xVec[1] + offset, gain, blockLen);
+        ApplyHistoryBlock(xVec, historyVec, historyLen, offset, gain, yVec, blockLen);
+    }
+}
+
+/* Given interleaved stereo input and output vectors, the function processes 
+ * vecLen frames of the input signal and stores them in the output vector.
+ * The processing can take place in place, and the input and the output can
+ * be integer PCM as for Process. The vectors are aligned when given as the
+ * interleaved views of two-channel AudioBuffers. */
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+template<bool aligned, typename sample, typename outputSample>
+void Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::ProcessInterleavedBlocks(const sample* xVec, outputSample* yVec, size_t vecLen) {
+    UpdatePreset();
+    audioReal* gain = AssumeAligned<true>(GetScratch().gain);
+    for (size_t offset = 0; offset < vecLen; offset += internalBlockLen) {
+        size_t blockLen = std::min(internalBlockLen, vecLen - offset);
+        const sample* x = xVec + 2 * offset;
+        outputSample* y = yVec + 2 * offset;
+        DetectBlock<2, aligned>(x, x + 1, gain, blockLen);
+        ApplyBlock<2, aligned>(x, x + 1, gain, y, y + 1, blockLen);
     }
 }
 
-template<typename real>
-Limiter<real>::Limiter(real _SR, real _dBPreGain, real _attack, real _hold, real _release, real _dBThreshold) {
-    SR = std::max<real>(1.0, _SR);
-    dBPreGain = _dBPreGain;
-    attack = std::max<real>(epsilon, _attack);
-    hold = std::max<real>(.0, _hold);
-    release = std::max<real>(epsilon, _release);
-    dBThreshold = std::max<real>(-120.0, _dBThreshold);
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename delayStorage, typename delayAllocator, 
+    typename detectorState, typename numerics, typename audioReal>
+Limiter<real, numberOfPeakHoldSections, numberOfSmoothSections, delayStorage, delayAllocator, detectorState, numerics, audioReal>::Limiter(real _SR, real _dBPreGain, real _attack, real _hold, real _release, real _dBThreshold) {
+    Coefficients& c = ModifyCoefficients();
+    c.SR = std::max<real>(1.0, _SR);
+    c.dBPreGain = _dBPreGain;
+    c.attack = std::max<real>(c.epsilon, _attack);
+    c.hold = std::max<real>(.0, _hold);
+    c.release = std::max<real>(c.epsilon, _release);
+    c.dBThreshold = std::max<real>(-120.0, _dBThreshold);
 }
+
+template<size_t numberOfPeakHoldSections = 8, size_t numberOfSmoothSections = 4, typename numerics = StrictNumerics>
+using LimiterMixedPrecision = Limiter<double, numberOfPeakHoldSections, numberOfSmoothSections, float, 
+    std::allocator<float>, double, numerics, float>;
@@ -0,0 +1,515 @@
+/*******************************************************************************
+ *
+ * Batch renderer applying the Limiter class to many raw interleaved stereo
+ * files of native-endian samples, e.g., game audio clips and voice lines.
+ *
+ * Two I/O backends are available:
+ *
+ * - RunPlain processes one file at a time with blocking open, read, write,
+ *   and close calls.
+ *
+ * - RunUring keeps up to filesInFlight files in flight on a single thread
+ *   using io_uring (Linux). Opening, reading, writing, and closing are
+ *   queued as asynchronous operations and submitted in batches with one
+ *   system call per iteration. Each file in flight owns a block buffer that
+ *   is registered with the kernel for fixed-buffer reads and writes and that
+ *   is processed in place by the limiter. When io_uring is not available,
+ *   RunUring falls back to RunPlain, as reported in BatchReport::backend.
+ *
+ * Every file in flight owns a Limiter instance, which is settled on silence
+ * once and reset before each file. Reset clears the signal state only, so 
+ * that every file starts from the settled parameters and its output does 
+ * not depend on the backend or on the files processed before it. The look-ahead
+ * delay is compensated for by default as in LimiterFilePipeline.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Limiter.hpp"
+#include "IoUring.hpp"
+
+struct BatchJob {
+    std::string inputPath;
+    std::string outputPath;
+};
+
+struct BatchReport {
+    size_t files = 0; // Files processed successfully.
+    size_t failures = 0;
+    size_t frames = 0; // Frames written.
+    double seconds = .0;
+    const char* backend = "";
+};
+
+template<typename real>
+class LimiterBatch {
+    private:
+        enum { idle, opening, reading, writing, closing };
+
+        struct Slot {
+            std::unique_ptr<Limiter<real>> limiter;
+            real* buffer = nullptr; // Interleaved stereo block.
+            size_t job = 0;
+            int inputFd = -1;
+            int outputFd = -1;
+            int state = idle;
+            unsigned pendingOps = 0;
+            off_t readOffset = 0;
+            off_t writeOffset = 0;
+            size_t filledBytes = 0;
+            size_t writeBytes = 0;
+            size_t writtenBytes = 0;
+            size_t skipFrames = 0;
+            size_t tailFrames = 0;
+            bool endOfFile = false;
+            bool done = false;
+            bool failed = false;
+        };
+
+        real SR = 48000.0;
+        real attack = .01;
+        real hold = .0;
+        real release = .05;
+        real threshold = -.3;
+        real preGain = .0;
+        size_t blockFrames = 65536;
+        size_t filesInFlight = 16;
+        bool compensateLatency = true;
+        const size_t frameBytes = 2 * sizeof(real);
+        std::vector<Slot> slots;
+
+        void AllocateSlots(size_t numberOfSlots);
+        void FreeSlots();
+        void StartFile(Slot& slot, size_t job);
+        size_t ProcessBuffer(Slot& slot);
+        bool RunPlainFile(Slot& slot, const BatchJob& job, BatchReport& report);
+        static double Now() {
+            using namespace std::chrono;
+            return duration<double>(steady_clock::now().time_since_epoch()).count();
+        };
+
+    public:
+        void SetSR(real _SR) { SR = _SR; };
+        void SetAttTime(real _attack) { attack = _attack; };
+        void SetHoldTime(real _hold) { hold = _hold; };
+        void SetRelTime(real _release) { release = _release; };
+        void SetThreshold(real _threshold) { threshold = _threshold; };
+        void SetPreGain(real _preGain) { preGain = _preGain; };
+        void SetBlockFrames(size_t _blockFrames) { blockFrames = std::max<size_t>(1, _blockFrames); };
+        void SetFilesInFlight(size_t _filesInFlight) { filesInFlight = std::max<size_t>(1, _filesInFlight); };
+        void SetCompensateLatency(bool _compensateLatency) { compensateLatency = _compensateLatency; };
+        BatchReport RunPlain(const std::vector<BatchJob>& jobs);
+        BatchReport RunUring(const std::vector<BatchJob>& jobs);
+        ~LimiterBatch() { FreeSlots(); };
+};
+
+template<typename real>
+void LimiterBatch<real>::AllocateSlots(size_t numberOfSlots) {
+    FreeSlots();
+    slots.resize(numberOfSlots);
+    size_t bytes = (blockFrames * frameBytes + 4095) & ~size_t(4095);
+    std::vector<real> silence(2 * blockFrames, .0);
+    for (Slot& slot : slots) {
+        slot.buffer = static_cast<real*>(std::aligned_alloc(4096, bytes));
+        slot.limiter.reset(new Limiter<real>());
+        Limiter<real>& limiter = *slot.limiter;
+        limiter.SetSR(SR);
+        limiter.SetAttTime(attack);
+        limiter.SetHoldTime(hold);
+        limiter.SetRelTime(release);
+        limiter.SetThreshold(threshold);
+        limiter.SetPreGain(preGain);
+        limiter.Reset();
+
+        /* Settle the parameter smoothers and the delay crossfade on one
+         * second of silence. The reset in StartFile keeps them settled. */
+        for (size_t n = 0; n < size_t(SR); n += blockFrames) {
+            size_t len = std::min(blockFrames, size_t(SR) - n);
+            limiter.ProcessInterleaved(silence.data(), silence.data(), len);
+        }
+    }
+}
+
+template<typename real>
+void LimiterBatch<real>::FreeSlots() {
+    for (Slot& slot : slots) {
+        std::free(slot.buffer);
+    }
+    slots.clear();
+}
+
+template<typename real>
+void LimiterBatch<real>::StartFile(Slot& slot, size_t job) {
+    slot.limiter->Reset();
+    slot.job = job;
+    slot.inputFd = -1;
+    slot.outputFd = -1;
+    slot.readOffset = 0;
+    slot.writeOffset = 0;
+    slot.filledBytes = 0;
+    slot.skipFrames = compensateLatency ? slot.limiter->GetLatency() : 0;
+    slot.tailFrames = slot.skipFrames;
+    slot.endOfFile = false;
+    slot.done = false;
+    slot.failed = false;
+}
+
+/* Processes the frames read into the slot buffer, appending the zeros that
+ * flush the look-ahead delay at the end of the file and dropping the leading
+ * frames of the delay. Returns the number of frames to write, which are
+ * stored at the beginning of the buffer. */
+template<typename real>
+size_t LimiterBatch<real>::ProcessBuffer(Slot& slot) {
+    size_t frames = slot.filledBytes / frameBytes;
+    slot.filledBytes = 0;
+    if (slot.endOfFile) {
+        size_t zeros = std::min(slot.tailFrames, blockFrames - frames);
+        std::memset(slot.buffer + 2 * frames, 0, zeros * frameBytes);
+        frames += zeros;
+        slot.tailFrames -= zeros;
+        slot.done = slot.tailFrames == 0;
+    }
+    slot.limiter->ProcessInterleaved(slot.buffer, slot.buffer, frames);
+    size_t skip = std::min(slot.skipFrames, frames);
+    if (skip > 0) {
+        std::memmove(slot.buffer, slot.buffer + 2 * skip, (frames - skip) * frameBytes);
+        slot.skipFrames -= skip;
+    }
+    return frames - skip;
+}
+
+template<typename real>
+bool LimiterBatch<real>::RunPlainFile(Slot& slot, const BatchJob& job, BatchReport& report) {
+    slot.inputFd = open(job.inputPath.c_str(), O_RDONLY);
+    slot.outputFd = open(job.outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool ok = slot.inputFd >= 0 && slot.outputFd >= 0;
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(slot.buffer);
+    const size_t capacity = blockFrames * frameBytes;
+    while (ok && !slot.done) {
+        while (!slot.endOfFile && slot.filledBytes < capacity) {
+            ssize_t result = read(slot.inputFd, bytes + slot.filledBytes, capacity - slot.filledBytes);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result < 0) {
+                ok = false;
+                break;
+            }
+            slot.endOfFile = result == 0;
+            slot.filledBytes += size_t(result);
+        }
+        if (!ok) {
+            break;
+        }
+        size_t frames = ProcessBuffer(slot);
+        size_t len = frames * frameBytes;
+        size_t written = 0;
+        while (written < len) {
+            ssize_t result = write(slot.outputFd, bytes + written, len - written);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result <= 0) {
+                ok = false;
+                break;
+            }
+            written += size_t(result);
+        }
+        report.frames += frames;
+    }
+    if (slot.inputFd >= 0) {
+        close(slot.inputFd);
+    }
+    if (slot.outputFd >= 0) {
+        close(slot.outputFd);
+    }
+    return ok;
+}
+
+template<typename real>
+BatchReport LimiterBatch<real>::RunPlain(const std::vector<BatchJob>& jobs) {
+    BatchReport report;
+    report.backend = "read/write";
+    AllocateSlots(1);
+    double t0 = Now();
+    for (size_t job = 0; job < jobs.size(); job++) {
+        StartFile(slots[0], job);
+        if (RunPlainFile(slots[0], jobs[job], report)) {
+            report.files++;
+        } else {
+            report.failures++;
+        }
+    }
+    report.seconds = Now() - t0;
+    return report;
+}
+
+#ifdef LIMITER_HAVE_IO_URING
+
+template<typename real>
+BatchReport LimiterBatch<real>::RunUring(const std::vector<BatchJob>& jobs) {
+    const size_t numberOfSlots = std::min(filesInFlight, std::max<size_t>(1, jobs.size()));
+    IoUring ring;
+    if (!ring.Init(unsigned(4 * numberOfSlots))) {
+        return RunPlain(jobs);
+    }
+    AllocateSlots(numberOfSlots);
+    std::vector<iovec> buffers(numberOfSlots);
+    for (size_t i = 0; i < numberOfSlots; i++) {
+        buffers[i].iov_base = slots[i].buffer;
+        buffers[i].iov_len = blockFrames * frameBytes;
+    }
+    if (!ring.RegisterBuffers(buffers.data(), unsigned(numberOfSlots))) {
+        return RunPlain(jobs);
+    }
+
+    BatchReport report;
+    report.backend = "io_uring";
+    const size_t capacity = blockFrames * frameBytes;
+    size_t nextJob = 0;
+    size_t active = 0;
+    double t0 = Now();
+
+    /* A full submission queue is submitted before queueing more entries.
+     * If that fails, the batch stops and the files in flight fail. */
+    bool ringFailed = false;
+    auto getSqe = [&]() {
+        io_uring_sqe* sqe = ring.GetSqeOrSubmit();
+        ringFailed = ringFailed || sqe == nullptr;
+        return sqe;
+    };
+
+    /* Operations are identified by the slot index and a tag for the file
+     * descriptor they concern, 0 for the input and 1 for the output. */
+    auto queueOpen = [&](size_t index) {
+        Slot& slot = slots[index];
+        const BatchJob& job = jobs[slot.job];
+        slot.state = opening;
+        slot.pendingOps = 2;
+        io_uring_sqe* sqe = getSqe();
+        if (sqe == nullptr) {
+            return;
+        }
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(job.inputPath.c_str());
+        sqe->open_flags = O_RDONLY;
+        sqe->user_data = index << 1;
+        sqe = getSqe();
+        if (sqe == nullptr) {
+            return;
+        }
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(job.outputPath.c_str());
+        sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC;
+        sqe->len = 0644;
+        sqe->user_data = (index << 1) | 1;
+    };
+    auto queueRead = [&](size_t index) {
+        Slot& slot = slots[index];
+        slot.state = reading;
+        slot.pendingOps = 1;
+        io_uring_sqe* sqe = getSqe();
+        if (sqe == nullptr) {
+            return;
+        }
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->fd = slot.inputFd;
+        sqe->addr = reinterpret_cast<uint64_t>(slot.buffer) + slot.filledBytes;
+        sqe->len = unsigned(capacity - slot.filledBytes);
+        sqe->off = uint64_t(slot.readOffset);
+        sqe->buf_index = uint16_t(index);
+        sqe->user_data = index << 1;
+    };
+    auto queueWrite = [&](size_t index) {
+        Slot& slot = slots[index];
+        slot.state = writing;
+        slot.pendingOps = 1;
+        io_uring_sqe* sqe = getSqe();
+        if (sqe == nullptr) {
+            return;
+        }
+        sqe->opcode = IORING_OP_WRITE_FIXED;
+        sqe->fd = slot.outputFd;
+        sqe->addr = reinterpret_cast<uint64_t>(slot.buffer) + slot.writtenBytes;
+        sqe->len = unsigned(slot.writeBytes - slot.writtenBytes);
+        sqe->off = uint64_t(slot.writeOffset);
+        sqe->buf_index = uint16_t(index);
+        sqe->user_data = (index << 1) | 1;
+    };
+    auto queueClose = [&](size_t index) {
+        Slot& slot = slots[index];
+        slot.state = closing;
+        slot.pendingOps = 0;
+        int fds[2] = { slot.inputFd, slot.outputFd };
+        for (size_t i = 0; i < 2; i++) {
+            if (fds[i] >= 0) {
+                io_uring_sqe* sqe = getSqe();
+                if (sqe == nullptr) {
+                    return;
+                }
+                if (i == 0) {
+                    slot.inputFd = -1;
+                } else {
+                    slot.outputFd = -1;
+                }
+                sqe->opcode = IORING_OP_CLOSE;
+                sqe->fd = fds[i];
+                sqe->user_data = (index << 1) | i;
+                slot.pendingOps++;
+            }
+        }
+    };
+    auto queueNextJob = [&](size_t index) {
+        if (nextJob < jobs.size()) {
+            StartFile(slots[index], nextJob++);
+            queueOpen(index);
+            active++;
+        } else {
+            slots[index].state = idle;
+        }
+    };
+
+    /* Process the buffer and write it, or move on to closing the file. */
+    auto processAndWrite = [&](size_t index) {
+        Slot& slot = slots[index];
+        size_t frames = ProcessBuffer(slot);
+        report.frames += frames;
+        slot.writeBytes = frames * frameBytes;
+        slot.writtenBytes = 0;
+        if (slot.writeBytes > 0) {
+            queueWrite(index);
+        } else if (slot.done) {
+            queueClose(index);
+        } else {
+            queueRead(index);
+        }
+    };
+
+    for (size_t i = 0; i < numberOfSlots; i++) {
+        queueNextJob(i);
+    }
+
+    while (active > 0 && !ringFailed) {
+        if (ring.Submit(1) < 0 && errno != EINTR) {
+            ringFailed = true;
+            break;
+        }
+        io_uring_cqe cqe;
+        while (ring.PopCqe(cqe)) {
+            size_t index = size_t(cqe.user_data >> 1);
+            size_t tag = size_t(cqe.user_data & 1);
+            Slot& slot = slots[index];
+            slot.pendingOps--;
+            switch (slot.state) {
+                case opening:
+                    if (cqe.res < 0) {
+                        slot.failed = true;
+                    } else if (tag == 0) {
+                        slot.inputFd = cqe.res;
+                    } else {
+                        slot.outputFd = cqe.res;
+                    }
+                    if (slot.pendingOps == 0) {
+                        if (slot.failed) {
+                            queueClose(index);
+                        } else {
+                            queueRead(index);
+                        }
+                    }
+                    break;
+                case reading:
+                    if (cqe.res < 0) {
+                        slot.failed = true;
+                        queueClose(index);
+                        break;
+                    }
+                    slot.endOfFile = cqe.res == 0;
+                    slot.filledBytes += size_t(cqe.res);
+                    slot.readOffset += cqe.res;
+                    if (!slot.endOfFile && slot.filledBytes < capacity) {
+                        queueRead(index);
+                    } else {
+                        processAndWrite(index);
+                    }
+                    break;
+                case writing:
+                    if (cqe.res <= 0) {
+                        slot.failed = true;
+                        queueClose(index);
+                        break;
+                    }
+                    slot.writtenBytes += size_t(cqe.res);
+                    slot.writeOffset += cqe.res;
+                    if (slot.writtenBytes < slot.writeBytes) {
+                        queueWrite(index);
+                    } else if (slot.done) {
+                        queueClose(index);
+                    } else if (slot.endOfFile) {
+
+                        /* The tail of the delay did not fit in one block. */
+                        processAndWrite(index);
+                    } else {
+                        queueRead(index);
+                    }
+                    break;
+                case closing:
+                    if (slot.pendingOps == 0) {
+                        if (slot.failed) {
+                            report.failures++;
+                        } else {
+                            report.files++;
+                        }
+                        active--;
+                        queueNextJob(index);
+                    }
+                    break;
+            }
+
+            /* A slot whose files failed to open has nothing to close. */
+            if (slot.state == closing && slot.pendingOps == 0) {
+                report.failures++;
+                active--;
+                queueNextJob(index);
+            }
+        }
+    }
+    if (ringFailed) {
+        report.failures += active;
+        for (Slot& slot : slots) {
+            if (slot.inputFd >= 0) {
+                close(slot.inputFd);
+            }
+            if (slot.outputFd >= 0) {
+                close(slot.outputFd);
+            }
+        }
+    }
+    report.seconds = Now() - t0;
+    return report;
+}
+
+#else
+
+template<typename real>
+BatchReport LimiterBatch<real>::RunUring(const std::vector<BatchJob>& jobs) {
+    return RunPlain(jobs);
+}
+
+#endif
@@ -0,0 +1,167 @@
+/*******************************************************************************
+ *
+ * C interface to the Limiter class. See LimiterC.h.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#include <new>
+#include "LimiterC.h"
+#include "Limiter.hpp"
+
+/* The handle owns exactly one of the two instances, depending on the
+ * precision requested at creation time. */
+struct limiter {
+    limiter_precision precision;
+    Limiter<float>* limiterF32;
+    Limiter<double>* limiterF64;
+};
+
+/* Apply a parameter setter to whichever instance the handle owns. */
+template<typename function>
+static int Apply(limiter* handle, function setter) {
+    if (handle == nullptr) {
+        return LIMITER_ERROR_NULL;
+    }
+    if (handle->precision == LIMITER_F32) {
+        setter(*handle->limiterF32);
+    } else {
+        setter(*handle->limiterF64);
+    }
+    return LIMITER_OK;
+}
+
+template<typename real>
+static void Initialise(Limiter<real>& instance, double sampleRate) {
+    instance.SetSR(real(sampleRate));
+    instance.SetAttTime(real(.01));
+    instance.SetHoldTime(real(.0));
+    instance.SetRelTime(real(.05));
+    instance.SetThreshold(real(-.3));
+    instance.SetPreGain(real(.0));
+    instance.Reset();
+}
+
+extern "C" {
+
+int limiter_api_version(void) {
+    return LIMITER_API_VERSION;
+}
+
+limiter* limiter_create(limiter_precision precision, double sampleRate) {
+    if (precision != LIMITER_F32 && precision != LIMITER_F64) {
+        return nullptr;
+    }
+    limiter* handle = new (std::nothrow) limiter;
+    if (handle == nullptr) {
+        return nullptr;
+    }
+    handle->precision = precision;
+    handle->limiterF32 = nullptr;
+    handle->limiterF64 = nullptr;
+    try {
+        if (handle->precision == LIMITER_F32) {
+            handle->limiterF32 = new Limiter<float>();
+            Initialise(*handle->limiterF32, sampleRate);
+        } else {
+            handle->limiterF64 = new Limiter<double>();
+            Initialise(*handle->limiterF64, sampleRate);
+        }
+    } catch (...) {
+        delete handle;
+        return nullptr;
+    }
+    return handle;
+}
+
+void limiter_destroy(limiter* handle) {
+    if (handle == nullptr) {
+        return;
+    }
+    delete handle->limiterF32;
+    delete handle->limiterF64;
+    delete handle;
+}
+
+int limiter_set_sample_rate(limiter* handle, double sampleRate) {
+    return Apply(handle, [=](auto& instance) { instance.SetSR(sampleRate); });
+}
+
+int limiter_set_attack(limiter* handle, double attack) {
+    return Apply(handle, [=](auto& instance) { instance.SetAttTime(attack); });
+}
+
+int limiter_set_hold(limiter* handle, double hold) {
+    return Apply(handle, [=](auto& instance) { instance.SetHoldTime(hold); });
+}
+
+int limiter_set_release(limiter* handle, double release) {
+    return Apply(handle, [=](auto& instance) { instance.SetRelTime(release); });
+}
+
+int limiter_set_threshold(limiter* handle, double threshold) {
+    return Apply(handle, [=](auto& instance) { instance.SetThreshold(threshold); });
+}
+
+int limiter_set_pre_gain(limiter* handle, double preGain) {
+    return Apply(handle, [=](auto& instance) { instance.SetPreGain(preGain); });
+}
+
+int limiter_reset(limiter* handle) {
+    return Apply(handle, [](auto& instance) { instance.Reset(); });
+}
+
+size_t limiter_latency(const limiter* handle) {
+    if (handle == nullptr) {
+        return 0;
+    }
+    return handle->precision == LIMITER_F32 ?
+        handle->limiterF32->GetLatency() : handle->limiterF64->GetLatency();
+}
+
+int limiter_process_f32(limiter* handle, const float* const* in, float* const* out, size_t frames) {
+    if (handle == nullptr || in == nullptr || out == nullptr) {
+        return LIMITER_ERROR_NULL;
+    }
+    if (handle->precision != LIMITER_F32) {
+        return LIMITER_ERROR_PRECISION;
+    }
+    handle->limiterF32->Process(in, out, frames);
+    return LIMITER_OK;
+}
+
+int limiter_process_f64(limiter* handle, const double* const* in, double* const* out, size_t frames) {
+    if (handle == nullptr || in == nullptr || out == nullptr) {
+        return LIMITER_ERROR_NULL;
+    }
+    if (handle->precision != LIMITER_F64) {
+        return LIMITER_ERROR_PRECISION;
+    }
+    handle->limiterF64->Process(in, out, frames);
+    return LIMITER_OK;
+}
+
+int limiter_process_interleaved_f32(limiter* handle, const float* in, float* out, size_t frames) {
+    if (handle == nullptr || in == nullptr || out == nullptr) {
+        return LIMITER_ERROR_NULL;
+    }
+    if (handle->precision != LIMITER_F32) {
+        return LIMITER_ERROR_PRECISION;
+    }
+    handle->limiterF32->ProcessInterleaved(in, out, frames);
+    return LIMITER_OK;
+}
+
+int limiter_process_interleaved_f64(limiter* handle, const double* in, double* out, size_t frames) {
+    if (handle == nullptr || in == nullptr || out == nullptr) {
+        return LIMITER_ERROR_NULL;
+    }
+    if (handle->precision != LIMITER_F64) {
+        return LIMITER_ERROR_PRECISION;
+    }
+    handle->limiterF64->ProcessInterleaved(in, out, frames);
+    return LIMITER_OK;
+}
+
+}
@@ -0,0 +1,92 @@
+/*******************************************************************************
+ *
+ * C interface to the Limiter class for use from other languages through
+ * their foreign function interfaces (ctypes/cffi, Rust, Go, etc.).
+ *
+ * A limiter handle wraps either a Limiter<float> or a Limiter<double>
+ * instance, selected at creation time. The process functions operate on
+ * caller-owned stereo buffers, either planar or interleaved, and they
+ * can work in place, i.e., with the input and output pointing to the same
+ * memory. No copies of the caller buffers are made.
+ *
+ * The interface is built as a shared library from LimiterC.cpp, e.g.:
+ *
+ *   g++ -std=c++17 -O3 -fPIC -shared -fvisibility=hidden \
+ *       LimiterC.cpp -o liblimiter.so
+ *
+ * C programs link against it together with the math library, e.g.:
+ *
+ *   gcc -std=c99 -O2 testLimiterC.c -L. -llimiter -lm -o testLimiterC
+ *
+ * All functions return LIMITER_OK on success or a negative error code.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#ifndef LIMITER_C_H
+#define LIMITER_C_H
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#define LIMITER_API __declspec(dllexport)
+#else
+#define LIMITER_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LIMITER_API_VERSION 1
+
+typedef struct limiter limiter;
+
+typedef enum {
+    LIMITER_F32 = 0,
+    LIMITER_F64 = 1
+} limiter_precision;
+
+enum {
+    LIMITER_OK = 0,
+    LIMITER_ERROR_NULL = -1, /* Null handle or buffer. */
+    LIMITER_ERROR_PRECISION = -2 /* Process call does not match the handle precision. */
+};
+
+/* Returns LIMITER_API_VERSION as compiled into the library. */
+LIMITER_API int limiter_api_version(void);
+
+/* Creates a limiter with default parameters at the given samplerate.
+ * Returns NULL if precision is neither LIMITER_F32 nor LIMITER_F64, or on
+ * allocation failure. */
+LIMITER_API limiter* limiter_create(limiter_precision precision, double sampleRate);
+LIMITER_API void limiter_destroy(limiter* handle);
+
+/* Parameters: samplerate in Hz, times in seconds, threshold and pre-gain
+ * in dB. */
+LIMITER_API int limiter_set_sample_rate(limiter* handle, double sampleRate);
+LIMITER_API int limiter_set_attack(limiter* handle, double attack);
+LIMITER_API int limiter_set_hold(limiter* handle, double hold);
+LIMITER_API int limiter_set_release(limiter* handle, double release);
+LIMITER_API int limiter_set_threshold(limiter* handle, double threshold);
+LIMITER_API int limiter_set_pre_gain(limiter* handle, double preGain);
+LIMITER_API int limiter_reset(limiter* handle);
+
+/* Look-ahead delay in samples introduced by the limiter. Returns 0 for
+ * a null handle. */
+LIMITER_API size_t limiter_latency(const limiter* handle);
+
+/* Planar processing: in and out point to two channel pointers each. */
+LIMITER_API int limiter_process_f32(limiter* handle, const float* const* in, float* const* out, size_t frames);
+LIMITER_API int limiter_process_f64(limiter* handle, const double* const* in, double* const* out, size_t frames);
+
+/* Interleaved stereo processing: in and out point to 2 * frames samples. */
+LIMITER_API int limiter_process_interleaved_f32(limiter* handle, const float* in, float* out, size_t frames);
+LIMITER_API int limiter_process_interleaved_f64(limiter* handle, const double* in, double* out, size_t frames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,312 @@
+/*******************************************************************************
+ *
+ * Asynchronous read-ahead/write-behind file pipeline around the Limiter
+ * class for offline processing (POSIX).
+ *
+ * Three threads process a raw interleaved stereo file of native-endian
+ * samples of the limiter type: a reader fills blocks from the input file,
+ * a processor runs the limiter on them in place, and a writer stores them
+ * to the output file. The stages are connected by bounded lock-free queues
+ * of pointers to a fixed pool of 64-byte aligned block buffers, which
+ * return to the reader once written. Disk and CPU work therefore overlap,
+ * and the pipeline runs at the speed of its slowest stage.
+ *
+ * Each stage measures the time spent working and the time spent waiting
+ * for the other stages. The stage with the highest working time is
+ * reported as the bottleneck.
+ *
+ * By default, the look-ahead delay is compensated for: the first latency
+ * frames of the output are dropped and the input is extended with as many
+ * zeros, so that the output is aligned with the input and the tail of the
+ * signal is flushed out of the delay line. An incomplete frame at the end
+ * of the input, e.g., of a truncated file, is dropped and its size is
+ * given in the report.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <new>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <unistd.h>
+#include "Limiter.hpp"
+#include "SpscQueue.hpp"
+
+struct FilePipelineReport {
+    size_t frames = 0; // Frames written to the output.
+    double seconds = .0; // Wall-clock time.
+    double busy[3] = { .0, .0, .0 }; // Working time of reader, processor, writer.
+    double stall[3] = { .0, .0, .0 }; // Waiting time of reader, processor, writer.
+    const char* bottleneck = "";
+    size_t truncatedBytes = 0; // Bytes of an incomplete last input frame, which are dropped.
+    bool error = false;
+};
+
+template<typename real>
+class LimiterFilePipeline {
+    private:
+        struct Block {
+            real* data; // Interleaved stereo frames.
+            size_t frames;
+            bool last;
+        };
+
+        Limiter<real> limiter;
+        bool compensateLatency = true;
+        size_t blockFrames = 16384;
+        size_t numberOfBlocks = 8;
+        std::vector<Block> pool;
+
+        SpscQueue<Block*> freeBlocks; // Writer to reader.
+        SpscQueue<Block*> filledBlocks; // Reader to processor.
+        SpscQueue<Block*> processedBlocks; // Processor to writer.
+        std::atomic<bool> failed;
+        size_t truncatedBytes = 0;
+
+        enum { reader = 0, processor = 1, writer = 2 };
+        double busy[3];
+        double stall[3];
+
+        void Reader(int fd);
+        void Processor();
+        void Writer(int fd, size_t* frames);
+        Block* Receive(SpscQueue<Block*>& queue, size_t stage);
+        void Send(SpscQueue<Block*>& queue, Block* block, size_t stage);
+        void AllocatePool();
+        void FreePool();
+        static double Now() {
+            using namespace std::chrono;
+            return duration<double>(steady_clock::now().time_since_epoch()).count();
+        };
+
+    public:
+        Limiter<real>& GetLimiter() { return limiter; };
+        void SetBlockFrames(size_t _blockFrames) { blockFrames = std::max<size_t>(1, _blockFrames); };
+        void SetNumberOfBlocks(size_t _numberOfBlocks) { numberOfBlocks = std::max<size_t>(3, _numberOfBlocks); };
+        void SetCompensateLatency(bool _compensateLatency) { compensateLatency = _compensateLatency; };
+        FilePipelineReport Run(int inputFd, int outputFd);
+        LimiterFilePipeline() : failed(false) { };
+        ~LimiterFilePipeline() { FreePool(); };
+};
+
+template<typename real>
+void LimiterFilePipeline<real>::AllocatePool() {
+    FreePool();
+    size_t bytes = blockFrames * 2 * sizeof(real);
+    bytes = (bytes + 63) & ~size_t(63);
+    pool.reserve(numberOfBlocks);
+    for (size_t i = 0; i < numberOfBlocks; i++) {
+        Block block = { static_cast<real*>(std::aligned_alloc(64, bytes)), 0, false };
+        if (block.data == nullptr) {
+            throw std::bad_alloc();
+        }
+        pool.push_back(block);
+    }
+}
+
+template<typename real>
+void LimiterFilePipeline<real>::FreePool() {
+    for (Block& block : pool) {
+        std::free(block.data);
+    }
+    pool.clear();
+}
+
+/* Waiting is done by yielding first and then by sleeping briefly, as the
+ * stage at the other end of the queue may need the same core. The waiting
+ * time is accounted as a stall of the given stage. */
+template<typename real>
+typename LimiterFilePipeline<real>::Block* LimiterFilePipeline<real>::Receive(
+        SpscQueue<Block*>& queue, size_t stage) {
+    Block* block = nullptr;
+    if (queue.Pop(block)) {
+        return block;
+    }
+    double t0 = Now();
+    size_t spins = 0;
+    while (!queue.Pop(block)) {
+        if (failed.load(std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        if (++spins < 16) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+    stall[stage] += Now() - t0;
+    return block;
+}
+
+template<typename real>
+void LimiterFilePipeline<real>::Send(SpscQueue<Block*>& queue, Block* block, size_t stage) {
+    if (queue.Push(block)) {
+        return;
+    }
+    double t0 = Now();
+    while (!queue.Push(block)) {
+        std::this_thread::yield();
+    }
+    stall[stage] += Now() - t0;
+}
+
+template<typename real>
+void LimiterFilePipeline<real>::Reader(int fd) {
+    const size_t frameBytes = 2 * sizeof(real);
+    size_t tailFrames = compensateLatency ? limiter.GetLatency() : 0;
+    bool endOfFile = false;
+    while (true) {
+        Block* block = Receive(freeBlocks, reader);
+        if (block == nullptr) {
+            return;
+        }
+        double t0 = Now();
+
+        /* Fill the whole block unless the end of the file is reached. */
+        uint8_t* bytes = reinterpret_cast<uint8_t*>(block->data);
+        size_t capacity = blockFrames * frameBytes;
+        size_t filled = 0;
+        while (!endOfFile && filled < capacity) {
+            ssize_t result = read(fd, bytes + filled, capacity - filled);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result < 0) {
+                failed.store(true);
+                return;
+            }
+            endOfFile = result == 0;
+            filled += size_t(result);
+        }
+        block->frames = filled / frameBytes;
+        if (filled % frameBytes != 0) {
+            truncatedBytes = filled % frameBytes;
+        }
+
+        /* Append the zeros that flush the look-ahead delay. */
+        if (endOfFile) {
+            size_t zeros = std::min(tailFrames, blockFrames - block->frames);
+            std::memset(block->data + 2 * block->frames, 0, zeros * frameBytes);
+            block->frames += zeros;
+            tailFrames -= zeros;
+        }
+        block->last = endOfFile && tailFrames == 0;
+        busy[reader] += Now() - t0;
+        Send(filledBlocks, block, reader);
+        if (block->last) {
+            return;
+        }
+    }
+}
+
+template<typename real>
+void LimiterFilePipeline<real>::Processor() {
+    size_t skipFrames = compensateLatency ? limiter.GetLatency() : 0;
+    while (true) {
+        Block* block = Receive(filledBlocks, processor);
+        if (block == nullptr) {
+            return;
+        }
+        double t0 = Now();
+        limiter.ProcessInterleaved(block->data, block->data, block->frames);
+
+        /* Drop the leading frames of the look-ahead delay. */
+        if (skipFrames > 0) {
+            size_t skip = std::min(skipFrames, block->frames);
+            std::memmove(block->data, block->data + 2 * skip,
+                (block->frames - skip) * 2 * sizeof(real));
+            block->frames -= skip;
+            skipFrames -= skip;
+        }
+        busy[processor] += Now() - t0;
+        Send(processedBlocks, block, processor);
+        if (block->last) {
+            return;
+        }
+    }
+}
+
+template<typename real>
+void LimiterFilePipeline<real>::Writer(int fd, size_t* frames) {
+    while (true) {
+        Block* block = Receive(processedBlocks, writer);
+        if (block == nullptr) {
+            return;
+        }
+        double t0 = Now();
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(block->data);
+        size_t len = block->frames * 2 * sizeof(real);
+        size_t written = 0;
+        while (written < len) {
+            ssize_t result = write(fd, bytes + written, len - written);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result <= 0) {
+                failed.store(true);
+                return;
+            }
+            written += size_t(result);
+        }
+        *frames += block->frames;
+        bool last = block->last;
+        busy[writer] += Now() - t0;
+        Send(freeBlocks, block, writer);
+        if (last) {
+            return;
+        }
+    }
+}
+
+/* Processes the whole input file and returns the timing report. The limiter
+ * parameters must be set before the call. */
+template<typename real>
+FilePipelineReport LimiterFilePipeline<real>::Run(int inputFd, int outputFd) {
+    FilePipelineReport report;
+    AllocatePool();
+    freeBlocks.SetCapacity(numberOfBlocks);
+    filledBlocks.SetCapacity(numberOfBlocks);
+    processedBlocks.SetCapacity(numberOfBlocks);
+    for (Block& block : pool) {
+        freeBlocks.Push(&block);
+    }
+    failed.store(false);
+    truncatedBytes = 0;
+    for (size_t i = 0; i < 3; i++) {
+        busy[i] = .0;
+        stall[i] = .0;
+    }
+
+    double t0 = Now();
+    std::thread readerThread(&LimiterFilePipeline<real>::Reader, this, inputFd);
+    std::thread processorThread(&LimiterFilePipeline<real>::Processor, this);
+    Writer(outputFd, &report.frames);
+    processorThread.join();
+    readerThread.join();
+    report.seconds = Now() - t0;
+
+    const char* names[3] = { "reader", "processor", "writer" };
+    size_t slowest = 0;
+    for (size_t i = 0; i < 3; i++) {
+        report.busy[i] = busy[i];
+        report.stall[i] = stall[i];
+        if (busy[i] > busy[slowest]) {
+            slowest = i;
+        }
+    }
+    report.bottleneck = names[slowest];
+    report.truncatedBytes = truncatedBytes;
+    report.error = failed.load();
+    return report;
+}
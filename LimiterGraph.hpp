@@ -0,0 +1,400 @@
+/*******************************************************************************
+ *
+ * Parallel block scheduler for a routing graph of Limiter nodes.
+ *
+ * Each node owns a stereo Limiter instance. The input of a node is the sum
+ * of its external input buffer and the outputs of the nodes routed into it,
+ * and the routing must form a directed acyclic graph. At each block, the
+ * nodes without pending dependencies are executed in parallel by a fixed
+ * pool of worker threads plus the calling thread. Every thread owns a
+ * lock-free work-stealing deque (Chase-Lev): completed nodes push the
+ * successors that become ready onto the deque of the thread that completed
+ * them, and idle threads steal from the others.
+ *
+ * All buffers, queues, and threads are allocated in Prepare, so that Process
+ * performs no allocation and takes no locks. The scheduler measures the
+ * cost of each node as a moving average of its processing time, which can
+ * also be set by hand. The roots, and the successors released together by
+ * a node, are pushed in ascending cost order, so that the owner of a deque
+ * pops the most expensive ready node first, while thieves take the oldest,
+ * i.e., cheapest, ones from the top.
+ *
+ * Workers that find no node to run for a while leave the block, and idle
+ * workers sleep between blocks, see WorkerSignal.hpp; the calling thread
+ * stays until the block is complete.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <pthread.h>
+#include <sched.h>
+#include "Limiter.hpp"
+#include "WorkerSignal.hpp"
+
+/* Fixed-capacity work-stealing deque after Lê et al. (2013), "Correct and
+ * efficient work-stealing for weak memory models". The owner pushes and
+ * pops at the bottom, while other threads steal from the top. */
+class WorkStealingDeque {
+    private:
+        alignas(64) std::atomic<int64_t> top;
+        alignas(64) std::atomic<int64_t> bottom;
+        std::vector<std::atomic<size_t>> buffer;
+        int64_t mask = 0;
+
+    public:
+        static const size_t empty = SIZE_MAX;
+
+        void SetCapacity(size_t capacity) {
+            size_t len = 1;
+            while (len < capacity) {
+                len <<= 1;
+            }
+            buffer = std::vector<std::atomic<size_t>>(len);
+            mask = int64_t(len) - 1;
+            top.store(0);
+            bottom.store(0);
+        };
+        void Push(size_t item) {
+            int64_t b = bottom.load(std::memory_order_relaxed);
+            buffer[b & mask].store(item, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom.store(b + 1, std::memory_order_relaxed);
+        };
+        size_t Pop() {
+            int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top.load(std::memory_order_relaxed);
+            if (t > b) {
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return empty;
+            }
+            size_t item = buffer[b & mask].load(std::memory_order_relaxed);
+            if (t == b) {
+
+                /* Last item: race against the thieves for it. */
+                if (!top.compare_exchange_strong(t, t + 1,
+                        std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    item = empty;
+                }
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return item;
+        };
+        size_t Steal() {
+            int64_t t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = bottom.load(std::memory_order_acquire);
+            if (t >= b) {
+                return empty;
+            }
+            size_t item = buffer[t & mask].load(std::memory_order_relaxed);
+            if (!top.compare_exchange_strong(t, t + 1,
+                    std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return empty;
+            }
+            return item;
+        };
+        WorkStealingDeque() : top(0), bottom(0) { };
+};
+
+template<typename real>
+class LimiterGraph {
+    private:
+        struct alignas(64) Node {
+            Limiter<real> limiter;
+            std::vector<real> input[2]; // External input.
+            std::vector<real> mix[2]; // External input plus routed inputs.
+            std::vector<real> output[2];
+            std::vector<size_t> predecessors;
+            std::vector<size_t> successors;
+            std::atomic<size_t> pending; // Unfinished predecessors in the current block.
+            std::atomic<double> cost; // Average processing time in nanoseconds.
+            Node() : pending(0), cost(.0) { };
+        };
+
+        /* State of each thread taking part in the processing. Index 0 is
+         * the thread calling Process. */
+        struct alignas(64) Worker {
+            WorkStealingDeque deque;
+            std::vector<size_t> ready; // Successors released by the current node.
+            uint64_t seed = 0;
+        };
+
+        std::vector<std::unique_ptr<Node>> nodes;
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::vector<std::thread> threads;
+        std::vector<size_t> roots;
+        size_t numberOfThreads = 1;
+        size_t maxBlockLen = 0;
+        size_t blockLen = 0;
+        bool realtime = false;
+        const double costSmoothing = .9;
+
+        WorkerSignal signal;
+        alignas(64) std::atomic<size_t> remaining;
+        alignas(64) std::atomic<size_t> activeWorkers; // Workers inside RunBlock.
+        std::atomic<bool> running;
+
+        void StartThreads();
+        void StopThreads();
+        void WorkerLoop(size_t index, uint32_t seen);
+        void RunBlock(size_t index);
+        void Execute(size_t index, size_t node);
+
+    public:
+        size_t AddNode();
+        bool Connect(size_t source, size_t destination);
+        bool Prepare(size_t _maxBlockLen);
+        void Process(size_t vecLen);
+        void SetRealtime(bool _realtime) { realtime = _realtime; };
+        size_t GetNumberOfNodes() const { return nodes.size(); };
+        Limiter<real>& GetLimiter(size_t node) { return nodes[node]->limiter; };
+        real* GetInput(size_t node, size_t channel) { return nodes[node]->input[channel].data(); };
+        const real* GetOutput(size_t node, size_t channel) const { return nodes[node]->output[channel].data(); };
+        double GetNodeCost(size_t node) const { return nodes[node]->cost.load(std::memory_order_relaxed); };
+        void SetNodeCost(size_t node, double cost) { nodes[node]->cost.store(cost, std::memory_order_relaxed); };
+        LimiterGraph(size_t _numberOfThreads = std::thread::hardware_concurrency());
+        ~LimiterGraph() { StopThreads(); };
+};
+
+template<typename real>
+LimiterGraph<real>::LimiterGraph(size_t _numberOfThreads)
+    : remaining(0), activeWorkers(0), running(false) {
+    numberOfThreads = std::max<size_t>(1, _numberOfThreads);
+}
+
+/* Nodes and connections can only be modified before Prepare is called, or
+ * after calling it again. */
+template<typename real>
+size_t LimiterGraph<real>::AddNode() {
+    StopThreads();
+    nodes.emplace_back(new Node());
+    return nodes.size() - 1;
+}
+
+template<typename real>
+bool LimiterGraph<real>::Connect(size_t source, size_t destination) {
+    if (source >= nodes.size() || destination >= nodes.size() || source == destination) {
+        return false;
+    }
+    StopThreads();
+    nodes[source]->successors.push_back(destination);
+    nodes[destination]->predecessors.push_back(source);
+    return true;
+}
+
+/* Allocates the buffers for blocks of up to _maxBlockLen samples, checks
+ * that the routing is acyclic, and starts the worker threads. Returns false
+ * if the routing contains a cycle. */
+template<typename real>
+bool LimiterGraph<real>::Prepare(size_t _maxBlockLen) {
+    StopThreads();
+    maxBlockLen = _maxBlockLen;
+
+    /* Kahn's algorithm: the graph is acyclic if all nodes can be removed
+     * in dependency order. */
+    std::vector<size_t> inDegree(nodes.size());
+    std::vector<size_t> order;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        inDegree[i] = nodes[i]->predecessors.size();
+        if (inDegree[i] == 0) {
+            order.push_back(i);
+        }
+    }
+    for (size_t i = 0; i < order.size(); i++) {
+        for (size_t successor : nodes[order[i]]->successors) {
+            if (--inDegree[successor] == 0) {
+                order.push_back(successor);
+            }
+        }
+    }
+    if (order.size() != nodes.size()) {
+        return false;
+    }
+
+    roots.clear();
+    for (size_t i = 0; i < nodes.size(); i++) {
+        Node& node = *nodes[i];
+        for (size_t channel = 0; channel < 2; channel++) {
+            node.input[channel].assign(maxBlockLen, .0);
+            node.mix[channel].assign(maxBlockLen, .0);
+            node.output[channel].assign(maxBlockLen, .0);
+        }
+        if (node.predecessors.empty()) {
+            roots.push_back(i);
+        }
+    }
+
+    workers.clear();
+    for (size_t i = 0; i < numberOfThreads; i++) {
+        workers.emplace_back(new Worker());
+        workers[i]->deque.SetCapacity(nodes.size());
+        workers[i]->ready.reserve(nodes.size());
+        workers[i]->seed = 0x9E3779B97F4A7C15ull * (i + 1);
+    }
+    StartThreads();
+    return true;
+}
+
+template<typename real>
+void LimiterGraph<real>::StartThreads() {
+    running.store(true);
+    uint32_t seen = signal.Get();
+    for (size_t i = 1; i < numberOfThreads; i++) {
+        threads.emplace_back(&LimiterGraph<real>::WorkerLoop, this, i, seen);
+    }
+}
+
+template<typename real>
+void LimiterGraph<real>::StopThreads() {
+    running.store(false);
+    signal.Publish();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+}
+
+template<typename real>
+void LimiterGraph<real>::WorkerLoop(size_t index, uint32_t seen) {
+    if (realtime) {
+        sched_param param;
+        param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 1;
+        pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    }
+    while (true) {
+        seen = signal.Wait(seen);
+        if (!running.load(std::memory_order_acquire)) {
+            return;
+        }
+
+        /* A worker waking up late may enter while the calling thread sets
+         * up the next block; it then sees either no remaining nodes or the
+         * complete block, as remaining is stored last. */
+        activeWorkers.fetch_add(1, std::memory_order_seq_cst);
+        RunBlock(index);
+        activeWorkers.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+/* Execute nodes from the own deque, or steal them from a random other
+ * thread, until all nodes of the block have been processed. Workers leave
+ * earlier when they find nothing to run for WorkerSignal::spinLimit
+ * attempts, e.g., while a long chain of nodes runs on another thread. */
+template<typename real>
+void LimiterGraph<real>::RunBlock(size_t index) {
+    Worker& self = *workers[index];
+    size_t spins = 0;
+    while (remaining.load(std::memory_order_acquire) > 0) {
+        size_t node = self.deque.Pop();
+        if (node == WorkStealingDeque::empty && numberOfThreads > 1) {
+            self.seed ^= self.seed << 13;
+            self.seed ^= self.seed >> 7;
+            self.seed ^= self.seed << 17;
+            size_t victim = self.seed % (numberOfThreads - 1);
+            victim += victim >= index;
+            node = workers[victim]->deque.Steal();
+        }
+        if (node == WorkStealingDeque::empty) {
+            if (index > 0 && spins >= WorkerSignal::spinLimit) {
+                return;
+            }
+            SpinPause(spins);
+            continue;
+        }
+        spins = 0;
+        Execute(index, node);
+    }
+}
+
+template<typename real>
+void LimiterGraph<real>::Execute(size_t index, size_t nodeIndex) {
+    using std::chrono::steady_clock;
+    Node& node = *nodes[nodeIndex];
+    auto t0 = steady_clock::now();
+
+    /* Mix the external input with the outputs of the routed nodes. */
+    for (size_t channel = 0; channel < 2; channel++) {
+        real* mix = node.mix[channel].data();
+        const real* input = node.input[channel].data();
+        std::copy(input, input + blockLen, mix);
+        for (size_t predecessor : node.predecessors) {
+            const real* routed = nodes[predecessor]->output[channel].data();
+            for (size_t n = 0; n < blockLen; n++) {
+                mix[n] += routed[n];
+            }
+        }
+    }
+    real* xVec[2] = { node.mix[0].data(), node.mix[1].data() };
+    real* yVec[2] = { node.output[0].data(), node.output[1].data() };
+    node.limiter.Process(xVec, yVec, blockLen);
+
+    double elapsed = std::chrono::duration<double, std::nano>(steady_clock::now() - t0).count();
+    double cost = node.cost.load(std::memory_order_relaxed);
+    node.cost.store(costSmoothing * cost + (1.0 - costSmoothing) * elapsed,
+        std::memory_order_relaxed);
+
+    /* Release the successors whose dependencies are now complete. The
+     * release-acquire ordering on the counters makes this node's output
+     * visible to whichever thread executes the successor. */
+    std::vector<size_t>& ready = workers[index]->ready;
+    ready.clear();
+    for (size_t successor : node.successors) {
+        if (nodes[successor]->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            ready.push_back(successor);
+        }
+    }
+    std::sort(ready.begin(), ready.end(), [this](size_t a, size_t b) {
+        return GetNodeCost(a) < GetNodeCost(b);
+    });
+    for (size_t successor : ready) {
+        workers[index]->deque.Push(successor);
+    }
+    remaining.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+/* Processes one block of vecLen <= maxBlockLen samples through the graph.
+ * The external inputs must be filled before the call. */
+template<typename real>
+void LimiterGraph<real>::Process(size_t vecLen) {
+    blockLen = std::min(vecLen, maxBlockLen);
+    if (nodes.empty()) {
+        return;
+    }
+    for (size_t i = 0; i < nodes.size(); i++) {
+        nodes[i]->pending.store(nodes[i]->predecessors.size(), std::memory_order_relaxed);
+    }
+
+    /* The calling thread pops its deque from the bottom, hence pushing the
+     * roots in ascending cost order starts the heaviest nodes first. */
+    std::sort(roots.begin(), roots.end(), [this](size_t a, size_t b) {
+        return GetNodeCost(a) < GetNodeCost(b);
+    });
+    for (size_t root : roots) {
+        workers[0]->deque.Push(root);
+    }
+    remaining.store(nodes.size(), std::memory_order_release);
+    signal.Publish();
+
+    RunBlock(0);
+
+    /* Wait for the workers still inside the block, which can only be
+     * finishing a node or giving up, before the next one can reset the
+     * counters. Sleeping workers are not waited for. */
+    size_t spins = 0;
+    while (activeWorkers.load(std::memory_order_seq_cst) > 0) {
+        SpinPause(spins);
+    }
+}
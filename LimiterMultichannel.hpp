@@ -0,0 +1,247 @@
+/*******************************************************************************
+ *
+ * Multichannel version of the Limiter class with a linked detector, e.g.,
+ * for 128-channel immersive beds and object renders.
+ *
+ * The detection path runs once per block on the maximum absolute value
+ * across all channels, so that all channels receive the same attenuation
+ * gain. The application path, i.e., pre gain, look-ahead delay, and gain
+ * multiplication, runs on lanes of two channels each, using the ApplyGain
+ * function of a Limiter instance per lane. The lanes are split into
+ * contiguous groups, one per thread, and each group is processed by a
+ * fixed pool of worker threads plus the calling thread, so that every lane
+ * stays in the cache of the same core. The threads synchronise once per
+ * block through atomic counters, without locks, and idle workers sleep
+ * between blocks, see WorkerSignal.hpp.
+ *
+ * Parameters are set from the thread calling Process, between calls.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include "Limiter.hpp"
+#include "WorkerSignal.hpp"
+
+template<typename real>
+class LimiterMultichannel {
+    private:
+        size_t numberOfChannels = 0;
+        size_t numberOfLanes = 0;
+        size_t numberOfGroups = 0;
+        size_t maxBlockLen = 0;
+
+        typename Limiter<real>::Preset preset;
+        Limiter<real> detector;
+        std::vector<std::unique_ptr<Limiter<real>>> lanes;
+        std::vector<size_t> groupStart; // First lane of each group, plus the end.
+        std::vector<real> peak;
+        std::vector<real> gain;
+
+        /* Dummy channel of the last lane for odd channel counts. */
+        std::vector<real> spareInput;
+        std::vector<real> spareOutput;
+
+        /* Block shared with the workers, written before each generation. */
+        const real* const* inputVec = nullptr;
+        real* const* outputVec = nullptr;
+        size_t blockLen = 0;
+
+        std::vector<std::thread> threads;
+        WorkerSignal signal;
+        alignas(64) std::atomic<size_t> busyWorkers;
+        std::atomic<bool> running;
+
+        void UpdateLimiters();
+        void WorkerLoop(size_t group, uint32_t seen);
+        void RunGroup(size_t group);
+
+    public:
+        void SetSR(real _SR);
+        void SetAttTime(real _attack);
+        void SetHoldTime(real _hold);
+        void SetRelTime(real _release);
+        void SetThreshold(real _threshold);
+        void SetPreGain(real _preGain);
+        void SetMaxAttTime(real _maxAttack);
+        void Reset();
+        size_t GetLatency() const { return detector.GetLatency(); };
+        size_t GetNumberOfChannels() const { return numberOfChannels; };
+        size_t GetNumberOfGroups() const { return numberOfGroups; };
+        void Process(const real* const* xVec, real* const* yVec, size_t vecLen);
+        LimiterMultichannel(size_t _numberOfChannels, size_t _maxBlockLen,
+            size_t numberOfThreads = std::thread::hardware_concurrency());
+        ~LimiterMultichannel();
+};
+
+template<typename real>
+LimiterMultichannel<real>::LimiterMultichannel(size_t _numberOfChannels, size_t _maxBlockLen,
+        size_t numberOfThreads) : busyWorkers(0), running(true) {
+    numberOfChannels = std::max<size_t>(1, _numberOfChannels);
+    maxBlockLen = std::max<size_t>(1, _maxBlockLen);
+    numberOfLanes = (numberOfChannels + 1) / 2;
+    numberOfGroups = std::min(std::max<size_t>(1, numberOfThreads), numberOfLanes);
+    detector.SetPreset(&preset);
+    for (size_t i = 0; i < numberOfLanes; i++) {
+        lanes.emplace_back(new Limiter<real>());
+        lanes.back()->SetPreset(&preset);
+    }
+    for (size_t i = 0; i <= numberOfGroups; i++) {
+        groupStart.push_back(i * numberOfLanes / numberOfGroups);
+    }
+    peak.resize(maxBlockLen);
+    gain.resize(maxBlockLen);
+    spareInput.assign(maxBlockLen, .0);
+    spareOutput.resize(maxBlockLen);
+
+    SetSR(48000.0);
+    SetAttTime(.01);
+    SetHoldTime(.0);
+    SetRelTime(.05);
+    SetThreshold(-.3);
+    SetPreGain(.0);
+    Reset();
+
+    for (size_t i = 1; i < numberOfGroups; i++) {
+        threads.emplace_back(&LimiterMultichannel<real>::WorkerLoop, this, i, signal.Get());
+    }
+}
+
+template<typename real>
+LimiterMultichannel<real>::~LimiterMultichannel() {
+    running.store(false);
+    signal.Publish();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+/* The setters configure a preset shared by the detector and every lane,
+ * so that the coefficients are computed once and the pre gain and delay of
+ * the lanes match the detector. */
+template<typename real>
+void LimiterMultichannel<real>::UpdateLimiters() {
+    detector.UpdatePreset();
+    for (auto& lane : lanes) {
+        lane->UpdatePreset();
+    }
+}
+
+template<typename real>
+void LimiterMultichannel<real>::SetSR(real _SR) {
+    preset.SetSR(_SR);
+    UpdateLimiters();
+}
+
+template<typename real>
+void LimiterMultichannel<real>::SetAttTime(real _attack) {
+    preset.SetAttTime(_attack);
+    UpdateLimiters();
+}
+
+template<typename real>
+void LimiterMultichannel<real>::SetHoldTime(real _hold) {
+    preset.SetHoldTime(_hold);
+    UpdateLimiters();
+}
+
+template<typename real>
+void LimiterMultichannel<real>::SetRelTime(real _release) {
+    preset.SetRelTime(_release);
+    UpdateLimiters();
+}
+
+template<typename real>
+void LimiterMultichannel<real>::SetThreshold(real _threshold) {
+    preset.SetThreshold(_threshold);
+    UpdateLimiters();
+}
+
+template<typename real>
+void LimiterMultichannel<real>::SetPreGain(real _preGain) {
+    preset.SetPreGain(_preGain);
+    UpdateLimiters();
+}
+
+template<typename real>
+void LimiterMultichannel<real>::SetMaxAttTime(real _maxAttack) {
+    preset.SetMaxAttTime(_maxAttack);
+    UpdateLimiters();
+}
+
+template<typename real>
+void LimiterMultichannel<real>::Reset() {
+    detector.Reset();
+    for (auto& lane : lanes) {
+        lane->Reset();
+    }
+}
+
+template<typename real>
+void LimiterMultichannel<real>::WorkerLoop(size_t group, uint32_t seen) {
+    while (true) {
+        seen = signal.Wait(seen);
+        if (!running.load(std::memory_order_acquire)) {
+            return;
+        }
+        RunGroup(group);
+        busyWorkers.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+/* Applies the delay and the gain of the current block to the lanes of a
+ * group. */
+template<typename real>
+void LimiterMultichannel<real>::RunGroup(size_t group) {
+    for (size_t lane = groupStart[group]; lane < groupStart[group + 1]; lane++) {
+        size_t left = 2 * lane;
+        bool hasRight = left + 1 < numberOfChannels;
+        const real* x[2] = { inputVec[left], hasRight ? inputVec[left + 1] : spareInput.data() };
+        real* y[2] = { outputVec[left], hasRight ? outputVec[left + 1] : spareOutput.data() };
+        lanes[lane]->ApplyGain(x, gain.data(), y, blockLen);
+    }
+}
+
+/* Given numberOfChannels input and output vectors, the function processes
+ * a block of at most maxBlockLen samples. The processing can take place in
+ * place. */
+template<typename real>
+void LimiterMultichannel<real>::Process(const real* const* xVec, real* const* yVec, size_t vecLen) {
+    vecLen = std::min(vecLen, maxBlockLen);
+
+    /* Linked detection on the maximum absolute value across the channels,
+     * which gives the same result as the stereo maximum of the detector. */
+    for (size_t n = 0; n < vecLen; n++) {
+        peak[n] = std::fabs(xVec[0][n]);
+    }
+    for (size_t c = 1; c < numberOfChannels; c++) {
+        const real* x = xVec[c];
+        for (size_t n = 0; n < vecLen; n++) {
+            peak[n] = std::max<real>(peak[n], std::fabs(x[n]));
+        }
+    }
+    const real* peakVec[2] = { peak.data(), peak.data() };
+    detector.ProcessGain(peakVec, gain.data(), vecLen);
+
+    /* Hand the block over to the workers and process the first group. */
+    inputVec = xVec;
+    outputVec = yVec;
+    blockLen = vecLen;
+    busyWorkers.store(numberOfGroups - 1, std::memory_order_release);
+    signal.Publish();
+    RunGroup(0);
+    size_t spins = 0;
+    while (busyWorkers.load(std::memory_order_acquire) > 0) {
+        SpinPause(spins);
+    }
+}
@@ -0,0 +1,233 @@
+/*******************************************************************************
+ *
+ * Two-thread pipelined version of the Limiter class.
+ *
+ * The limiter is split into a detection path (pre gain, stereo max,
+ * peak-holder, smoother, and gain computation), which runs on a dedicated
+ * thread, and an application path (pre gain, look-ahead delay, and gain
+ * multiplication), which runs on the thread calling Process. The two
+ * threads are connected by lock-free single-producer single-consumer ring
+ * buffers carrying the input samples to the detector and the gain values
+ * back to the application path.
+ *
+ * At each call, the application path uses the gains computed by the detector
+ * during the previous call, i.e., maxBlockLen samples late. This slack is
+ * taken from the look-ahead: the detector anticipates the delayed signal by
+ * maxBlockLen samples (see Limiter::SetLookaheadSlack), so that the total
+ * latency stays equal to the look-ahead delay as long as this is at least
+ * maxBlockLen samples long. Shorter look-ahead delays are extended to
+ * maxBlockLen samples.
+ *
+ * Parameters are set from the thread calling Process and they are applied
+ * at the beginning of the next call, once the detector has caught up.
+ *
+ * Process publishes each block on a WorkerSignal after pushing its input,
+ * and the detector sleeps on it when no input is queued, see
+ * WorkerSignal.hpp.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include "Limiter.hpp"
+#include "SpscQueue.hpp"
+#include "WorkerSignal.hpp"
+
+template<typename real>
+class LimiterPipelined {
+    private:
+        Limiter<real> limiter;
+        size_t maxBlockLen = 0;
+
+        /* Rings from the application path to the detector and back. */
+        SpscQueue<real> inputLeft;
+        SpscQueue<real> inputRight;
+        SpscQueue<real> gains;
+
+        /* Scratch vectors of each thread. */
+        std::vector<real> detectorLeft;
+        std::vector<real> detectorRight;
+        std::vector<real> detectorGain;
+        std::vector<real> applyGain;
+
+        size_t pushedFrames = 0; // Written by the application path only.
+        alignas(64) std::atomic<size_t> detectedFrames;
+        std::atomic<bool> running;
+        WorkerSignal signal;
+        std::thread detector;
+
+        /* Parameters waiting to be applied at the next Process call. */
+        enum {
+            dirtySR = 1, dirtyAttack = 2, dirtyHold = 4,
+            dirtyRelease = 8, dirtyThreshold = 16, dirtyPreGain = 32
+        };
+        unsigned dirty = 0;
+        real SR = 48000.0;
+        real attack = .01;
+        real hold = .0;
+        real release = .05;
+        real threshold = -.3;
+        real preGain = .0;
+
+        void DetectorLoop();
+        void ApplyParameters();
+
+    public:
+        void SetSR(real _SR) { SR = _SR; dirty |= dirtySR; };
+        void SetAttTime(real _attack) { attack = _attack; dirty |= dirtyAttack; };
+        void SetHoldTime(real _hold) { hold = _hold; dirty |= dirtyHold; };
+        void SetRelTime(real _release) { release = _release; dirty |= dirtyRelease; };
+        void SetThreshold(real _threshold) { threshold = _threshold; dirty |= dirtyThreshold; };
+        void SetPreGain(real _preGain) { preGain = _preGain; dirty |= dirtyPreGain; };
+        size_t GetLatency() const { return limiter.GetLatency(); };
+        void Process(const real* const* xVec, real* const* yVec, size_t vecLen);
+        LimiterPipelined(size_t _maxBlockLen);
+        ~LimiterPipelined();
+};
+
+template<typename real>
+LimiterPipelined<real>::LimiterPipelined(size_t _maxBlockLen) : detectedFrames(0), running(true) {
+    maxBlockLen = std::max<size_t>(1, _maxBlockLen);
+    detectorLeft.resize(maxBlockLen);
+    detectorRight.resize(maxBlockLen);
+    detectorGain.resize(maxBlockLen);
+    applyGain.resize(maxBlockLen);
+
+    /* The detector can lag behind by up to two blocks before the
+     * application path waits for it. */
+    inputLeft.SetCapacity(4 * maxBlockLen);
+    inputRight.SetCapacity(4 * maxBlockLen);
+    gains.SetCapacity(4 * maxBlockLen);
+
+    limiter.SetLookaheadSlack(maxBlockLen);
+    limiter.SetSR(SR);
+    limiter.SetAttTime(attack);
+    limiter.SetHoldTime(hold);
+    limiter.SetRelTime(release);
+    limiter.SetThreshold(threshold);
+    limiter.SetPreGain(preGain);
+    limiter.Reset();
+
+    /* The first block is processed with unity gain, which is the gain the
+     * detector produces on the silence preceding the start. */
+    std::vector<real> unity(maxBlockLen, 1.0);
+    gains.Push(unity.data(), maxBlockLen);
+
+    detector = std::thread(&LimiterPipelined<real>::DetectorLoop, this);
+}
+
+template<typename real>
+LimiterPipelined<real>::~LimiterPipelined() {
+    running.store(false, std::memory_order_release);
+    signal.Publish();
+    detector.join();
+}
+
+/* The generation is read before the rings are checked, hence a block
+ * published in between ends the wait at once. */
+template<typename real>
+void LimiterPipelined<real>::DetectorLoop() {
+    while (running.load(std::memory_order_acquire)) {
+        uint32_t seen = signal.Get();
+
+        /* The right channel is pushed after the left one, hence its
+         * available frames are available on both rings. */
+        size_t len = std::min(maxBlockLen, inputRight.GetReadAvailable());
+        if (len == 0) {
+            signal.Wait(seen);
+            continue;
+        }
+        inputLeft.Pop(detectorLeft.data(), len);
+        inputRight.Pop(detectorRight.data(), len);
+        const real* xVec[2] = { detectorLeft.data(), detectorRight.data() };
+        limiter.ProcessGain(xVec, detectorGain.data(), len);
+        size_t pushed = 0;
+        size_t spins = 0;
+        while (pushed < len && running.load(std::memory_order_acquire)) {
+            pushed += gains.Push(detectorGain.data() + pushed, len - pushed);
+            if (pushed < len) {
+                SpinPause(spins);
+            }
+        }
+        detectedFrames.fetch_add(len, std::memory_order_release);
+    }
+}
+
+/* Parameter changes affect both paths, hence they are applied while the
+ * detector is idle, i.e., after it has processed all pushed frames and
+ * before the next frames are pushed. */
+template<typename real>
+void LimiterPipelined<real>::ApplyParameters() {
+    size_t spins = 0;
+    while (detectedFrames.load(std::memory_order_acquire) != pushedFrames) {
+        SpinPause(spins);
+    }
+    if (dirty & dirtySR) {
+        limiter.SetSR(SR);
+    }
+    if (dirty & (dirtySR | dirtyAttack)) {
+        limiter.SetAttTime(attack);
+    }
+    if (dirty & (dirtySR | dirtyHold)) {
+        limiter.SetHoldTime(hold);
+    }
+    if (dirty & (dirtySR | dirtyRelease)) {
+        limiter.SetRelTime(release);
+    }
+    if (dirty & dirtyThreshold) {
+        limiter.SetThreshold(threshold);
+    }
+    if (dirty & dirtyPreGain) {
+        limiter.SetPreGain(preGain);
+    }
+    dirty = 0;
+}
+
+/* Given input and output vectors, the function processes a block of at
+ * most maxBlockLen samples of the input signal and stores it in the output
+ * vector. The processing can take place in place. */
+template<typename real>
+void LimiterPipelined<real>::Process(const real* const* xVec, real* const* yVec, size_t vecLen) {
+    vecLen = std::min(vecLen, maxBlockLen);
+    if (dirty) {
+        ApplyParameters();
+    }
+
+    /* Hand the input over to the detector. */
+    size_t pushed = 0;
+    size_t spins = 0;
+    while (pushed < vecLen) {
+        pushed += inputLeft.Push(xVec[0] + pushed, vecLen - pushed);
+        if (pushed < vecLen) {
+            SpinPause(spins);
+        }
+    }
+    pushed = 0;
+    while (pushed < vecLen) {
+        pushed += inputRight.Push(xVec[1] + pushed, vecLen - pushed);
+        if (pushed < vecLen) {
+            SpinPause(spins);
+        }
+    }
+    pushedFrames += vecLen;
+    signal.Publish();
+
+    /* Collect the gains computed during the previous call, which are
+     * normally ready, and apply them to the delayed input. */
+    size_t popped = 0;
+    spins = 0;
+    while (popped < vecLen) {
+        popped += gains.Pop(applyGain.data() + popped, vecLen - popped);
+        if (popped < vecLen) {
+            SpinPause(spins);
+        }
+    }
+    limiter.ApplyGain(xVec, applyGain.data(), yVec, vecLen);
+}
@@ -0,0 +1,383 @@
+/*******************************************************************************
+ *
+ * Shared parameter blocks for the Limiter class.
+ *
+ * LimiterCoefficients holds the settings of a limiter and every coefficient
+ * derived from them, i.e., everything the processing reads but does not
+ * modify. Each Limiter instance refers to a block through a reference-
+ * counted pointer, so that instances with the same settings can share one
+ * block and keep only their signal state and delay buffers.
+ *
+ * LimiterPreset publishes a block for a group of instances, e.g., all the
+ * limiters of a session template. Its setters compute the coefficients
+ * once and swap in a new immutable block atomically, and the attached
+ * instances pick it up at the start of their next block, so that the
+ * reconfiguration of hundreds of instances costs one computation.
+ *
+ * Picking up a block is real-time safe: the instances compare a version
+ * number and, only if it has changed, load the block pointer and count
+ * themselves as its users, with a few lock-free atomic operations, no
+ * locks, and no deallocations. Replaced blocks are retired on the preset
+ * and deleted by the configuring thread, in later setter calls or in 
+ * Reclaim, once no instance uses them any longer. To that end, the loading
+ * instances register with one of two counters selected by an epoch, which
+ * the configuring thread advances after each swap, waiting for the
+ * instances of the previous epoch to finish loading; afterwards, no 
+ * instance can start using a retired block, and its user count can only
+ * decrease.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "DelaySmooth.hpp"
+#include "PeakHoldCascade.hpp"
+#include "ExpSmootherCascade.hpp"
+
+template<typename real, size_t numberOfPeakHoldSections = 8, size_t numberOfSmoothSections = 4, typename numerics = StrictNumerics>
+struct LimiterCoefficients {
+
+    /* Sub-block size of the Limiter processing, which the delay buffers
+     * must hold on top of the look-ahead delay. */
+    static const size_t internalBlockLen = 256;
+
+    real SR = 48000.0; // Samplerate as a float variable for later calculations.
+    real T = 1.0 / SR; // Sampling period.
+    real twoPi = 2.0 * M_PI;
+    real epsilon = std::numeric_limits<real>::epsilon();
+    real smoothParamCutoff = 20.0; // Hz.
+    real attack = .01; // Attack time in seconds.
+    real hold = .0; // Hold time in seconds, useful to improve THD at lower frequencies.
+    real release = .05; // Release time in seconds.
+    real dBThreshold = -.3; // Threshold in dB.
+    real linThreshold = numerics::Pow(10.0, dBThreshold * .05); // Linear threshold value.
+    real dBPreGain = .0; // Input gain before processing in dB.
+    real linPreGain = 1.0; // Linear gain.
+
+    /* Coefficient for a one-pole low-pass filter. */
+    real smoothParamCoeff = numerics::Exp(-twoPi * smoothParamCutoff * T);
+
+    size_t lookaheadDelay = 0;
+    size_t lookaheadSlack = 0; // Samples of look-ahead given up by the detector.
+    real detectorAttack = attack; // Attack time of the detection path.
+    real maxAttack = .0; // Attack time the delay buffers are sized for, 0 for the default size.
+    static const size_t defaultDelayBufferLen = 65536; // Default length of the DelaySmooth buffers.
+    size_t delayBufferLen = defaultDelayBufferLen;
+    real oneOverPeakSections = 1.0 / real(numberOfPeakHoldSections);
+
+    /* At sample rates of 176.4 kHz and above, the peak-holder and the
+     * smoother run on the maximum of groups of decimation samples, and
+     * the resulting gain is linearly interpolated back to the full rate. */
+    bool decimatedDetection = true;
+    size_t decimation = 1;
+    real oneOverDecimation = 1.0;
+
+    PeakHoldCoefficients<numberOfPeakHoldSections, real> peakHolder;
+    ExpSmootherCoefficients<numberOfSmoothSections, real, numerics> expSmoother;
+
+    void SetSR(real _SR);
+    void SetAttTime(real _attack);
+    void SetHoldTime(real _hold);
+    void SetRelTime(real _release);
+    void SetThreshold(real _threshold);
+    void SetPreGain(real _preGain);
+    void SetLookaheadSlack(size_t _lookaheadSlack);
+    void SetMaxAttTime(real _maxAttack);
+    void SetDecimatedDetection(bool _decimatedDetection);
+    size_t GetDetectorSlack() const;
+    void ResizeDelay();
+};
+
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename numerics>
+const size_t LimiterCoefficients<real, numberOfPeakHoldSections, numberOfSmoothSections, numerics>::internalBlockLen;
+
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename numerics>
+const size_t LimiterCoefficients<real, numberOfPeakHoldSections, numberOfSmoothSections, numerics>::defaultDelayBufferLen;
+
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename numerics>
+void LimiterCoefficients<real, numberOfPeakHoldSections, numberOfSmoothSections, numerics>::SetSR(real _SR) {
+    SR = std::max<real>(1.0, _SR);
+    T = 1.0 / SR;
+    smoothParamCoeff = numerics::Exp(-twoPi * smoothParamCutoff * T);
+
+    /* The detection is decimated by powers of two so that it runs at
+     * 88.2 kHz or above. */
+    decimation = 1;
+    while (decimatedDetection && SR >= real(176400.0 * decimation)) {
+        decimation *= 2;
+    }
+    oneOverDecimation = 1.0 / real(decimation);
+    peakHolder.SetSR(SR * oneOverDecimation);
+    expSmoother.SetSR(SR * oneOverDecimation);
+    ResizeDelay();
+
+    /* The look-ahead is recomputed for the new rate, which clips it to the
+     * resized buffers and updates the slack of the decimation. */
+    SetAttTime(attack);
+}
+
+/* The detector gives up lookaheadSlack samples of look-ahead for pipelined
+ * processing, and two groups of samples with decimated detection, one for
+ * the grouping and one for the interpolation of the gain. */
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename numerics>
+size_t LimiterCoefficients<real, numberOfPeakHoldSections, numberOfSmoothSections, numerics>::GetDetectorSlack() const {
+    return lookaheadSlack + (decimation > 1 ? 2 * decimation : 0);
+}
+
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename numerics>
+void LimiterCoefficients<real, numberOfPeakHoldSections, numberOfSmoothSections, numerics>::ResizeDelay() {
+    if (maxAttack > .0) {
+        size_t maxDelay =
+            rint(maxAttack * oneOverPeakSections * SR) * numberOfPeakHoldSections;
+        maxDelay = std::max(maxDelay, GetDetectorSlack());
+        delayBufferLen = DelaySmooth<uint32_t, real>::GetBufferLenFor(maxDelay + internalBlockLen);
+    } else {
+        delayBufferLen = defaultDelayBufferLen;
+    }
+}
+
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename numerics>
+void LimiterCoefficients<real, numberOfPeakHoldSections, numberOfSmoothSections, numerics>::SetMaxAttTime(real _maxAttack) {
+    maxAttack = std::max<real>(.0, _maxAttack);
+    ResizeDelay();
+    SetAttTime(attack);
+}
+
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename numerics>
+void LimiterCoefficients<real, numberOfPeakHoldSections, numberOfSmoothSections, numerics>::SetDecimatedDetection(bool _decimatedDetection) {
+    decimatedDetection = _decimatedDetection;
+    SetSR(SR);
+    SetRelTime(release);
+}
+
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename numerics>
+void LimiterCoefficients<real, numberOfPeakHoldSections, numberOfSmoothSections, numerics>::SetAttTime(real _attack) {
+    attack = std::max<real>(epsilon, _attack);
+
+    /* We compute the delay so that it matches the hold time of the
+     * peak-holder section for correct input-attenuation synchronisation.
+     * Both hold and delay times are dependent on the attack time. */
+    lookaheadDelay =
+        rint(attack * oneOverPeakSections * SR) * numberOfPeakHoldSections;
+    size_t slack = GetDetectorSlack();
+    lookaheadDelay = std::max(lookaheadDelay, slack);
+
+    /* The delay is clipped to the capacity of the buffers, leaving room for
+     * reading a sub-block. */
+    size_t maxDelay = ((delayBufferLen - internalBlockLen) /
+        numberOfPeakHoldSections) * numberOfPeakHoldSections;
+    bool clipped = lookaheadDelay > maxDelay;
+    lookaheadDelay = std::min(lookaheadDelay, maxDelay);
+
+    /* If the gain is applied slack samples after it has been computed,
+     * the detector must anticipate the delayed signal by the same amount,
+     * hence its attack is shortened accordingly. The same holds if the
+     * delay has been clipped. */
+    detectorAttack = attack;
+    if (slack > 0 || clipped) {
+        detectorAttack =
+            std::max<real>(epsilon, real(lookaheadDelay - std::min(slack, lookaheadDelay)) * T);
+    }
+    expSmoother.SetAttTime(detectorAttack);
+    SetHoldTime(hold);
+}
+
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename numerics>
+void LimiterCoefficients<real, numberOfPeakHoldSections, numberOfSmoothSections, numerics>::SetLookaheadSlack(size_t _lookaheadSlack) {
+    lookaheadSlack = _lookaheadSlack;
+    ResizeDelay();
+    SetAttTime(attack);
+}
+
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename numerics>
+void LimiterCoefficients<real, numberOfPeakHoldSections, numberOfSmoothSections, numerics>::SetHoldTime(real _hold) {
+    hold = std::max<real>(.0, _hold);
+
+    /* The hold time is simply an extension of the peak-holder period
+     * that allows for better convergence to the target amplitude. The
+     * parameter is particularly useful to reduce THD at low frequencies.
+     * With decimated detection, peaks are held for an extra group to cover
+     * the coarser timing of the peak-holder. */
+    peakHolder.SetHoldTime(detectorAttack + hold +
+        (decimation > 1 ? real(decimation) * T : .0));
+}
+
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename numerics>
+void LimiterCoefficients<real, numberOfPeakHoldSections, numberOfSmoothSections, numerics>::SetRelTime(real _release) {
+    release = std::max<real>(epsilon, _release);
+    expSmoother.SetRelTime(release);
+}
+
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename numerics>
+void LimiterCoefficients<real, numberOfPeakHoldSections, numberOfSmoothSections, numerics>::SetThreshold(real _threshold) {
+    dBThreshold = std::max<real>(-120.0, _threshold);
+    linThreshold = numerics::Pow(10.0, dBThreshold * .05);
+}
+
+template<typename real, size_t numberOfPeakHoldSections, size_t numberOfSmoothSections, typename numerics>
+void LimiterCoefficients<real, numberOfPeakHoldSections, numberOfSmoothSections, numerics>::SetPreGain(real _preGain) {
+    dBPreGain = _preGain;
+    linPreGain = numerics::Pow(10.0, dBPreGain * .05);
+}
+
+/* The setters, Reclaim, and the destructor are meant for a single 
+ * configuring thread, while any number of audio threads acquire the
+ * published block. The preset must outlive the instances attached to it. */
+template<typename real, size_t numberOfPeakHoldSections = 8, size_t numberOfSmoothSections = 4, typename numerics = StrictNumerics>
+class LimiterPreset {
+    public:
+        typedef LimiterCoefficients<real, numberOfPeakHoldSections, numberOfSmoothSections, numerics> Coefficients;
+
+    private:
+        struct Block {
+            Coefficients coefficients;
+            std::atomic<size_t> users;
+            Block(const Coefficients& _coefficients) : coefficients(_coefficients), users(0) { };
+        };
+
+    public:
+        /* Counted use of a published block. Copies count as users too, and
+         * releasing a block only decrements its count, hence references 
+         * can be replaced and destroyed on audio threads. */
+        class Reference {
+            private:
+                Block* block = nullptr;
+
+            public:
+                const Coefficients* Get() const { return block == nullptr ? nullptr : &block->coefficients; };
+                void Reset() {
+                    if (block != nullptr) {
+                        block->users.fetch_sub(1, std::memory_order_release);
+                    }
+                    block = nullptr;
+                };
+                Reference& operator=(const Reference& other) {
+                    if (other.block != nullptr) {
+                        other.block->users.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    Reset();
+                    block = other.block;
+                    return *this;
+                };
+                Reference& operator=(Reference&& other) {
+                    if (this != &other) {
+                        Reset();
+                        block = other.block;
+                        other.block = nullptr;
+                    }
+                    return *this;
+                };
+                Reference(const Reference& other) { *this = other; };
+                Reference(Reference&& other) : block(other.block) { other.block = nullptr; };
+                explicit Reference(Block* _block) : block(_block) { };
+                Reference() { };
+                ~Reference() { Reset(); };
+        };
+
+    private:
+        Coefficients settings; // Working copy of the configuring thread.
+        std::atomic<Block*> published;
+        std::atomic<uint64_t> version;
+        std::vector<Block*> retired; // Replaced blocks, possibly still in use.
+
+        /* Instances loading the published block, by epoch parity. */
+        mutable std::atomic<uint64_t> epoch;
+        mutable std::atomic<size_t> loading[2];
+
+        void Publish() {
+            Block* block = new Block(settings);
+            Block* previous = published.exchange(block, std::memory_order_seq_cst);
+            version.fetch_add(1, std::memory_order_seq_cst);
+            if (previous != nullptr) {
+                uint64_t parity = epoch.fetch_add(1, std::memory_order_seq_cst) & 1;
+                while (loading[parity].load(std::memory_order_seq_cst) > 0) {
+                    std::this_thread::yield();
+                }
+                retired.push_back(previous);
+            }
+            Reclaim();
+        };
+
+    public:
+        void SetSR(real _SR) { settings.SetSR(_SR); Publish(); };
+        void SetAttTime(real _attack) { settings.SetAttTime(_attack); Publish(); };
+        void SetHoldTime(real _hold) { settings.SetHoldTime(_hold); Publish(); };
+        void SetRelTime(real _release) { settings.SetRelTime(_release); Publish(); };
+        void SetThreshold(real _threshold) { settings.SetThreshold(_threshold); Publish(); };
+        void SetPreGain(real _preGain) { settings.SetPreGain(_preGain); Publish(); };
+        void SetLookaheadSlack(size_t _lookaheadSlack) { settings.SetLookaheadSlack(_lookaheadSlack); Publish(); };
+        void SetMaxAttTime(real _maxAttack) { settings.SetMaxAttTime(_maxAttack); Publish(); };
+        void SetDecimatedDetection(bool _decimatedDetection) {
+            settings.SetDecimatedDetection(_decimatedDetection);
+            Publish();
+        };
+
+        /* Sets all the parameters at once, e.g., to publish a whole new
+         * configuration with a single swap. */
+        void SetCoefficients(const Coefficients& _settings) { settings = _settings; Publish(); };
+        const Coefficients& GetSettings() const { return settings; };
+
+        /* Deletes the retired blocks that no instance uses any longer and
+         * returns the number of those still in use. */
+        size_t Reclaim() {
+            size_t kept = 0;
+            for (Block* block : retired) {
+                if (block->users.load(std::memory_order_acquire) == 0) {
+                    delete block;
+                } else {
+                    retired[kept++] = block;
+                }
+            }
+            retired.resize(kept);
+            return kept;
+        };
+
+        /* The version changes with every published block, so that instances
+         * only acquire the block when it has changed. The version is read
+         * before the block, hence the block is never older than the
+         * version. */
+        uint64_t GetVersion() const { return version.load(std::memory_order_acquire); };
+
+        /* Registers with the counter of the current epoch, checking that the
+         * epoch has not advanced meanwhile, then counts as a user of the
+         * published block. */
+        Reference Acquire() const {
+            uint64_t current = epoch.load(std::memory_order_seq_cst);
+            while (true) {
+                loading[current & 1].fetch_add(1, std::memory_order_seq_cst);
+                uint64_t check = epoch.load(std::memory_order_seq_cst);
+                if (check == current) {
+                    break;
+                }
+                loading[current & 1].fetch_sub(1, std::memory_order_seq_cst);
+                current = check;
+            }
+            Block* block = published.load(std::memory_order_seq_cst);
+            block->users.fetch_add(1, std::memory_order_relaxed);
+            loading[current & 1].fetch_sub(1, std::memory_order_seq_cst);
+            return Reference(block);
+        };
+
+        LimiterPreset() : published(nullptr), version(0), epoch(0) {
+            loading[0] = 0;
+            loading[1] = 0;
+            Publish();
+        };
+        LimiterPreset(const LimiterPreset&) = delete;
+        LimiterPreset& operator=(const LimiterPreset&) = delete;
+        ~LimiterPreset() {
+            for (Block* block : retired) {
+                delete block;
+            }
+            delete published.load();
+        };
+};
@@ -0,0 +1,178 @@
+/*******************************************************************************
+ *
+ * Numerics policies for the processing classes, selecting between
+ * reproducible and fast floating-point arithmetic through their last
+ * template parameter.
+ *
+ * StrictNumerics fixes the operations performed: products are rounded
+ * before being added, i.e., they are never contracted into fused
+ * multiply-adds whatever the -ffp-contract setting and the target,
+ * divisions are exact, and exponentials and powers use std::exp and
+ * std::pow. With the same libm, the outputs are bit-identical across
+ * instruction sets, e.g., SSE2, AVX2, and AVX-512 builds. Note that
+ * -ffast-math allows the compiler to reorder any operation, hence the
+ * classes do not compile with StrictNumerics in that case. On targets
+ * other than x86-64 and AArch64, strict builds need -ffp-contract=off.
+ *
+ * FastNumerics uses fused multiply-adds where the target has them,
+ * Newton-Raphson reciprocals in place of divisions, and polynomial
+ * approximations of exp and pow, with relative errors close to the
+ * precision of the type. The results depend on the target.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <cstring>
+
+struct StrictNumerics {
+#ifdef __FAST_MATH__
+    static const bool available = false;
+#else
+    static const bool available = true;
+#endif
+    static const bool strict = true;
+
+    /* The empty asm statements keep the rounded product in a register
+     * opaque to the compiler, which then cannot fuse it with the addition.
+     * They cost nothing but prevent the vectorisation of the loop, hence
+     * MulAdd is only used in recursive loops. */
+    static float Opaque(float x) {
+#if defined(__GNUC__) && defined(__x86_64__)
+        __asm__("" : "+x"(x));
+#elif defined(__GNUC__) && defined(__aarch64__)
+        __asm__("" : "+w"(x));
+#endif
+        return x;
+    };
+    static double Opaque(double x) {
+#if defined(__GNUC__) && defined(__x86_64__)
+        __asm__("" : "+x"(x));
+#elif defined(__GNUC__) && defined(__aarch64__)
+        __asm__("" : "+w"(x));
+#endif
+        return x;
+    };
+    template<typename T>
+    static T Opaque(T x) { return x; };
+
+    /* Returns a * b + c. */
+    template<typename T>
+    static T MulAdd(T a, T b, T c) { return Opaque(a * b) + c; };
+
+    /* Block version, y[n] = a[n] * b + c[n], where y may be a. The products
+     * are stored, hence rounded, before a second loop adds them, so that
+     * both loops vectorise. */
+    template<typename T>
+    static void MulAddVec(const T* a, T b, const T* c, T* y, size_t vecLen) {
+        for (size_t n = 0; n < vecLen; n++) {
+            y[n] = a[n] * b;
+        }
+        for (size_t n = 0; n < vecLen; n++) {
+            y[n] += c[n];
+        }
+    };
+
+    template<typename T>
+    static T Divide(T a, T b) { return a / b; };
+    template<typename T>
+    static T Exp(T x) { return std::exp(x); };
+    template<typename T>
+    static T Pow(T x, T y) { return std::pow(x, y); };
+};
+
+struct FastNumerics {
+    static const bool available = true;
+    static const bool strict = false;
+
+    template<typename T>
+    static T MulAdd(T a, T b, T c) {
+#ifdef FP_FAST_FMA
+        return std::fma(a, b, c);
+#else
+        return a * b + c;
+#endif
+    };
+    template<typename T>
+    static void MulAddVec(const T* a, T b, const T* c, T* y, size_t vecLen) {
+        for (size_t n = 0; n < vecLen; n++) {
+            y[n] = MulAdd(a[n], b, c[n]);
+        }
+    };
+
+    /* The first guess flips the exponent through an integer subtraction
+     * and has a relative error below 1/8; each Newton-Raphson iteration
+     * squares the error. Unlike divisions, the iterations pipeline fully
+     * in vector loops. The divisors must be positive and finite. */
+    static float Reciprocal(float x) {
+        uint32_t i;
+        memcpy(&i, &x, sizeof(i));
+        i = 0x7EF311C3u - i;
+        float y;
+        memcpy(&y, &i, sizeof(y));
+        for (size_t k = 0; k < 3; k++) {
+            y = y * MulAdd(-x, y, 2.0f);
+        }
+        return y;
+    };
+    static double Reciprocal(double x) {
+        uint64_t i;
+        memcpy(&i, &x, sizeof(i));
+        i = 0x7FDE623822FC16E6ull - i;
+        double y;
+        memcpy(&y, &i, sizeof(y));
+        for (size_t k = 0; k < 5; k++) {
+            y = y * MulAdd(-x, y, 2.0);
+        }
+        return y;
+    };
+    template<typename T>
+    static T Divide(T a, T b) { return a * Reciprocal(b); };
+
+    /* exp(x) = 2^k * exp(r), with k the nearest integer to x / ln(2) and
+     * |r| <= ln(2) / 2, where exp(r) is computed with its Taylor series up
+     * to the precision of the type. ln(2) is split in two parts so that
+     * r is exact for the range of k. The input is clipped so that 2^k is a 
+     * normal number, i.e., results below the smallest normal number are 
+     * not flushed to zero, and the exponent is set through its bits. */
+    static float Scale(float y, int64_t k) {
+        uint32_t i = uint32_t(k + 127) << 23;
+        float scale;
+        memcpy(&scale, &i, sizeof(scale));
+        return y * scale;
+    };
+    static double Scale(double y, int64_t k) {
+        uint64_t i = uint64_t(k + 1023) << 52;
+        double scale;
+        memcpy(&scale, &i, sizeof(scale));
+        return y * scale;
+    };
+    template<typename T>
+    static T Exp(T x) {
+        const bool single = sizeof(T) <= sizeof(float);
+        const T ln2 = T(0.6931471805599453);
+        const T maxExponent = single ? T(127.0) : T(1023.0);
+        const size_t order = single ? 7 : 12;
+        x = std::max<T>(-(maxExponent - T(1.0)) * ln2, std::min<T>(maxExponent * ln2, x));
+        T t = x * T(1.4426950408889634);
+        int64_t k = int64_t(t + (t >= T(0.0) ? T(.5) : T(-.5)));
+        const T ln2High = single ? T(0.693359375) : T(6.93147180369123816490e-01);
+        const T ln2Low = single ? T(-2.12194440e-4) : T(1.90821492927058770002e-10);
+        T r = MulAdd(T(k), -ln2Low, MulAdd(T(k), -ln2High, x));
+        T y = T(1.0);
+        for (size_t n = order; n > 0; n--) {
+            y = MulAdd(y, r * T(1.0 / double(n)), T(1.0));
+        }
+        return Scale(y, k);
+    };
+
+    /* Defined for positive bases, which is how the classes use it. */
+    template<typename T>
+    static T Pow(T x, T y) { return Exp(y * std::log(x)); };
+};
@@ -0,0 +1,97 @@
+/*******************************************************************************
+ *
+ * Sample formats for integer PCM input and output.
+ *
+ * PcmFormat maps a sample type onto the range [-1; 1) through the value
+ * of the sample, read as a floating-point number, and a scale, i.e., the
+ * value of one least significant bit. The scales are powers of two, hence
+ * scaling is exact and can be folded into other gains without changing the
+ * result. The integer formats are int16_t, packed 24-bit little-endian
+ * Int24, and int32_t; floating-point types map onto themselves with a unit
+ * scale.
+ *
+ * Write converts a value in units of the least significant bit to the 
+ * format, rounding to the nearest integer and saturating to its range. The
+ * operations are branchless, so that block loops writing PCM vectorise.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+/* Packed 24-bit little-endian integer. */
+struct Int24 {
+    uint8_t bytes[3];
+};
+
+template<typename sample>
+struct PcmFormat {
+    static const bool integer = false;
+    static constexpr double scale = 1.0;
+
+    template<typename real>
+    static real Read(sample x) { return real(x); };
+    template<typename real>
+    static sample Write(real x) { return sample(x); };
+};
+
+/* Rounds to the nearest integer, halves away from zero, and saturates to
+ * the given range, which must be exactly representable in the type. The 
+ * rounding offset is added before the saturation, which GCC only 
+ * vectorises in this order. */
+template<typename real>
+static inline int32_t RoundToPcm(real x, real minValue, real maxValue) {
+    x += std::copysign(real(.5), x);
+    return int32_t(std::max(minValue, std::min(maxValue, x)));
+}
+
+template<>
+struct PcmFormat<int16_t> {
+    static const bool integer = true;
+    static constexpr double scale = 1.0 / 32768.0;
+
+    template<typename real>
+    static real Read(int16_t x) { return real(x); };
+    template<typename real>
+    static int16_t Write(real x) { return int16_t(RoundToPcm<real>(x, -32768.0, 32767.0)); };
+};
+
+template<>
+struct PcmFormat<Int24> {
+    static const bool integer = true;
+    static constexpr double scale = 1.0 / 8388608.0;
+
+    /* The bytes are placed in the upper 24 bits and shifted back for sign
+     * extension. */
+    template<typename real>
+    static real Read(Int24 x) {
+        int32_t i = int32_t(uint32_t(x.bytes[0]) << 8 | uint32_t(x.bytes[1]) << 16 |
+            uint32_t(x.bytes[2]) << 24) >> 8;
+        return real(i);
+    };
+    template<typename real>
+    static Int24 Write(real x) {
+        int32_t i = RoundToPcm<real>(x, -8388608.0, 8388607.0);
+        Int24 y = { { uint8_t(i), uint8_t(i >> 8), uint8_t(i >> 16) } };
+        return y;
+    };
+};
+
+template<>
+struct PcmFormat<int32_t> {
+    static const bool integer = true;
+    static constexpr double scale = 1.0 / 2147483648.0;
+
+    template<typename real>
+    static real Read(int32_t x) { return real(x); };
+
+    /* The range of int32_t is not exact in float, hence the rounding 
+     * takes place in double. */
+    template<typename real>
+    static int32_t Write(real x) { return RoundToPcm<double>(double(x), -2147483648.0, 2147483647.0); };
+};
@@ -10,6 +10,11 @@
  * time that is 1 / M of the full hold period. This allows for secondary peaks 
  * occurring after holdTime / M to also be detected.
  *
+ * The timers and the held peaks can be stored with compact types, e.g., 
+ * uint32_t or uint16_t timers and float peaks for double processing, so 
+ * that the state of a cascade packs densely into cache lines and vector 
+ * registers. Hold times beyond the range of the timer type are clipped.
+ *
  * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
  *
  * ****************************************************************************/
@@ -18,56 +23,84 @@
 
 #include <cmath>
 #include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <limits>
 
+/* The coefficients only depend on the settings, so that instances with the
+ * same settings can share them, whatever their state types. */
 template<size_t stages, typename real>
+struct PeakHoldCoefficients {
+    real SR = 48000.0; // Samplerate as a float variable for later calculations.
+    real holdTime = .001; // Hold time in seconds.
+    real oneOverStages = 1.0 / real(stages);
+
+    /* We approximate the given hold time in seconds by rounding the samples
+     * conversion to the nearest int. Note that the hold time variations are 
+     * constrained to steps of "stages" samples, which is the number of cascaded
+     * sections. */
+    size_t holdTimeSamples = std::rint(holdTime * oneOverStages * SR);
+
+    void SetSR(real _SR) {
+        SR = std::max<real>(1.0, _SR);
+        holdTimeSamples = std::rint(holdTime * oneOverStages * SR);
+    };
+    void SetHoldTime(real _holdTime) {
+        holdTime = std::max<real>(.0, _holdTime);
+        holdTimeSamples = std::rint(holdTime * oneOverStages * SR);
+    };
+};
+
+template<size_t stages, typename real, typename timerType = size_t, typename stateType = real>
 class PeakHoldCascade {
     
     static_assert(stages > 0, "The PeakHoldCascade class expects one or more stages.");
+    static_assert(std::numeric_limits<timerType>::is_integer && !std::numeric_limits<timerType>::is_signed, 
+        "The PeakHoldCascade class expects an unsigned integer timer type.");
     
+    public:
+        typedef PeakHoldCoefficients<stages, real> Coefficients;
+        struct State {
+            timerType timer[stages] = { 0 };
+            stateType output[stages] = { .0 };
+
+            void Reset() {
+                memset(timer, 0, sizeof(timer));
+                memset(output, 0, sizeof(output));
+            };
+        };
+        static void Process(const Coefficients& coefficients, State& state, 
+            real* xVec, real* yVec, size_t vecLen);
+
     private:
-        real SR = 48000.0; // Samplerate as a float variable for later calculations.
-        real holdTime = .001; // Hold time in seconds.
-        const real oneOverStages = 1.0 / real(stages);
-
-        /* We approximate the given hold time in seconds by rounding the samples
-         * conversion to the nearest int. Note that the hold time variations are 
-         * constrained to steps of "stages" samples, which is the number of cascaded
-         * sections. */
-        size_t holdTimeSamples = std::rint(holdTime * oneOverStages * SR);
-        
-        size_t timer[stages] = { 0 };
-        real output[stages] = { .0 };
+        Coefficients coefficients;
+        State state;
 
     public:
-        void SetSR(real _SR);
-        void SetHoldTime(real _holdTime);
-        void Reset() {
-            memset(timer, 0, stages);
-            memset(output, 0, stages);
+        void SetSR(real _SR) { coefficients.SetSR(_SR); };
+        void SetHoldTime(real _holdTime) { coefficients.SetHoldTime(_holdTime); };
+        void Reset() { state.Reset(); };
+        void Process(real* xVec, real* yVec, size_t vecLen) {
+            Process(coefficients, state, xVec, yVec, vecLen);
         };
-        void Process(real* xVec, real* yVec, size_t vecLen);
         PeakHoldCascade() { };
         PeakHoldCascade(real _SR, real _holdTime);
 };
 
-template<size_t stages, typename real>
-void PeakHoldCascade<stages, real>::SetSR(real _SR) {
-    SR = std::max<real>(1.0, _SR);
-    holdTimeSamples = std::rint(holdTime * oneOverStages * SR);
-}
-
-template<size_t stages, typename real>
-void PeakHoldCascade<stages, real>::SetHoldTime(real _holdTime) {
-    holdTime = std::max<real>(.0, _holdTime);
-    holdTimeSamples = std::rint(holdTime * oneOverStages * SR);
-}
-
 /* This function computes a peak-holder with a given period P as a combination
  * of "stages" series peak-holder sections with an hold period of P / stages.
  * Given input and output vectors, the function processes a block of vecLen
  * samples of the input signal and stores it in the output vector. */
-template<size_t stages, typename real>
-void PeakHoldCascade<stages, real>::Process(real* xVec, real* yVec, size_t vecLen) {
+template<size_t stages, typename real, typename timerType, typename stateType>
+void PeakHoldCascade<stages, real, timerType, stateType>::Process(const Coefficients& coefficients, State& state, 
+        real* xVec, real* yVec, size_t vecLen) {
+    timerType* timer = state.timer;
+    stateType* output = state.output;
+
+    /* The timers are reset when they reach the hold time, hence they never
+     * overflow if the hold time is within their range. */
+    const timerType holdTimeSamples = timerType(std::min<size_t>(coefficients.holdTimeSamples, 
+        size_t(std::numeric_limits<timerType>::max())));
     for (size_t n = 0; n < vecLen; n++) { // Level-0 for-loop.
 
         /* Outside of th einner for-loop, we assign the absolute value 
@@ -94,14 +127,14 @@ void PeakHoldCascade<stages, real>::Process(real* xVec, real* yVec, size_t vecLe
              * for the variables with bifurcation and assign the results using
              * Boolean array-fetching, which is faster than two multiplications 
              * by bools. */
-            size_t timerPaths[2] = {
-                timer[stage] + 1,
+            timerType timerPaths[2] = {
+                timerType(timer[stage] + 1),
                 0
             };
             timer[stage] = timerPaths[release];
-            real outPaths[2] = {
+            stateType outPaths[2] = {
                 output[stage],
-                input
+                stateType(input)
             };
             output[stage] = outPaths[release];
 
@@ -119,9 +152,10 @@ void PeakHoldCascade<stages, real>::Process(real* xVec, real* yVec, size_t vecLe
     } // End of level-0 for-loop.
 }
 
-template<size_t stages, typename real>
-PeakHoldCascade<stages, real>::PeakHoldCascade(real _SR, real _holdTime) {
-    SR = std::max<real>(1.0, _SR);
-    holdTime = _holdTime;
-    holdTimeSamples = std::rint(holdTime * oneOverStages * SR);
+template<size_t stages, typename real, typename timerType, typename stateType>
+PeakHoldCascade<stages, real, timerType, stateType>::PeakHoldCascade(real _SR, real _holdTime) {
+    coefficients.SR = std::max<real>(1.0, _SR);
+    coefficients.holdTime = _holdTime;
+    coefficients.holdTimeSamples = 
+        std::rint(coefficients.holdTime * coefficients.oneOverStages * coefficients.SR);
 }
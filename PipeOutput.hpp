@@ -0,0 +1,176 @@
+/*******************************************************************************
+ *
+ * Output to a file descriptor that hands whole buffers over to a pipe with
+ * vmsplice() (Linux) instead of copying them with write().
+ *
+ * The caller fills the space returned by GetSpace and commits the bytes it
+ * has written. The bytes are gathered into page-aligned buffers, and only
+ * full buffers are spliced, so that each page of a buffer takes exactly one
+ * slot of the pipe; splicing therefore requires buffers of a whole number
+ * of pages. The pipe references the pages until the reader consumes them,
+ * and it holds at most as many pages as its capacity, hence once a buffer
+ * has been followed by at least the capacity of the pipe in newer spliced
+ * pages, it has been consumed and it can be filled again. The buffers form
+ * a ring sized accordingly.
+ *
+ * Flush writes a partially filled buffer with write(), which copies it, so
+ * the buffer can be refilled at once. Callers flush when no more input is
+ * immediately available, to keep the latency low when the input trickles.
+ *
+ * The reasoning above assumes that the reader copies the data, e.g., with
+ * read(). A reader that moves the pages on with splice() or tee() keeps
+ * them referenced after they have left the pipe, in which case splicing
+ * must be disabled with SetSplice(false). When the file descriptor is not a
+ * pipe, or vmsplice() is not supported, the buffers are written with
+ * write().
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#pragma once
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cerrno>
+#include <new>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+class PipeOutput {
+    private:
+        int fd = STDOUT_FILENO;
+        bool splice = false;
+        size_t bufferBytes = 0;
+        size_t filled = 0; // Bytes committed to the current buffer.
+        std::vector<uint8_t*> buffers;
+        size_t next = 0; // Current buffer.
+
+        bool WriteAll(const uint8_t* data, size_t len) {
+            while (len > 0) {
+                ssize_t result = write(fd, data, len);
+                if (result < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (result <= 0) {
+                    return false;
+                }
+                data += result;
+                len -= size_t(result);
+            }
+            return true;
+        };
+
+        /* Hands over the current buffer, which is full, and moves on. */
+        bool Send() {
+            uint8_t* data = buffers[next];
+            size_t len = bufferBytes;
+            filled = 0;
+            if (!splice) {
+                return WriteAll(data, len);
+            }
+            next = (next + 1) % buffers.size();
+            while (len > 0) {
+                iovec iov = { data, len };
+                ssize_t result = vmsplice(fd, &iov, 1, 0);
+                if (result < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (result < 0) {
+
+                    /* Not supported for this pipe: fall back to write(). */
+                    splice = false;
+                    break;
+                }
+                data += result;
+                len -= size_t(result);
+            }
+            return WriteAll(data, len);
+        };
+
+        void Free() {
+            for (uint8_t* buffer : buffers) {
+                std::free(buffer);
+            }
+            buffers.clear();
+        };
+
+    public:
+        /* Buffers hold the given number of bytes, e.g., a whole number of
+         * frames. Throws std::bad_alloc if they cannot be allocated. */
+        void Init(int _fd, size_t _bufferBytes) {
+            Free();
+            fd = _fd;
+            const size_t pageBytes = size_t(sysconf(_SC_PAGESIZE));
+            bufferBytes = std::max<size_t>(1, _bufferBytes);
+            filled = 0;
+            next = 0;
+            splice = false;
+            size_t numberOfBuffers = 1;
+            struct stat status;
+            if (bufferBytes % pageBytes == 0 && fstat(fd, &status) == 0 && S_ISFIFO(status.st_mode)) {
+
+                /* Try to enlarge the pipe so that fewer context switches
+                 * take place, then size the ring after its capacity: a
+                 * buffer is refilled after the next numberOfBuffers - 1
+                 * buffers have been spliced. */
+                fcntl(fd, F_SETPIPE_SZ, int(bufferBytes));
+                int pipeBytes = fcntl(fd, F_GETPIPE_SZ);
+                if (pipeBytes > 0) {
+                    splice = true;
+                    numberOfBuffers = (size_t(pipeBytes) + bufferBytes - 1) / bufferBytes + 1;
+                }
+            }
+            buffers.reserve(numberOfBuffers);
+            for (size_t i = 0; i < numberOfBuffers; i++) {
+                uint8_t* buffer = static_cast<uint8_t*>(std::aligned_alloc(pageBytes,
+                    (bufferBytes + pageBytes - 1) / pageBytes * pageBytes));
+                if (buffer == nullptr) {
+                    Free();
+                    throw std::bad_alloc();
+                }
+                buffers.push_back(buffer);
+            }
+        };
+
+        /* Disables splicing, e.g., when the reader splices the data on. */
+        void SetSplice(bool _splice) { splice = splice && _splice; };
+
+        /* Returns the free space of the current buffer and its size in
+         * bytes, which is never zero. */
+        uint8_t* GetSpace(size_t& bytes) {
+            bytes = bufferBytes - filled;
+            return buffers[next] + filled;
+        };
+
+        /* Commits bytes written to the space returned by GetSpace, sending
+         * the buffer once full. Returns false on errors. */
+        bool Commit(size_t bytes) {
+            filled += bytes;
+            return filled < bufferBytes ? true : Send();
+        };
+
+        /* Writes the committed bytes of a partially filled buffer. */
+        bool Flush() {
+            size_t len = filled;
+            filled = 0;
+            return WriteAll(buffers[next], len);
+        };
+
+        bool IsSplicing() const { return splice; };
+        size_t GetBufferBytes() const { return bufferBytes; };
+
+        PipeOutput() { };
+        PipeOutput(const PipeOutput&) = delete;
+        PipeOutput& operator=(const PipeOutput&) = delete;
+        ~PipeOutput() { Free(); };
+};
@@ -0,0 +1,90 @@
+/*******************************************************************************
+ *
+ * Lock-free single-producer single-consumer ring buffer.
+ *
+ * The capacity is rounded up to a power of two so that the read and write
+ * counters can run freely and wrap around with a mask. Each side caches the
+ * counter of the other side to limit the traffic on the shared cache lines.
+ * Bulk operations transfer as many elements as possible and return their
+ * number, so that the caller decides whether to retry or to give up.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+
+template<typename element>
+class SpscQueue {
+    private:
+        std::vector<element> buffer;
+        size_t mask = 0;
+        alignas(64) std::atomic<size_t> writeIndex;
+        size_t cachedReadIndex = 0; // Producer's copy of readIndex.
+        alignas(64) std::atomic<size_t> readIndex;
+        size_t cachedWriteIndex = 0; // Consumer's copy of writeIndex.
+
+    public:
+        /* Not thread-safe: call before the producer and consumer start. */
+        void SetCapacity(size_t capacity) {
+            size_t len = 1;
+            while (len < capacity) {
+                len <<= 1;
+            }
+            buffer.assign(len, element());
+            mask = len - 1;
+            writeIndex.store(0);
+            readIndex.store(0);
+            cachedReadIndex = 0;
+            cachedWriteIndex = 0;
+        };
+        size_t GetCapacity() const { return buffer.size(); };
+
+        /* Producer side. */
+        size_t GetWriteAvailable() {
+            size_t write = writeIndex.load(std::memory_order_relaxed);
+            cachedReadIndex = readIndex.load(std::memory_order_acquire);
+            return buffer.size() - (write - cachedReadIndex);
+        };
+        size_t Push(const element* data, size_t len) {
+            size_t write = writeIndex.load(std::memory_order_relaxed);
+            if (buffer.size() - (write - cachedReadIndex) < len) {
+                cachedReadIndex = readIndex.load(std::memory_order_acquire);
+            }
+            len = std::min(len, buffer.size() - (write - cachedReadIndex));
+            for (size_t i = 0; i < len; i++) {
+                buffer[(write + i) & mask] = data[i];
+            }
+            writeIndex.store(write + len, std::memory_order_release);
+            return len;
+        };
+        bool Push(const element& item) { return Push(&item, 1) == 1; };
+
+        /* Consumer side. */
+        size_t GetReadAvailable() {
+            size_t read = readIndex.load(std::memory_order_relaxed);
+            cachedWriteIndex = writeIndex.load(std::memory_order_acquire);
+            return cachedWriteIndex - read;
+        };
+        size_t Pop(element* data, size_t len) {
+            size_t read = readIndex.load(std::memory_order_relaxed);
+            if (cachedWriteIndex - read < len) {
+                cachedWriteIndex = writeIndex.load(std::memory_order_acquire);
+            }
+            len = std::min(len, cachedWriteIndex - read);
+            for (size_t i = 0; i < len; i++) {
+                data[i] = buffer[(read + i) & mask];
+            }
+            readIndex.store(read + len, std::memory_order_release);
+            return len;
+        };
+        bool Pop(element& item) { return Pop(&item, 1) == 1; };
+
+        SpscQueue() : writeIndex(0), readIndex(0) { };
+        SpscQueue(size_t capacity) : writeIndex(0), readIndex(0) { SetCapacity(capacity); };
+};
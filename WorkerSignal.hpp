@@ -0,0 +1,89 @@
+/*******************************************************************************
+ *
+ * Block hand-off between a thread calling Process and a pool of worker
+ * threads (Linux).
+ *
+ * The calling thread publishes each block by incrementing a generation
+ * counter, and the workers wait for the counter to change. A worker spins
+ * for a short while, which covers the gap between consecutive blocks of a
+ * busy callback, and then sleeps on a futex, so that idle workers take no
+ * CPU time, also when they run with a real-time priority that would keep
+ * lower-priority threads from running while they spin. Publishing only
+ * enters the kernel when some worker is asleep, and it takes no locks.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <thread>
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* Busy-wait step: a pause instruction for the first iterations, then a
+ * yield. Only meant for waits bounded by the work of one block. */
+static inline void SpinPause(size_t& spins) {
+    if (++spins < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    } else {
+        std::this_thread::yield();
+    }
+}
+
+class WorkerSignal {
+    private:
+        alignas(64) std::atomic<uint32_t> generation;
+        alignas(64) std::atomic<uint32_t> sleepers;
+
+        static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "The futex word must be 32 bits.");
+
+        void Futex(int operation, uint32_t value) {
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&generation), operation | FUTEX_PRIVATE_FLAG,
+                value, nullptr, nullptr, 0);
+        };
+
+    public:
+        static const size_t spinLimit = 4096;
+
+        uint32_t Get() const { return generation.load(std::memory_order_acquire); };
+
+        /* Starts a new generation and wakes the sleeping workers. */
+        void Publish() {
+            generation.fetch_add(1, std::memory_order_seq_cst);
+            if (sleepers.load(std::memory_order_seq_cst) > 0) {
+                Futex(FUTEX_WAKE, INT_MAX);
+            }
+        };
+
+        /* Returns the first generation after seen, spinning for up to
+         * spinLimit iterations of SpinPause before sleeping; the yields
+         * let the publishing thread run when both share a core. A sleeper registers before
+         * checking the counter again, and Publish checks for sleepers after
+         * incrementing it, hence no wake-up is lost. */
+        uint32_t Wait(uint32_t seen) {
+            for (size_t spins = 0; spins < spinLimit; ) {
+                uint32_t current = generation.load(std::memory_order_acquire);
+                if (current != seen) {
+                    return current;
+                }
+                SpinPause(spins);
+            }
+            sleepers.fetch_add(1, std::memory_order_seq_cst);
+            uint32_t current = generation.load(std::memory_order_seq_cst);
+            while (current == seen) {
+                Futex(FUTEX_WAIT, seen);
+                current = generation.load(std::memory_order_acquire);
+            }
+            sleepers.fetch_sub(1, std::memory_order_relaxed);
+            return current;
+        };
+        WorkerSignal() : generation(0), sleepers(0) { };
+};
@@ -0,0 +1,116 @@
+/*******************************************************************************
+ *
+ * Throughput benchmark of the batch renderer with the plain read/write
+ * backend and with the io_uring backend.
+ *
+ * Usage: benchBatchIO [files] [frames per file] [files in flight]
+ *
+ * The program writes the given number of short noise clips to a temporary
+ * directory, processes them with both backends, checks that the outputs are
+ * identical, and reports files per second and megabytes per second.
+ *
+ * ****************************************************************************/
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Generators.hpp"
+#include "LimiterBatch.hpp"
+
+typedef float real;
+
+static bool ReadFile(const std::string& path, std::vector<char>& data) {
+    data.clear();
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    char chunk[65536];
+    ssize_t result;
+    while ((result = read(fd, chunk, sizeof(chunk))) > 0) {
+        data.insert(data.end(), chunk, chunk + result);
+    }
+    close(fd);
+    return result == 0;
+}
+
+static void Print(const BatchReport& report, size_t bytesPerFile) {
+    double megabytes = 1e-6 * double(report.files * bytesPerFile);
+    std::cout << std::setw(10) << report.backend << ": " << report.files << " files, "
+        << report.failures << " failures, " << report.seconds << " s, "
+        << double(report.files) / report.seconds << " files/s, "
+        << megabytes / report.seconds << " MB/s" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    size_t numberOfFiles = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+    size_t frames = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 12000;
+    size_t filesInFlight = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 16;
+
+    std::cout << std::fixed << std::setprecision(3);
+
+    char directory[] = "/tmp/benchBatchIOXXXXXX";
+    if (mkdtemp(directory) == nullptr) {
+        std::cout << "Cannot create the temporary directory." << std::endl;
+        return 1;
+    }
+    std::string base = directory;
+
+    /* Write the input clips. */
+    std::vector<real> clip(2 * frames);
+    Generators<real> generators;
+    std::vector<BatchJob> plainJobs(numberOfFiles);
+    std::vector<BatchJob> uringJobs(numberOfFiles);
+    for (size_t i = 0; i < numberOfFiles; i++) {
+        std::string name = base + "/clip" + std::to_string(i);
+        plainJobs[i] = { name + ".raw", name + ".plain.raw" };
+        uringJobs[i] = { name + ".raw", name + ".uring.raw" };
+        generators.ProcessNoise(clip.data(), 2 * frames);
+        int fd = open(plainJobs[i].inputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        ssize_t bytes = clip.size() * sizeof(real);
+        if (fd < 0 || write(fd, clip.data(), bytes) != bytes) {
+            std::cout << "Cannot write the input files." << std::endl;
+            return 1;
+        }
+        close(fd);
+    }
+
+    LimiterBatch<real> batch;
+    batch.SetSR(48000.0);
+    batch.SetAttTime(.01);
+    batch.SetHoldTime(.0);
+    batch.SetRelTime(.05);
+    batch.SetThreshold(-.3);
+    batch.SetPreGain(24.0);
+    batch.SetFilesInFlight(filesInFlight);
+
+    std::cout << numberOfFiles << " files of " << frames << " frames, "
+        << filesInFlight << " files in flight." << std::endl;
+    BatchReport plain = batch.RunPlain(plainJobs);
+    Print(plain, 2 * frames * sizeof(real));
+    BatchReport uring = batch.RunUring(uringJobs);
+    Print(uring, 2 * frames * sizeof(real));
+
+    /* Compare and remove the files. */
+    size_t mismatches = 0;
+    std::vector<char> a, b;
+    for (size_t i = 0; i < numberOfFiles; i++) {
+        bool ok = ReadFile(plainJobs[i].outputPath, a) && ReadFile(uringJobs[i].outputPath, b);
+        if (!ok || a != b || a.size() != 2 * frames * sizeof(real)) {
+            mismatches++;
+        }
+        unlink(plainJobs[i].inputPath.c_str());
+        unlink(plainJobs[i].outputPath.c_str());
+        unlink(uringJobs[i].outputPath.c_str());
+    }
+    rmdir(directory);
+
+    std::cout << "Speed-up: " << plain.seconds / uring.seconds << "x, mismatching outputs: "
+        << mismatches << std::endl;
+    return mismatches == 0 && plain.failures == 0 && uring.failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,243 @@
+/*******************************************************************************
+ *
+ * Real-time deadline harness for the Limiter class (Linux).
+ *
+ * Instead of measuring the mean execution time of Process in a tight loop,
+ * the harness emulates an audio callback: a periodic thread wakes up every
+ * blockLen / SR seconds with clock_nanosleep on absolute deadlines and calls
+ * Limiter::Process once per period. For each callback, it records the wake-up
+ * jitter, the processing time, and whether the processing completed before
+ * the end of the period, i.e., the deadline. Optionally, the periodic thread
+ * runs with SCHED_FIFO priority and locked memory, and background threads
+ * thrash the caches to emulate a loaded system.
+ *
+ * Usage: benchDeadline [--block N] [--seconds S] [--fifo] [--load THREADS]
+ *
+ * Without --block, the harness runs 32, 64, and 128-sample callbacks in
+ * sequence. The per-callback measurements are written to Deadline.csv.
+ *
+ * ****************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include "Generators.hpp"
+#include "Limiter.hpp"
+
+typedef float real;
+
+struct Callback {
+    int64_t jitter; // Wake-up time minus scheduled time in nanoseconds.
+    int64_t processTime; // Duration of Process in nanoseconds.
+    bool missed; // Completion after the end of the period.
+};
+
+static inline int64_t Now() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static inline timespec ToTimespec(int64_t ns) {
+    timespec ts;
+    ts.tv_sec = ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+    return ts;
+}
+
+/* Background load: each thread repeatedly writes to every cache line of a
+ * buffer much larger than the last-level cache, evicting the limiter state
+ * between callbacks. */
+static void Thrash(std::atomic<bool>* running) {
+    const size_t bufferLen = 64 << 20;
+    std::vector<uint8_t> buffer(bufferLen, 1);
+    uint8_t accumulator = 0;
+    while (running->load(std::memory_order_relaxed)) {
+        for (size_t i = 0; i < bufferLen; i += 64) {
+            buffer[i] += accumulator;
+            accumulator ^= buffer[(i * 7919) % bufferLen];
+        }
+    }
+    volatile uint8_t sink = accumulator;
+    (void)sink;
+}
+
+struct Settings {
+    size_t blockLen;
+    double seconds;
+    bool fifo;
+};
+
+static void RunPeriodic(const Settings& settings, std::vector<Callback>& callbacks) {
+    const real SR = 48000.0;
+    const size_t blockLen = settings.blockLen;
+    const int64_t period = int64_t(1e9 * double(blockLen) / double(SR));
+    const size_t numberOfCallbacks = size_t(settings.seconds * SR / double(blockLen));
+
+    if (settings.fifo) {
+        sched_param param;
+        param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 1;
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
+            std::cout << "Warning: SCHED_FIFO not permitted, running with the default policy." << std::endl;
+        }
+    }
+
+    /* All memory used in the periodic loop is allocated and touched here. */
+    Limiter<real> limiter;
+    limiter.SetSR(SR);
+    limiter.SetAttTime(.01);
+    limiter.SetHoldTime(.0);
+    limiter.SetRelTime(.05);
+    limiter.SetPreGain(12.0);
+    limiter.SetThreshold(-.3);
+    limiter.Reset();
+    std::vector<real> left(blockLen);
+    std::vector<real> right(blockLen);
+    std::vector<real> noise(48000);
+    real* xVec[2] = { left.data(), right.data() };
+    Generators<real> generators;
+    generators.ProcessNoise(noise.data(), noise.size());
+    callbacks.assign(numberOfCallbacks, Callback());
+
+    int64_t deadline = Now() + period;
+    size_t noiseOffset = 0;
+    for (size_t i = 0; i < numberOfCallbacks; i++) {
+        timespec wake = ToTimespec(deadline);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, nullptr) != 0) { }
+        int64_t t0 = Now();
+
+        /* Emulate the driver filling the input buffers. */
+        for (size_t n = 0; n < blockLen; n++) {
+            left[n] = noise[noiseOffset];
+            right[n] = -noise[noiseOffset];
+            noiseOffset = noiseOffset + 1 == noise.size() ? 0 : noiseOffset + 1;
+        }
+        limiter.Process(xVec, xVec, blockLen);
+        int64_t t1 = Now();
+
+        /* The output of this callback is due at the next period. */
+        callbacks[i].jitter = t0 - deadline;
+        callbacks[i].processTime = t1 - t0;
+        callbacks[i].missed = t1 > deadline + period;
+        deadline += period;
+
+        /* After a miss, we skip the lost periods as a driver would. */
+        int64_t now = Now();
+        while (deadline < now) {
+            deadline += period;
+        }
+    }
+}
+
+/* Returns 0 when no callbacks were recorded. */
+static int64_t Percentile(std::vector<int64_t>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = size_t(p * double(sorted.size() - 1) + .5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+static void Report(size_t blockLen, const std::vector<Callback>& callbacks, std::ofstream& csvFile) {
+    std::vector<int64_t> jitters;
+    std::vector<int64_t> processTimes;
+    size_t misses = 0;
+    for (size_t i = 0; i < callbacks.size(); i++) {
+        jitters.push_back(callbacks[i].jitter);
+        processTimes.push_back(callbacks[i].processTime);
+        misses += callbacks[i].missed;
+        csvFile << blockLen << "," << i << "," << callbacks[i].jitter << ","
+            << callbacks[i].processTime << "," << callbacks[i].missed << "\n";
+    }
+    std::sort(jitters.begin(), jitters.end());
+    std::sort(processTimes.begin(), processTimes.end());
+
+    const double percentiles[] = { .0, .5, .9, .99, .999, .9999, 1.0 };
+    std::cout << "Block size: " << blockLen << " samples, period (microsecond): "
+        << 1e6 * double(blockLen) / 48000.0 << std::endl;
+    if (callbacks.empty()) {
+        std::cout << "Callbacks: 0, the run is shorter than one block." << std::endl;
+        return;
+    }
+    std::cout << "Callbacks: " << callbacks.size() << ", deadline misses: " << misses
+        << " (" << 100.0 * double(misses) / double(callbacks.size()) << "%)" << std::endl;
+    std::cout << "  percentile     process (us)     jitter (us)" << std::endl;
+    for (double p : percentiles) {
+        std::cout << std::setw(12) << 100.0 * p
+            << std::setw(17) << 1e-3 * double(Percentile(processTimes, p))
+            << std::setw(16) << 1e-3 * double(Percentile(jitters, p)) << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    Settings settings = { 0, 10.0, false };
+    size_t loadThreads = 0;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--block") == 0 && i + 1 < argc) {
+            settings.blockLen = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            settings.seconds = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--fifo") == 0) {
+            settings.fifo = true;
+        } else if (std::strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+            loadThreads = std::strtoul(argv[++i], nullptr, 10);
+        } else {
+            std::cout << "Usage: benchDeadline [--block N] [--seconds S] [--fifo] [--load THREADS]" << std::endl;
+            return 1;
+        }
+    }
+
+    if (settings.fifo && mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        std::cout << "Warning: mlockall failed, memory is not locked." << std::endl;
+    }
+
+    std::atomic<bool> running(true);
+    std::vector<std::thread> load;
+    for (size_t i = 0; i < loadThreads; i++) {
+        load.emplace_back(Thrash, &running);
+    }
+
+    std::vector<size_t> blockLens;
+    if (settings.blockLen > 0) {
+        blockLens.push_back(settings.blockLen);
+    } else {
+        blockLens = { 32, 64, 128 };
+    }
+
+    std::ofstream csvFile("Deadline.csv", std::ofstream::trunc);
+    csvFile << "block,callback,jitter_ns,process_ns,missed\n";
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "SCHED_FIFO: " << (settings.fifo ? "yes" : "no")
+        << ", load threads: " << loadThreads << std::endl;
+    for (size_t blockLen : blockLens) {
+        std::vector<Callback> callbacks;
+        Settings run = settings;
+        run.blockLen = blockLen;
+
+        /* The periodic loop runs in its own thread so that its scheduling
+         * policy does not affect the load threads. */
+        std::thread periodic(RunPeriodic, std::cref(run), std::ref(callbacks));
+        periodic.join();
+        Report(blockLen, callbacks, csvFile);
+    }
+
+    running.store(false);
+    for (std::thread& thread : load) {
+        thread.join();
+    }
+    csvFile.close();
+    std::cout << "The program has generated the file Deadline.csv containing the per-callback measurements." << std::endl;
+
+    return 0;
+}
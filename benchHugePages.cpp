@@ -0,0 +1,195 @@
+/*******************************************************************************
+ *
+ * TLB benchmark of the huge-page pool in HugePages.hpp (Linux).
+ *
+ * The benchmark processes a bank of Limiter instances round-robin at a small
+ * block size twice: once with the instances and their delay buffers
+ * allocated on regular pages, and once with both carved from the huge-page
+ * pool. For each run, it reports the execution time per sample per instance
+ * and the data TLB misses per sample, measured with perf_event_open when
+ * the kernel permits it, together with the backing the pool obtained.
+ *
+ * Usage: benchHugePages [--instances N] [--block N]
+ *
+ * Explicit huge pages must be reserved beforehand, e.g., with
+ * echo 1100 > /proc/sys/vm/nr_hugepages for 2000 instances; otherwise the
+ * pool uses transparent huge pages if enabled for madvise.
+ *
+ * ****************************************************************************/
+
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "Generators.hpp"
+#include "Limiter.hpp"
+#include "HugePages.hpp"
+
+typedef double real;
+typedef Limiter<real> RegularLimiter;
+typedef Limiter<real, 8, 4, real, HugePageAllocator<real>> HugePageLimiter;
+
+static inline int64_t Now() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/* Counter of the data TLB read misses of the calling thread. Open fails
+ * when perf events are not available, in which case no misses are 
+ * reported. */
+class TLBMissCounter {
+    private:
+        int fd = -1;
+
+    public:
+        bool Open() {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            return fd >= 0;
+        };
+        void Start() {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        };
+        uint64_t Stop() {
+            uint64_t count = 0;
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+                if (read(fd, &count, sizeof(count)) != ssize_t(sizeof(count))) {
+                    count = 0;
+                }
+            }
+            return count;
+        };
+        ~TLBMissCounter() {
+            if (fd >= 0) {
+                close(fd);
+            }
+        };
+};
+
+template<typename limiter>
+static void Setup(limiter& l) {
+    l.SetSR(48000.0);
+    l.SetAttTime(.01);
+    l.SetHoldTime(.0);
+    l.SetRelTime(.05);
+    l.SetPreGain(12.0);
+    l.SetThreshold(-.3);
+    l.Reset();
+}
+
+/* Processes the bank round-robin, the first round not being measured as it
+ * touches the buffers for the first time. Returns the time in nanoseconds
+ * and the misses per sample. */
+template<typename pointer>
+static void Run(std::vector<pointer>& limiters, size_t blockLen, const std::vector<real>& noise,
+        TLBMissCounter& counter, double& nsPerSample, double& missesPerSample) {
+    std::vector<real> left(blockLen);
+    std::vector<real> right(blockLen);
+    real* xVec[2] = { left.data(), right.data() };
+    size_t numberOfInstances = limiters.size();
+    size_t rounds = std::max<size_t>(4, (size_t(1) << 23) / (numberOfInstances * blockLen)) + 1;
+    size_t noiseOffset = 0;
+    int64_t elapsed = 0;
+    for (size_t round = 0; round < rounds; round++) {
+        if (round == 1) {
+            counter.Start();
+            elapsed = Now();
+        }
+        for (size_t i = 0; i < numberOfInstances; i++) {
+            std::copy(noise.begin() + noiseOffset, noise.begin() + noiseOffset + blockLen, left.begin());
+            std::copy(noise.rbegin() + noiseOffset, noise.rbegin() + noiseOffset + blockLen, right.begin());
+            noiseOffset = noiseOffset + 2 * blockLen >= noise.size() ? 0 : noiseOffset + blockLen;
+            limiters[i]->Process(xVec, xVec, blockLen);
+        }
+    }
+    elapsed = Now() - elapsed;
+    uint64_t misses = counter.Stop();
+    double samples = double(rounds - 1) * double(numberOfInstances) * double(blockLen);
+    nsPerSample = double(elapsed) / samples;
+    missesPerSample = double(misses) / samples;
+}
+
+int main(int argc, char** argv) {
+    size_t numberOfInstances = 2000;
+    size_t blockLen = 64;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+            numberOfInstances = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--block") == 0 && i + 1 < argc) {
+            blockLen = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        } else {
+            std::cout << "Usage: benchHugePages [--instances N] [--block N]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<real> noise(48000);
+    Generators<real> generators;
+    generators.ProcessNoise(noise.data(), noise.size());
+    blockLen = std::min(blockLen, noise.size() / 2);
+
+    TLBMissCounter counter;
+    bool countMisses = counter.Open();
+    double nsPerSample[2];
+    double missesPerSample[2];
+
+    /* Regular pages. The bank is released before the huge-page run. */
+    {
+        std::vector<std::unique_ptr<RegularLimiter>> limiters;
+        for (size_t i = 0; i < numberOfInstances; i++) {
+            limiters.emplace_back(new RegularLimiter());
+            Setup(*limiters.back());
+        }
+        Run(limiters, blockLen, noise, counter, nsPerSample[0], missesPerSample[0]);
+    }
+
+    /* Huge pages for the instances and their delay buffers. */
+    std::vector<std::unique_ptr<HugePageLimiter, HugePageDeleter<HugePageLimiter>>> limiters;
+    for (size_t i = 0; i < numberOfInstances; i++) {
+        limiters.push_back(MakeHugePage<HugePageLimiter>());
+        Setup(*limiters.back());
+    }
+    Run(limiters, blockLen, noise, counter, nsPerSample[1], missesPerSample[1]);
+
+    const char* backings[3] = { "regular pages", "transparent huge pages", "explicit huge pages" };
+    HugePagePool& pool = HugePagePool::Instance();
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Instances: " << numberOfInstances << ", block size: " << blockLen << " samples" << std::endl;
+    std::cout << "Pool backing: " << backings[pool.GetBacking()] << ", mapped (MiB): "
+        << double(pool.GetMappedBytes()) / double(1 << 20) << std::endl;
+    std::cout << "                  ns/sample/inst   dTLB miss/sample" << std::endl;
+    const char* names[2] = { "regular pages ", "huge-page pool" };
+    for (size_t i = 0; i < 2; i++) {
+        std::cout << names[i] << std::setw(20) << nsPerSample[i];
+        if (countMisses) {
+            std::cout << std::setw(19) << missesPerSample[i];
+        } else {
+            std::cout << std::setw(19) << "n/a";
+        }
+        std::cout << std::endl;
+    }
+
+    return 0;
+}
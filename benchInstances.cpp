@@ -0,0 +1,239 @@
+/*******************************************************************************
+ *
+ * Instance scaling benchmark for the Limiter class (Linux).
+ *
+ * The test programs measure one instance processing repeatedly with hot
+ * caches, whereas a session runs hundreds of limiters, each of which finds
+ * its state evicted by the others. The benchmark creates from 1 to 10000
+ * Limiter instances and processes them round-robin at a small block size,
+ * reporting for each instance count the execution time per sample per
+ * instance, the resident memory of the instances, and the last-level cache
+ * misses per sample, measured with perf_event_open when the kernel permits
+ * it.
+ *
+ * Usage: benchInstances [--block N] [--max INSTANCES] [--max-attack SECONDS]
+ *
+ * --max-attack sizes the delay buffers with SetMaxAttTime, which shows the
+ * effect of the default 65536-sample buffers on the scaling. Instance
+ * counts whose buffers would not fit in half of the physical memory are
+ * skipped. The results are written to Instances.csv.
+ *
+ * ****************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <time.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "Generators.hpp"
+#include "Limiter.hpp"
+
+typedef double real;
+
+static inline int64_t Now() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/* Resident set size of the process in bytes. */
+static size_t ResidentMemory() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0;
+    size_t resident = 0;
+    statm >> pages >> resident;
+    return resident * size_t(sysconf(_SC_PAGESIZE));
+}
+
+/* Counter of the last-level cache misses of the calling thread. Open fails
+ * when perf events are not available, e.g., in containers or with a high
+ * perf_event_paranoid setting, in which case no misses are reported. */
+class CacheMissCounter {
+    private:
+        int fd = -1;
+
+    public:
+        bool Open() {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            return fd >= 0;
+        };
+        void Start() {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        };
+        uint64_t Stop() {
+            uint64_t count = 0;
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+                if (read(fd, &count, sizeof(count)) != ssize_t(sizeof(count))) {
+                    count = 0;
+                }
+            }
+            return count;
+        };
+        ~CacheMissCounter() {
+            if (fd >= 0) {
+                close(fd);
+            }
+        };
+};
+
+struct Measurement {
+    size_t instances;
+    double nsPerSample; // Per sample of each instance.
+    double bytesPerInstance;
+    double missesPerSample;
+};
+
+static Measurement Run(size_t numberOfInstances, size_t blockLen, real maxAttack,
+        const std::vector<real>& noise, CacheMissCounter& counter, bool countMisses) {
+    const real SR = 48000.0;
+
+    /* Memory freed by the previous run is returned to the system first, as
+     * reusing it would hide part of the footprint of the new instances. */
+    malloc_trim(0);
+    size_t memoryBefore = ResidentMemory();
+    std::vector<std::unique_ptr<Limiter<real>>> limiters;
+    for (size_t i = 0; i < numberOfInstances; i++) {
+        limiters.emplace_back(new Limiter<real>());
+        Limiter<real>& limiter = *limiters.back();
+        limiter.SetSR(SR);
+        if (maxAttack > .0) {
+            limiter.SetMaxAttTime(maxAttack);
+        }
+        limiter.SetAttTime(.01);
+        limiter.SetHoldTime(.0);
+        limiter.SetRelTime(.05);
+        limiter.SetPreGain(12.0);
+        limiter.SetThreshold(-.3);
+        limiter.Reset();
+    }
+
+    std::vector<real> left(blockLen);
+    std::vector<real> right(blockLen);
+    real* xVec[2] = { left.data(), right.data() };
+
+    /* Each instance gets its own excerpt of the noise, so that the
+     * instances do not process identical signals. The first round is not
+     * measured as it touches the buffers for the first time. */
+    size_t totalSamples = size_t(1) << 23;
+    size_t rounds = std::max<size_t>(4, totalSamples / (numberOfInstances * blockLen)) + 1;
+    int64_t elapsed = 0;
+    uint64_t misses = 0;
+    size_t noiseOffset = 0;
+    for (size_t round = 0; round < rounds; round++) {
+        if (round == 1) {
+            counter.Start();
+            elapsed = Now();
+        }
+        for (size_t i = 0; i < numberOfInstances; i++) {
+            std::copy(noise.begin() + noiseOffset, noise.begin() + noiseOffset + blockLen, left.begin());
+            std::copy(noise.rbegin() + noiseOffset, noise.rbegin() + noiseOffset + blockLen, right.begin());
+            noiseOffset = noiseOffset + 2 * blockLen >= noise.size() ? 0 : noiseOffset + blockLen;
+            limiters[i]->Process(xVec, xVec, blockLen);
+        }
+    }
+    elapsed = Now() - elapsed;
+    misses = counter.Stop();
+    size_t memoryAfter = ResidentMemory();
+
+    double samples = double(rounds - 1) * double(numberOfInstances) * double(blockLen);
+    Measurement measurement;
+    measurement.instances = numberOfInstances;
+    measurement.nsPerSample = double(elapsed) / samples;
+    measurement.bytesPerInstance = memoryAfter > memoryBefore ?
+        double(memoryAfter - memoryBefore) / double(numberOfInstances) : .0;
+    measurement.missesPerSample = countMisses ? double(misses) / samples : -1.0;
+    return measurement;
+}
+
+int main(int argc, char** argv) {
+    size_t blockLen = 64;
+    size_t maxInstances = 10000;
+    real maxAttack = .0;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--block") == 0 && i + 1 < argc) {
+            blockLen = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--max") == 0 && i + 1 < argc) {
+            maxInstances = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--max-attack") == 0 && i + 1 < argc) {
+            maxAttack = std::atof(argv[++i]);
+        } else {
+            std::cout << "Usage: benchInstances [--block N] [--max INSTANCES] [--max-attack SECONDS]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<real> noise(48000);
+    Generators<real> generators;
+    generators.ProcessNoise(noise.data(), noise.size());
+    blockLen = std::min(blockLen, noise.size() / 2);
+
+    CacheMissCounter counter;
+    bool countMisses = counter.Open();
+
+    /* The footprint of one instance is estimated on a single instance and
+     * used to skip the counts that would exhaust the memory. */
+    Measurement single = Run(1, blockLen, maxAttack, noise, counter, countMisses);
+    double availableMemory = .5 * double(sysconf(_SC_PHYS_PAGES)) * double(sysconf(_SC_PAGESIZE));
+    double footprint = std::max<double>(single.bytesPerInstance, double(sizeof(Limiter<real>)));
+
+    std::ofstream csvFile("Instances.csv", std::ofstream::trunc);
+    csvFile << "instances,ns_per_sample,bytes_per_instance,llc_misses_per_sample\n";
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Block size: " << blockLen << " samples, LLC misses: "
+        << (countMisses ? "perf_event" : "not available") << std::endl;
+    std::cout << "Size of the Limiter object (byte): " << sizeof(Limiter<real>) << std::endl;
+    std::cout << "   instances   ns/sample/inst   KiB/instance    total MiB   LLC miss/sample" << std::endl;
+
+    const size_t counts[] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000 };
+    for (size_t numberOfInstances : counts) {
+        if (numberOfInstances > maxInstances) {
+            break;
+        }
+        if (footprint * double(numberOfInstances) > availableMemory) {
+            std::cout << std::setw(12) << numberOfInstances << "   skipped, about "
+                << footprint * double(numberOfInstances) / double(1 << 20)
+                << " MiB exceed half of the physical memory" << std::endl;
+            continue;
+        }
+        Measurement m = Run(numberOfInstances, blockLen, maxAttack, noise, counter, countMisses);
+        csvFile << m.instances << "," << m.nsPerSample << "," << m.bytesPerInstance << ","
+            << m.missesPerSample << "\n";
+        std::cout << std::setw(12) << m.instances
+            << std::setw(17) << m.nsPerSample
+            << std::setw(15) << m.bytesPerInstance / 1024.0
+            << std::setw(13) << m.bytesPerInstance * double(m.instances) / double(1 << 20);
+        if (countMisses) {
+            std::cout << std::setw(18) << m.missesPerSample;
+        } else {
+            std::cout << std::setw(18) << "n/a";
+        }
+        std::cout << std::endl;
+    }
+
+    csvFile.close();
+    std::cout << "The program has generated the file Instances.csv containing the measurements." << std::endl;
+
+    return 0;
+}
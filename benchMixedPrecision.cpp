@@ -0,0 +1,152 @@
+/*******************************************************************************
+ *
+ * Precision benchmark of the Limiter class: float, double, and mixed
+ * precision, i.e., LimiterMixedPrecision with a double-precision detection
+ * and a float audio path and delay line.
+ *
+ * The benchmark limits amplitude-modulated noise with a long release time,
+ * where the coefficients of the smoothers approach 1, and reports for each
+ * build the execution time per sample and the peak and RMS difference from
+ * the double-precision output in dB relative to full scale.
+ *
+ * Usage: benchMixedPrecision [--block N] [--seconds S] [--release S] [--sr SR]
+ *
+ * ****************************************************************************/
+
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <time.h>
+#include "Generators.hpp"
+#include "Limiter.hpp"
+
+static inline int64_t Now() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/* Processes the planar input in blocks with the given limiter, three times,
+ * and returns the best time in nanoseconds per sample; the output of the
+ * last run is stored in output. */
+template<typename limiter, typename audioReal>
+static double Run(limiter& l, const std::vector<double> input[2], std::vector<double> output[2],
+        size_t blockLen, double SR, double release) {
+    size_t len = input[0].size();
+    std::vector<audioReal> buffers[2];
+    double best = 1e300;
+    for (size_t run = 0; run < 3; run++) {
+        l.SetSR(SR);
+        l.SetAttTime(.005);
+        l.SetHoldTime(.002);
+        l.SetRelTime(release);
+        l.SetPreGain(12.0);
+        l.SetThreshold(-1.0);
+        l.Reset();
+        for (size_t c = 0; c < 2; c++) {
+            buffers[c].assign(input[c].begin(), input[c].end());
+        }
+        int64_t elapsed = Now();
+        for (size_t offset = 0; offset < len; offset += blockLen) {
+            size_t vecLen = std::min(blockLen, len - offset);
+            audioReal* xVec[2] = { buffers[0].data() + offset, buffers[1].data() + offset };
+            l.Process(xVec, xVec, vecLen);
+        }
+        elapsed = Now() - elapsed;
+        best = std::min(best, double(elapsed) / double(len));
+    }
+    for (size_t c = 0; c < 2; c++) {
+        output[c].assign(buffers[c].begin(), buffers[c].end());
+    }
+    return best;
+}
+
+/* Peak and RMS difference in dB. */
+static void Difference(const std::vector<double> x[2], const std::vector<double> reference[2],
+        double& peakdB, double& rmsdB) {
+    double peak = 1e-300;
+    double sum = .0;
+    for (size_t c = 0; c < 2; c++) {
+        for (size_t n = 0; n < x[c].size(); n++) {
+            double error = std::fabs(x[c][n] - reference[c][n]);
+            peak = std::max(peak, error);
+            sum += error * error;
+        }
+    }
+    peakdB = 20.0 * std::log10(peak);
+    rmsdB = 10.0 * std::log10(std::max(1e-300, sum / double(2 * x[0].size())));
+}
+
+int main(int argc, char** argv) {
+    size_t blockLen = 256;
+    double seconds = 20.0;
+    double release = 2.0;
+    double SR = 48000.0;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--block") == 0 && i + 1 < argc) {
+            blockLen = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = std::max(.1, std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--release") == 0 && i + 1 < argc) {
+            release = std::max(.001, std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--sr") == 0 && i + 1 < argc) {
+            SR = std::max(1000.0, std::atof(argv[++i]));
+        } else {
+            std::cout << "Usage: benchMixedPrecision [--block N] [--seconds S] [--release S] [--sr SR]" << std::endl;
+            return 1;
+        }
+    }
+
+    /* Noise modulated by a slow sine, so that the limiter keeps attacking
+     * and releasing. The samples are representable in float, hence every
+     * build gets the same input. */
+    size_t len = size_t(seconds * SR);
+    std::vector<double> input[2];
+    Generators<double> generators;
+    for (size_t c = 0; c < 2; c++) {
+        input[c].resize(len);
+        generators.ProcessNoise(input[c].data(), len);
+        for (size_t n = 0; n < len; n++) {
+            double modulation = .55 + .45 * std::sin(2.0 * M_PI * .25 * double(n) / SR);
+            input[c][n] = double(float(input[c][n] * modulation));
+        }
+    }
+
+    std::vector<double> output[3][2];
+    double nsPerSample[3];
+    {
+        Limiter<double> l;
+        nsPerSample[0] = Run<Limiter<double>, double>(l, input, output[0], blockLen, SR, release);
+    }
+    {
+        Limiter<float> l;
+        nsPerSample[1] = Run<Limiter<float>, float>(l, input, output[1], blockLen, SR, release);
+    }
+    {
+        LimiterMixedPrecision<> l;
+        nsPerSample[2] = Run<LimiterMixedPrecision<>, float>(l, input, output[2], blockLen, SR, release);
+    }
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Samplerate: " << SR << " Hz, release: " << release << " s, block size: "
+        << blockLen << " samples" << std::endl;
+    std::cout << "                 ns/sample   peak diff (dB)   RMS diff (dB)" << std::endl;
+    const char* names[3] = { "double         ", "float          ", "mixed precision" };
+    for (size_t i = 0; i < 3; i++) {
+        std::cout << names[i] << std::setw(12) << nsPerSample[i];
+        if (i == 0) {
+            std::cout << std::setw(17) << "reference" << std::setw(16) << "reference" << std::endl;
+            continue;
+        }
+        double peakdB;
+        double rmsdB;
+        Difference(output[i], output[0], peakdB, rmsdB);
+        std::cout << std::setw(17) << peakdB << std::setw(16) << rmsdB << std::endl;
+    }
+
+    return 0;
+}
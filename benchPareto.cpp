@@ -0,0 +1,364 @@
+/*******************************************************************************
+ *
+ * Quality-versus-cost sweep of the limiter configuration space.
+ *
+ * The program sweeps the number of peak-hold and smoothing sections, as well
+ * as the attack, hold, and release times. For each configuration, it measures
+ * the THD+N on a limited sine tone with an FFT-based analyser, the peak
+ * overshoot above the threshold on both the sine and a programme-like signal,
+ * and the processing cost in cycles per sample. All points are written to
+ * Pareto.csv, and the Pareto frontier, i.e., the configurations that are not
+ * beaten on all three measures by any other configuration, is printed.
+ *
+ * Usage: benchPareto [sine frequency in Hz] [max THD+N dB] [max overshoot dB]
+ *
+ * When the last two arguments are given, the program also prints the
+ * cheapest configuration that meets both specifications.
+ *
+ * ****************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+#include <chrono>
+#include <complex>
+#include <vector>
+#include <memory>
+#include <string>
+#include <limits>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "Generators.hpp"
+#include "Limiter.hpp"
+
+typedef double real;
+
+/* Time-stamp counter read for cost measurements. Where no cycle counter is
+ * available, we fall back to nanoseconds, which are reported in the same
+ * column. */
+static inline uint64_t ReadCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(
+        steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/* Minimal THD+N analyser: the signal is windowed with a four-term
+ * Blackman-Harris window, transformed with an in-place radix-2 FFT, and
+ * the power in the bins surrounding the fundamental is compared to the
+ * power in all the remaining bins, DC excluded. */
+class Analyser {
+    private:
+        size_t fftLen;
+        std::vector<real> window;
+        std::vector<std::complex<real>> bins;
+
+        void FFT() {
+            const size_t N = fftLen;
+            for (size_t i = 1, j = 0; i < N; i++) {
+                size_t bit = N >> 1;
+                for (; j & bit; bit >>= 1) {
+                    j ^= bit;
+                }
+                j ^= bit;
+                if (i < j) {
+                    std::swap(bins[i], bins[j]);
+                }
+            }
+            for (size_t len = 2; len <= N; len <<= 1) {
+                real angle = -2.0 * M_PI / real(len);
+                std::complex<real> wLen(std::cos(angle), std::sin(angle));
+                for (size_t i = 0; i < N; i += len) {
+                    std::complex<real> w(1.0, .0);
+                    for (size_t k = 0; k < len / 2; k++) {
+                        std::complex<real> u = bins[i + k];
+                        std::complex<real> v = bins[i + k + len / 2] * w;
+                        bins[i + k] = u + v;
+                        bins[i + k + len / 2] = u - v;
+                        w *= wLen;
+                    }
+                }
+            }
+        }
+
+    public:
+        Analyser(size_t _fftLen) : fftLen(_fftLen), window(_fftLen), bins(_fftLen) {
+            const real a0 = .35875, a1 = .48829, a2 = .14128, a3 = .01168;
+            for (size_t n = 0; n < fftLen; n++) {
+                real phase = 2.0 * M_PI * real(n) / real(fftLen);
+                window[n] = a0 - a1 * std::cos(phase) + a2 * std::cos(2.0 * phase) -
+                    a3 * std::cos(3.0 * phase);
+            }
+        }
+
+        /* Returns THD+N in dB relative to the fundamental. */
+        real THDN(const real* x, real fundamental, real SR) {
+            for (size_t n = 0; n < fftLen; n++) {
+                bins[n] = std::complex<real>(x[n] * window[n], .0);
+            }
+            FFT();
+            const size_t halfLen = fftLen / 2;
+            const size_t guard = 6; // Main-lobe half-width of the window in bins.
+            size_t fundBin = size_t(std::rint(fundamental * real(fftLen) / SR));
+            real fundPower = .0;
+            real residualPower = .0;
+            for (size_t k = guard; k < halfLen; k++) {
+                real power = std::norm(bins[k]);
+                bool isFundamental = k + guard >= fundBin && k <= fundBin + guard;
+                if (isFundamental) {
+                    fundPower += power;
+                } else {
+                    residualPower += power;
+                }
+            }
+            return 10.0 * std::log10(std::max<real>(1e-30, residualPower) /
+                std::max<real>(1e-30, fundPower));
+        }
+};
+
+struct Point {
+    size_t peakHoldSections;
+    size_t smoothSections;
+    real attack;
+    real hold;
+    real release;
+    real thdn; // dB.
+    real overshoot; // dB above threshold.
+    real cycles; // Per stereo sample frame.
+    bool frontier;
+};
+
+/* Shared measurement settings. */
+const real SR = 48000.0;
+const real threshold = -.3;
+const real preGain = 12.0;
+const size_t blockLen = 256;
+const size_t settleLen = 48000;
+const size_t fftLen = 16384;
+const size_t programmeLen = 96000;
+const size_t costRuns = 5;
+
+/* Programme-like test signal: a low-frequency tone plus noise whose level
+ * jumps every 250 ms, which produces sharp transients for the overshoot
+ * measurement. */
+static void MakeProgramme(std::vector<real>& left, std::vector<real>& right) {
+    Generators<real> tone;
+    Generators<real> noise;
+    tone.SetSR(SR);
+    tone.SetFreq(80.0);
+    left.resize(programmeLen);
+    right.resize(programmeLen);
+    tone.ProcessSine(left.data(), programmeLen);
+    noise.ProcessNoise(right.data(), programmeLen);
+    const real levels[4] = { .05, 1.0, .2, .7 };
+    const size_t segment = size_t(.25 * SR);
+    for (size_t n = 0; n < programmeLen; n++) {
+        real level = levels[(n / segment) % 4];
+        real noiseSample = right[n];
+        right[n] = level * (.5 * left[n] + noiseSample);
+        left[n] = level * (.5 * left[n] - noiseSample);
+    }
+}
+
+template<size_t peakHoldSections, size_t smoothSections>
+static std::unique_ptr<Limiter<real, peakHoldSections, smoothSections>>
+MakeLimiter(real attack, real hold, real release) {
+    std::unique_ptr<Limiter<real, peakHoldSections, smoothSections>> limiter(
+        new Limiter<real, peakHoldSections, smoothSections>());
+    limiter->SetSR(SR);
+    limiter->SetAttTime(attack);
+    limiter->SetHoldTime(hold);
+    limiter->SetRelTime(release);
+    limiter->SetPreGain(preGain);
+    limiter->SetThreshold(threshold);
+    limiter->Reset();
+
+    /* Run the limiter on silence until the parameter smoothers and the
+     * initial delay crossfade have settled, so that the measurements are
+     * not dominated by the cold-start transient. */
+    real zeros[2][blockLen] = { { .0 } };
+    real* xVec[2] = { zeros[0], zeros[1] };
+    real yBlock[2][blockLen];
+    real* yVec[2] = { yBlock[0], yBlock[1] };
+    for (size_t n = 0; n < settleLen; n += blockLen) {
+        limiter->Process(xVec, yVec, blockLen);
+    }
+    return limiter;
+}
+
+/* Process a stereo signal block-wise straight into the output vectors. */
+template<typename limiterType>
+static void Render(limiterType& limiter, const real* left, const real* right,
+        size_t len, std::vector<real>& yLeft, std::vector<real>& yRight) {
+    yLeft.resize(len);
+    yRight.resize(len);
+    for (size_t offset = 0; offset < len; offset += blockLen) {
+        size_t n = std::min(blockLen, len - offset);
+        const real* xVec[2] = { left + offset, right + offset };
+        real* yVec[2] = { yLeft.data() + offset, yRight.data() + offset };
+        limiter.Process(xVec, yVec, n);
+    }
+}
+
+static real PeakOvershoot(const std::vector<real>& left,
+        const std::vector<real>& right) {
+    real peak = .0;
+    for (size_t n = 0; n < left.size(); n++) {
+        peak = std::max<real>(peak, std::max(std::fabs(left[n]), std::fabs(right[n])));
+    }
+    return std::max<real>(.0, 20.0 * std::log10(peak) - threshold);
+}
+
+template<size_t peakHoldSections, size_t smoothSections>
+static void Sweep(std::vector<Point>& points, real sineFreq,
+        const std::vector<real>& progLeft, const std::vector<real>& progRight) {
+    const real attacks[] = { .001, .005, .01, .02 };
+    const real holds[] = { .0, .005, .02 };
+    const real releases[] = { .02, .05, .1, .2 };
+    Analyser analyser(fftLen);
+    Generators<real> generator;
+    generator.SetSR(SR);
+    generator.SetFreq(sineFreq);
+    std::vector<real> sine(settleLen + fftLen);
+    generator.ProcessSine(sine.data(), sine.size());
+    std::vector<real> yLeft;
+    std::vector<real> yRight;
+
+    for (real attack : attacks) {
+        for (real hold : holds) {
+            for (real release : releases) {
+                Point point = { peakHoldSections, smoothSections,
+                    attack, hold, release, .0, .0, .0, false };
+
+                /* THD+N and overshoot on the sine tone after settling. */
+                auto limiter = MakeLimiter<peakHoldSections, smoothSections>(
+                    attack, hold, release);
+                Render(*limiter, sine.data(), sine.data(), sine.size(), yLeft, yRight);
+                point.thdn = analyser.THDN(yLeft.data() + settleLen, sineFreq, SR);
+                point.overshoot = PeakOvershoot(yLeft, yRight);
+
+                /* Overshoot and cost on the programme signal. We keep the
+                 * fastest run to filter out interference from the system. */
+                real bestCycles = std::numeric_limits<real>::max();
+                for (size_t run = 0; run < costRuns; run++) {
+                    limiter = MakeLimiter<peakHoldSections, smoothSections>(
+                        attack, hold, release);
+                    uint64_t t0 = ReadCycles();
+                    Render(*limiter, progLeft.data(), progRight.data(),
+                        programmeLen, yLeft, yRight);
+                    uint64_t t1 = ReadCycles();
+                    bestCycles = std::min<real>(bestCycles,
+                        real(t1 - t0) / real(programmeLen));
+                    if (run == 0) {
+                        point.overshoot = std::max(point.overshoot,
+                            PeakOvershoot(yLeft, yRight));
+                    }
+                }
+                point.cycles = bestCycles;
+                points.push_back(point);
+            }
+        }
+    }
+}
+
+/* A point belongs to the frontier if no other point is at least as good on
+ * all measures and strictly better on one. */
+static void MarkFrontier(std::vector<Point>& points) {
+    for (Point& p : points) {
+        p.frontier = true;
+        for (const Point& q : points) {
+            bool noWorse = q.thdn <= p.thdn && q.overshoot <= p.overshoot &&
+                q.cycles <= p.cycles;
+            bool better = q.thdn < p.thdn || q.overshoot < p.overshoot ||
+                q.cycles < p.cycles;
+            if (noWorse && better) {
+                p.frontier = false;
+                break;
+            }
+        }
+    }
+}
+
+static void PrintPoint(const Point& p) {
+    std::cout << std::setw(4) << p.peakHoldSections << std::setw(4) << p.smoothSections
+        << std::setw(9) << p.attack << std::setw(9) << p.hold
+        << std::setw(9) << p.release << std::setw(10) << p.thdn
+        << std::setw(10) << p.overshoot << std::setw(10) << p.cycles << "\n";
+}
+
+int main(int argc, char** argv) {
+    real sineFreq = argc > 1 ? std::atof(argv[1]) : 100.0;
+    bool hasSpec = argc > 3;
+    real maxTHDN = hasSpec ? std::atof(argv[2]) : .0;
+    real maxOvershoot = hasSpec ? std::atof(argv[3]) : .0;
+
+    std::vector<real> progLeft;
+    std::vector<real> progRight;
+    MakeProgramme(progLeft, progRight);
+
+    /* The numbers of sections are template parameters, hence the sweep
+     * instantiates each combination explicitly. */
+    std::vector<Point> points;
+    Sweep<2, 2>(points, sineFreq, progLeft, progRight);
+    Sweep<4, 2>(points, sineFreq, progLeft, progRight);
+    Sweep<4, 4>(points, sineFreq, progLeft, progRight);
+    Sweep<8, 2>(points, sineFreq, progLeft, progRight);
+    Sweep<8, 4>(points, sineFreq, progLeft, progRight);
+    Sweep<8, 8>(points, sineFreq, progLeft, progRight);
+    Sweep<16, 4>(points, sineFreq, progLeft, progRight);
+    MarkFrontier(points);
+
+    std::ofstream csvFile("Pareto.csv", std::ofstream::trunc);
+    csvFile << std::fixed << std::setprecision(6);
+    csvFile << "peakHoldSections,smoothSections,attack,hold,release,thdn_dB,overshoot_dB,cycles_per_sample,frontier\n";
+    for (const Point& p : points) {
+        csvFile << p.peakHoldSections << "," << p.smoothSections << "," << p.attack
+            << "," << p.hold << "," << p.release << "," << p.thdn << ","
+            << p.overshoot << "," << p.cycles << "," << p.frontier << "\n";
+    }
+    csvFile.close();
+
+    std::vector<Point> frontier;
+    for (const Point& p : points) {
+        if (p.frontier) {
+            frontier.push_back(p);
+        }
+    }
+    std::sort(frontier.begin(), frontier.end(),
+        [](const Point& a, const Point& b) { return a.cycles < b.cycles; });
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Sine frequency (Hz): " << sineFreq << std::endl;
+    std::cout << "Measured configurations: " << points.size() << std::endl;
+    std::cout << "Pareto frontier (" << frontier.size() << " points):" << std::endl;
+    std::cout << "  PH  ES   attack     hold  release  THD+N dB  over dB   cyc/smp\n";
+    for (const Point& p : frontier) {
+        PrintPoint(p);
+    }
+
+    if (hasSpec) {
+        std::cout << "Cheapest configuration with THD+N <= " << maxTHDN
+            << " dB and overshoot <= " << maxOvershoot << " dB:" << std::endl;
+        bool found = false;
+        for (const Point& p : frontier) {
+            if (p.thdn <= maxTHDN && p.overshoot <= maxOvershoot) {
+                PrintPoint(p);
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            std::cout << "  none." << std::endl;
+        }
+    }
+    std::cout << "The program has generated the file Pareto.csv containing all measured configurations." << std::endl;
+
+    return 0;
+}
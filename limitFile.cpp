@@ -0,0 +1,179 @@
+/*******************************************************************************
+ *
+ * Offline limiter for raw interleaved stereo files of native-endian float
+ * (default) or double samples, based on the asynchronous file pipeline.
+ *
+ * Usage: limitFile INPUT OUTPUT [--f64] [--sr Hz] [--pregain dB]
+ *            [--threshold dB] [--attack s] [--hold s] [--release s]
+ *            [--block frames] [--blocks n] [--no-compensation]
+ *        limitFile --batch LIST [--uring] [--inflight n] [options]
+ *
+ * INPUT and OUTPUT can be "-" for the standard input and output.
+ *
+ * In batch mode, LIST is a text file with one "INPUT OUTPUT" pair of paths
+ * per line, which are processed by the batch renderer, optionally with the
+ * io_uring backend and the given number of files in flight.
+ *
+ * ****************************************************************************/
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include "LimiterFilePipeline.hpp"
+#include "LimiterBatch.hpp"
+
+struct Options {
+    bool f64 = false;
+    double SR = 48000.0;
+    double preGain = .0;
+    double threshold = -.3;
+    double attack = .01;
+    double hold = .0;
+    double release = .05;
+    size_t blockFrames = 16384;
+    size_t numberOfBlocks = 8;
+    bool compensateLatency = true;
+    bool uring = false;
+    size_t filesInFlight = 16;
+};
+
+template<typename real>
+static FilePipelineReport Run(const Options& options, int inputFd, int outputFd) {
+    LimiterFilePipeline<real> pipeline;
+    Limiter<real>& limiter = pipeline.GetLimiter();
+    limiter.SetSR(options.SR);
+    limiter.SetAttTime(options.attack);
+    limiter.SetHoldTime(options.hold);
+    limiter.SetRelTime(options.release);
+    limiter.SetPreGain(options.preGain);
+    limiter.SetThreshold(options.threshold);
+    limiter.Reset();
+    pipeline.SetBlockFrames(options.blockFrames);
+    pipeline.SetNumberOfBlocks(options.numberOfBlocks);
+    pipeline.SetCompensateLatency(options.compensateLatency);
+    return pipeline.Run(inputFd, outputFd);
+}
+
+template<typename real>
+static BatchReport RunBatch(const Options& options, const std::vector<BatchJob>& jobs) {
+    LimiterBatch<real> batch;
+    batch.SetSR(options.SR);
+    batch.SetAttTime(options.attack);
+    batch.SetHoldTime(options.hold);
+    batch.SetRelTime(options.release);
+    batch.SetPreGain(options.preGain);
+    batch.SetThreshold(options.threshold);
+    batch.SetFilesInFlight(options.filesInFlight);
+    batch.SetCompensateLatency(options.compensateLatency);
+    batch.SetBlockFrames(options.blockFrames);
+    return options.uring ? batch.RunUring(jobs) : batch.RunPlain(jobs);
+}
+
+static int Batch(const Options& options, const char* listPath) {
+    std::ifstream list(listPath);
+    std::vector<BatchJob> jobs;
+    BatchJob job;
+    while (list >> job.inputPath >> job.outputPath) {
+        jobs.push_back(job);
+    }
+    if (jobs.empty()) {
+        std::cerr << "Cannot read the list of files." << std::endl;
+        return 1;
+    }
+    BatchReport report = options.f64 ?
+        RunBatch<double>(options, jobs) : RunBatch<float>(options, jobs);
+    std::cerr << std::fixed << std::setprecision(3);
+    std::cerr << "Backend: " << report.backend << ", files: " << report.files
+        << ", failures: " << report.failures << ", frames: " << report.frames
+        << ", time (s): " << report.seconds << ", files/s: "
+        << double(report.files) / report.seconds << std::endl;
+    return report.failures == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: limitFile INPUT OUTPUT [--f64] [--sr Hz] [--pregain dB] [--threshold dB]\n"
+            "           [--attack s] [--hold s] [--release s] [--block frames] [--blocks n]\n"
+            "           [--no-compensation]\n"
+            "       limitFile --batch LIST [--uring] [--inflight n] [options]" << std::endl;
+        return 1;
+    }
+    Options options;
+    for (int i = 3; i < argc; i++) {
+        std::string option = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (option == "--f64") {
+            options.f64 = true;
+        } else if (option == "--no-compensation") {
+            options.compensateLatency = false;
+        } else if (option == "--sr" && hasValue) {
+            options.SR = std::atof(argv[++i]);
+        } else if (option == "--pregain" && hasValue) {
+            options.preGain = std::atof(argv[++i]);
+        } else if (option == "--threshold" && hasValue) {
+            options.threshold = std::atof(argv[++i]);
+        } else if (option == "--attack" && hasValue) {
+            options.attack = std::atof(argv[++i]);
+        } else if (option == "--hold" && hasValue) {
+            options.hold = std::atof(argv[++i]);
+        } else if (option == "--release" && hasValue) {
+            options.release = std::atof(argv[++i]);
+        } else if (option == "--block" && hasValue) {
+            options.blockFrames = std::strtoul(argv[++i], nullptr, 10);
+        } else if (option == "--blocks" && hasValue) {
+            options.numberOfBlocks = std::strtoul(argv[++i], nullptr, 10);
+        } else if (option == "--uring") {
+            options.uring = true;
+        } else if (option == "--inflight" && hasValue) {
+            options.filesInFlight = std::strtoul(argv[++i], nullptr, 10);
+        } else {
+            std::cerr << "Unknown option: " << option << std::endl;
+            return 1;
+        }
+    }
+
+    if (std::strcmp(argv[1], "--batch") == 0) {
+        return Batch(options, argv[2]);
+    }
+
+    int inputFd = std::strcmp(argv[1], "-") == 0 ? STDIN_FILENO : open(argv[1], O_RDONLY);
+    int outputFd = std::strcmp(argv[2], "-") == 0 ? STDOUT_FILENO :
+        open(argv[2], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (inputFd < 0 || outputFd < 0) {
+        std::cerr << "Cannot open the input or output file." << std::endl;
+        return 1;
+    }
+
+    FilePipelineReport report = options.f64 ?
+        Run<double>(options, inputFd, outputFd) : Run<float>(options, inputFd, outputFd);
+    close(inputFd);
+    close(outputFd);
+
+    /* The report goes to the standard error so that the output can be
+     * piped. */
+    const char* names[3] = { "reader", "processor", "writer" };
+    std::cerr << std::fixed << std::setprecision(3);
+    std::cerr << "Frames: " << report.frames << ", time (s): " << report.seconds
+        << ", throughput (Mframes/s): " << 1e-6 * double(report.frames) / report.seconds << std::endl;
+    for (size_t i = 0; i < 3; i++) {
+        std::cerr << "  " << std::setw(9) << names[i] << ": busy " << report.busy[i]
+            << " s (" << 100.0 * report.busy[i] / report.seconds << "%), waiting "
+            << report.stall[i] << " s" << std::endl;
+    }
+    std::cerr << "Bottleneck: " << report.bottleneck << std::endl;
+    if (report.truncatedBytes > 0) {
+        std::cerr << "The input ends with an incomplete frame of " << report.truncatedBytes
+            << " bytes, which was dropped." << std::endl;
+    }
+    if (report.error) {
+        std::cerr << "An I/O error occurred." << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,236 @@
+/*******************************************************************************
+ *
+ * Streaming limiter for shell pipelines (Linux), e.g., between ffmpeg or sox
+ * processes. It reads raw interleaved stereo PCM from the standard input and
+ * writes the same format to the standard output.
+ *
+ * Usage: limitPipe [--format s16|s24|s32|f32|f64] [--f64] [--sr Hz]
+ *            [--pregain dB] [--threshold dB] [--attack s] [--hold s]
+ *            [--release s] [--block frames] [--no-compensation]
+ *            [--no-dither] [--no-splice]
+ *
+ * Integer formats are little-endian and signed, s24 being packed in three
+ * bytes; float formats are native-endian. The limiter runs in single
+ * precision unless --f64 is given. Integer outputs are quantised with TPDF
+ * dither unless --no-dither is given. For example:
+ *
+ *   ffmpeg -i in.wav -f s24le -ac 2 - | limitPipe --format s24 --sr 44100 |
+ *       ffmpeg -f s24le -ar 44100 -ac 2 -i - out.wav
+ *
+ * The input is read into a page-aligned buffer, and the limiter reads it
+ * and writes the output buffer in the input format directly, see Pcm.hpp,
+ * so conversion, limiting, and quantisation take a single pass. Reading 
+ * uses read(), as the samples must be in user memory for the processing 
+ * anyway, so splicing the input would only add a copy. When the standard
+ * output is a pipe, full output buffers are handed over to the pipe with
+ * vmsplice() instead of being copied by write(), see PipeOutput.hpp. A 
+ * reader that splices the data on, rather than reading it, keeps the pages
+ * referenced, in which case --no-splice must be given.
+ *
+ * By default, the look-ahead delay is compensated for: the first latency
+ * frames of the output are dropped and the look-ahead tail is flushed at the
+ * end of the input with as many zeros, so that the output is aligned with
+ * the input and has the same length.
+ *
+ * ****************************************************************************/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <iostream>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <algorithm>
+#include <poll.h>
+#include <unistd.h>
+#include "Limiter.hpp"
+#include "PipeOutput.hpp"
+
+enum Format { s16, s24, s32, f32, f64 };
+
+struct Options {
+    Format format = f32;
+    bool f64Processing = false;
+    double SR = 48000.0;
+    double preGain = .0;
+    double threshold = -.3;
+    double attack = .01;
+    double hold = .0;
+    double release = .05;
+    size_t blockFrames = 16384;
+    bool compensateLatency = true;
+    bool dither = true;
+    bool splice = true;
+};
+
+/* Fills the output buffers directly from the input buffer through the 
+ * PCM overloads of the Limiter class, i.e., format conversion, limiting,
+ * and dithered quantisation take place in one pass over the samples. */
+template<typename real, typename sample>
+static int Run(const Options& options) {
+    Limiter<real> limiter;
+    limiter.SetSR(options.SR);
+    limiter.SetAttTime(options.attack);
+    limiter.SetHoldTime(options.hold);
+    limiter.SetRelTime(options.release);
+    limiter.SetPreGain(options.preGain);
+    limiter.SetThreshold(options.threshold);
+    limiter.SetDither(options.dither);
+    limiter.Reset();
+
+    const size_t blockFrames = options.blockFrames;
+    const size_t frameBytes = 2 * sizeof(sample);
+    const size_t inputBytes = blockFrames * frameBytes;
+    uint8_t* input = static_cast<uint8_t*>(std::aligned_alloc(4096, (inputBytes + 4095) & ~size_t(4095)));
+    if (input == nullptr) {
+        std::cerr << "limitPipe: out of memory." << std::endl;
+        return 1;
+    }
+    PipeOutput output;
+    output.Init(STDOUT_FILENO, inputBytes);
+    output.SetSplice(options.splice);
+
+    size_t skipFrames = options.compensateLatency ? limiter.GetLatency() : 0;
+    size_t tailFrames = skipFrames;
+    size_t pending = 0; // Bytes of an incomplete frame carried over.
+    bool endOfFile = false;
+    bool ok = true;
+    while (ok && !(endOfFile && tailFrames == 0)) {
+        size_t frames = 0;
+        size_t bytes = 0; // Bytes read, including the carried over ones.
+        if (!endOfFile) {
+
+            /* Process whatever complete frames a single read returns. When
+             * no more input is ready, the partially filled output buffer is
+             * written before blocking, so that the latency through the 
+             * pipeline stays low. */
+            pollfd ready = { STDIN_FILENO, POLLIN, 0 };
+            if (poll(&ready, 1, 0) == 0 && !output.Flush()) {
+                ok = false;
+                break;
+            }
+            ssize_t result = read(STDIN_FILENO, input + pending, inputBytes - pending);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result < 0) {
+                ok = false;
+                break;
+            }
+            endOfFile = result == 0;
+            bytes = pending + size_t(result);
+            frames = bytes / frameBytes;
+        } else {
+
+            /* Flush the look-ahead tail with zeros. */
+            frames = std::min(tailFrames, blockFrames);
+            std::memset(input, 0, frames * frameBytes);
+            tailFrames -= frames;
+        }
+
+        /* The frames may span two output buffers. */
+        const sample* x = reinterpret_cast<const sample*>(input);
+        size_t done = 0;
+        while (ok && done < frames) {
+            size_t space;
+            uint8_t* y = output.GetSpace(space);
+            size_t len = std::min(frames - done, space / frameBytes);
+            limiter.ProcessInterleaved(x + 2 * done, reinterpret_cast<sample*>(y), len);
+            size_t skip = std::min(skipFrames, len);
+            if (skip > 0) {
+                std::memmove(y, y + skip * frameBytes, (len - skip) * frameBytes);
+                skipFrames -= skip;
+            }
+            ok = output.Commit((len - skip) * frameBytes);
+            done += len;
+        }
+        if (bytes > 0) {
+            pending = bytes - frames * frameBytes;
+            std::memmove(input, input + frames * frameBytes, pending);
+        }
+    }
+    ok = ok && output.Flush();
+    std::free(input);
+    if (!ok) {
+        std::cerr << "limitPipe: I/O error: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    if (pending > 0) {
+        std::cerr << "limitPipe: the input ended with an incomplete frame." << std::endl;
+    }
+    return 0;
+}
+
+template<typename real>
+static int Run(const Options& options) {
+    switch (options.format) {
+        case s16:
+            return Run<real, int16_t>(options);
+        case s24:
+            return Run<real, Int24>(options);
+        case s32:
+            return Run<real, int32_t>(options);
+        case f32:
+            return Run<real, float>(options);
+        default:
+            return Run<real, double>(options);
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (option == "--format" && hasValue) {
+            std::string name = argv[++i];
+            const char* names[] = { "s16", "s24", "s32", "f32", "f64" };
+            size_t index = 0;
+            while (index < 5 && name != names[index]) {
+                index++;
+            }
+            if (index == 5) {
+                std::cerr << "Unknown format: " << name << std::endl;
+                return 1;
+            }
+            options.format = Format(index);
+        } else if (option == "--f64") {
+            options.f64Processing = true;
+        } else if (option == "--no-compensation") {
+            options.compensateLatency = false;
+        } else if (option == "--no-dither") {
+            options.dither = false;
+        } else if (option == "--no-splice") {
+            options.splice = false;
+        } else if (option == "--sr" && hasValue) {
+            options.SR = std::atof(argv[++i]);
+        } else if (option == "--pregain" && hasValue) {
+            options.preGain = std::atof(argv[++i]);
+        } else if (option == "--threshold" && hasValue) {
+            options.threshold = std::atof(argv[++i]);
+        } else if (option == "--attack" && hasValue) {
+            options.attack = std::atof(argv[++i]);
+        } else if (option == "--hold" && hasValue) {
+            options.hold = std::atof(argv[++i]);
+        } else if (option == "--release" && hasValue) {
+            options.release = std::atof(argv[++i]);
+        } else if (option == "--block" && hasValue) {
+
+            /* Multiples of 4096 frames make the output buffers a whole
+             * number of pages for every format. */
+            size_t frames = std::strtoul(argv[++i], nullptr, 10);
+            options.blockFrames = std::max<size_t>(1, (frames + 4095) / 4096) * 4096;
+        } else {
+            std::cerr << "Usage: limitPipe [--format s16|s24|s32|f32|f64] [--f64] [--sr Hz]\n"
+                "           [--pregain dB] [--threshold dB] [--attack s] [--hold s]\n"
+                "           [--release s] [--block frames] [--no-compensation]\n"
+                "           [--no-dither] [--no-splice]" << std::endl;
+            return 1;
+        }
+    }
+    return options.f64Processing ? Run<double>(options) : Run<float>(options);
+}
@@ -0,0 +1,227 @@
+/*******************************************************************************
+ *
+ * Test of the AudioBuffer class and of the aligned paths of the Limiter
+ * class.
+ *
+ * The program checks the alignment, the padding, and the zeroing of planar
+ * and interleaved buffers of several sample types. It then processes noise
+ * through the planar and interleaved views of AudioBuffers and through raw
+ * pointers offset by one sample from a cache line, and checks that the
+ * outputs are identical, for float, double, and integer PCM. Lastly, it
+ * compares the execution times of the two paths.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include "Generators.hpp"
+#include "Limiter.hpp"
+#include "AudioBuffer.hpp"
+
+static bool IsAligned(const void* p) {
+    return reinterpret_cast<uintptr_t>(p) % audioAlignment == 0;
+}
+
+/* Returns the number of failed checks of the layout of a buffer. */
+template<typename sample>
+static size_t CheckLayout(size_t numberOfChannels, size_t frames) {
+    size_t failures = 0;
+    AudioBuffer<sample> planar(numberOfChannels, frames);
+    for (size_t c = 0; c < numberOfChannels; c++) {
+        failures += !IsAligned(planar.GetChannel(c));
+    }
+    failures += planar.GetPaddedLen() < frames;
+    failures += (planar.GetPaddedLen() * sizeof(sample)) % audioAlignment != 0;
+    failures += planar.Interleaved().data != nullptr;
+    failures += planar.Planar().frames != frames;
+    AudioBuffer<sample> interleaved(numberOfChannels, frames, AudioBuffer<sample>::interleaved);
+    failures += !IsAligned(interleaved.Interleaved().data);
+    failures += interleaved.GetPaddedLen() < frames * numberOfChannels;
+    failures += (interleaved.GetPaddedLen() * sizeof(sample)) % audioAlignment != 0;
+    failures += interleaved.Planar().numberOfChannels != 0;
+
+    /* The padding is zeroed. */
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(planar.GetData());
+    for (size_t n = 0; n < numberOfChannels * planar.GetPaddedLen() * sizeof(sample); n++) {
+        failures += bytes[n] != 0;
+    }
+    return failures;
+}
+
+template<typename limiter>
+static void Setup(limiter& l) {
+    l.SetSR(48000.0);
+    l.SetAttTime(.004);
+    l.SetHoldTime(.002);
+    l.SetRelTime(.05);
+    l.SetPreGain(18.0);
+    l.SetThreshold(-1.0);
+    l.Reset();
+}
+
+static void Store(double x, float& y) { y = float(x); }
+static void Store(double x, double& y) { y = x; }
+static void Store(double x, int16_t& y) { y = PcmFormat<int16_t>::Write<double>(std::floor(x * 32768.0)); }
+
+static bool Equal(float x, float y) { return x == y; }
+static bool Equal(double x, double y) { return x == y; }
+static bool Equal(int16_t x, int16_t y) { return x == y; }
+
+/* Returns the number of samples that differ between the aligned views and
+ * the misaligned raw pointers, planar and interleaved, over blocks of
+ * varying length. */
+template<typename limiter, typename sample, typename outputSample>
+static size_t Compare() {
+    const size_t maxVecLen = 1500;
+    const size_t blocks = 100;
+    Generators<double> generators;
+    std::vector<double> noise(2 * maxVecLen);
+    AudioBuffer<sample> x(2, maxVecLen);
+    AudioBuffer<outputSample> y(2, maxVecLen);
+    AudioBuffer<sample> xInterleaved(2, maxVecLen, AudioBuffer<sample>::interleaved);
+    AudioBuffer<outputSample> yInterleaved(2, maxVecLen, AudioBuffer<outputSample>::interleaved);
+
+    /* Raw vectors starting one sample after a cache line. */
+    AudioBuffer<sample> xRaw(2, maxVecLen + 1);
+    AudioBuffer<outputSample> yRaw(2, maxVecLen + 1);
+    AudioBuffer<sample> xRawInterleaved(2, maxVecLen + 1, AudioBuffer<sample>::interleaved);
+    AudioBuffer<outputSample> yRawInterleaved(2, maxVecLen + 1, AudioBuffer<outputSample>::interleaved);
+    limiter l[4];
+    for (size_t i = 0; i < 4; i++) {
+        Setup(l[i]);
+    }
+    size_t mismatches = 0;
+    for (size_t block = 0; block < blocks; block++) {
+        size_t vecLen = 1 + (block * 613) % maxVecLen;
+        generators.ProcessNoise(noise.data(), 2 * vecLen);
+        sample* xVec[2] = { xRaw.GetChannel(0) + 1, xRaw.GetChannel(1) + 1 };
+        outputSample* yVec[2] = { yRaw.GetChannel(0) + 1, yRaw.GetChannel(1) + 1 };
+        sample* xFrames = xRawInterleaved.GetData() + 1;
+        outputSample* yFrames = yRawInterleaved.GetData() + 1;
+        for (size_t c = 0; c < 2; c++) {
+            for (size_t n = 0; n < vecLen; n++) {
+                Store(noise[c * vecLen + n], x.GetChannel(c)[n]);
+                Store(noise[c * vecLen + n], xVec[c][n]);
+                Store(noise[c * vecLen + n], xInterleaved.GetData()[2 * n + c]);
+                Store(noise[c * vecLen + n], xFrames[2 * n + c]);
+            }
+        }
+        AudioPlanarView<sample> xView = x.Planar();
+        AudioPlanarView<outputSample> yView = y.Planar();
+        AudioInterleavedView<sample> xFramesView = xInterleaved.Interleaved();
+        AudioInterleavedView<outputSample> yFramesView = yInterleaved.Interleaved();
+        xView.frames = vecLen;
+        xFramesView.frames = vecLen;
+        l[0].Process(xView, yView);
+        l[1].Process(xVec, yVec, vecLen);
+        l[2].ProcessInterleaved(xFramesView, yFramesView);
+        l[3].ProcessInterleaved(xFrames, yFrames, vecLen);
+        for (size_t c = 0; c < 2; c++) {
+            for (size_t n = 0; n < vecLen; n++) {
+                mismatches += !Equal(y.GetChannel(c)[n], yVec[c][n]);
+                mismatches += !Equal(y.GetChannel(c)[n], yInterleaved.GetData()[2 * n + c]);
+                mismatches += !Equal(y.GetChannel(c)[n], yFrames[2 * n + c]);
+            }
+        }
+    }
+    return mismatches;
+}
+
+int main() {
+    using std::chrono::high_resolution_clock;
+    using std::chrono::duration;
+
+    std::cout << std::fixed << std::setprecision(3);
+
+    size_t failures = 0;
+    failures += CheckLayout<float>(3, 1001);
+    failures += CheckLayout<double>(2, 7);
+    failures += CheckLayout<int16_t>(5, 33);
+    failures += CheckLayout<Int24>(2, 100);
+    std::cout << "Failed layout checks: " << failures << std::endl;
+
+    size_t mismatches = 0;
+    mismatches += Compare<Limiter<float>, float, float>();
+    mismatches += Compare<Limiter<double>, double, double>();
+    mismatches += Compare<LimiterMixedPrecision<>, float, float>();
+    mismatches += Compare<Limiter<float>, int16_t, int16_t>();
+    std::cout << "Mismatches between the aligned and unaligned paths: " << mismatches << std::endl;
+
+    /* Views of other than two channels are not processed, and the outputs
+     * are left untouched. */
+    size_t channelErrors = 0;
+    {
+        Limiter<float> limiter;
+        Setup(limiter);
+        AudioBuffer<float> stereo(2, 64);
+        AudioBuffer<float> mono(1, 64);
+        AudioBuffer<float> stereoFrames(2, 64, AudioBuffer<float>::interleaved);
+        AudioBuffer<float> monoFrames(1, 64, AudioBuffer<float>::interleaved);
+        AudioBuffer<float> surroundFrames(6, 64, AudioBuffer<float>::interleaved);
+        std::fill(mono.GetChannel(0), mono.GetChannel(0) + 64, 7.0f);
+        std::fill(monoFrames.GetData(), monoFrames.GetData() + 64, 7.0f);
+        std::fill(stereoFrames.GetData(), stereoFrames.GetData() + 128, 7.0f);
+        channelErrors += limiter.Process(mono.Planar(), mono.Planar()) != 0;
+        channelErrors += limiter.Process(stereo.Planar(), mono.Planar()) != 0;
+        channelErrors += limiter.Process(mono.Planar(), stereo.Planar()) != 0;
+        channelErrors += limiter.ProcessInterleaved(monoFrames.Interleaved(), monoFrames.Interleaved()) != 0;
+        channelErrors += limiter.ProcessInterleaved(surroundFrames.Interleaved(), stereoFrames.Interleaved()) != 0;
+        channelErrors += limiter.ProcessInterleaved(stereoFrames.Interleaved(), surroundFrames.Interleaved()) != 0;
+        for (size_t n = 0; n < 64; n++) {
+            channelErrors += mono.GetChannel(0)[n] != 7.0f || monoFrames.GetData()[n] != 7.0f;
+            channelErrors += stereoFrames.GetData()[2 * n] != 7.0f || stereoFrames.GetData()[2 * n + 1] != 7.0f;
+        }
+        channelErrors += limiter.Process(stereo.Planar(), stereo.Planar()) != 64;
+        channelErrors += limiter.ProcessInterleaved(stereoFrames.Interleaved(), stereoFrames.Interleaved()) != 64;
+    }
+    std::cout << "Failed checks of the channel count of the views: " << channelErrors << std::endl;
+
+    /* Execution time of one second of audio in blocks of 512 samples,
+     * aligned views against misaligned raw pointers. */
+    const size_t vecLen = 512;
+    const size_t blocks = 48000 / vecLen;
+    const size_t iterations = 200;
+    AudioBuffer<float> x(2, vecLen);
+    AudioBuffer<float> y(2, vecLen);
+    AudioBuffer<float> xRaw(2, vecLen + 1);
+    AudioBuffer<float> yRaw(2, vecLen + 1);
+    Generators<float> generators;
+    generators.ProcessNoise(x.GetChannel(0), vecLen);
+    generators.ProcessNoise(x.GetChannel(1), vecLen);
+    float* xVec[2] = { xRaw.GetChannel(0) + 1, xRaw.GetChannel(1) + 1 };
+    float* yVec[2] = { yRaw.GetChannel(0) + 1, yRaw.GetChannel(1) + 1 };
+    for (size_t c = 0; c < 2; c++) {
+        std::memcpy(xVec[c], x.GetChannel(c), vecLen * sizeof(float));
+    }
+    Limiter<float> limiter[2];
+    Setup(limiter[0]);
+    Setup(limiter[1]);
+    double times[2] = { .0, .0 };
+    for (size_t i = 0; i < iterations; i++) {
+        auto t0 = high_resolution_clock::now();
+        for (size_t block = 0; block < blocks; block++) {
+            limiter[0].Process(x.Planar(), y.Planar());
+        }
+        auto t1 = high_resolution_clock::now();
+        for (size_t block = 0; block < blocks; block++) {
+            limiter[1].Process(xVec, yVec, vecLen);
+        }
+        auto t2 = high_resolution_clock::now();
+        duration<double, std::micro> aligned = t1 - t0;
+        duration<double, std::micro> unaligned = t2 - t1;
+        times[0] += aligned.count();
+        times[1] += unaligned.count();
+    }
+    std::cout << "Execution time per second of audio, aligned views / unaligned pointers (microsecond): "
+        << times[0] / double(iterations) << " / " << times[1] / double(iterations) << std::endl;
+
+    bool passed = failures == 0 && mismatches == 0 && channelErrors == 0;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+/*******************************************************************************
+ *
+ * Test of the BinaryDump class.
+ *
+ * The program writes columns of float, double, and int16_t samples as NPY
+ * and raw files, with buffers small enough to be flushed many times, reads
+ * them back, and checks the header and the samples. It then dumps ten
+ * seconds of a limiter render, i.e., the input, the output, and the
+ * captured detection signals, as NPY and as CSV with 17 digits, and
+ * compares the execution times.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "Generators.hpp"
+#include "Limiter.hpp"
+#include "BinaryDump.hpp"
+
+static std::vector<char> ReadFile(const char* path) {
+    std::ifstream file(path, std::ifstream::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+/* Writes the columns in two calls, one per writing function, and returns
+ * the number of failed checks of the file read back. */
+template<typename T>
+static size_t RoundTrip(const char* path, typename BinaryDump<T>::Format format, size_t numberOfColumns,
+        size_t frames, size_t bufferBytes) {
+    std::vector<std::vector<T>> columns(numberOfColumns, std::vector<T>(frames));
+    for (size_t c = 0; c < numberOfColumns; c++) {
+        for (size_t n = 0; n < frames; n++) {
+            columns[c][n] = T(int32_t((n * 7919 + c * 104729) % 20011) - 10005);
+        }
+    }
+    size_t split = frames / 3;
+    std::vector<const T*> columnVec(numberOfColumns);
+    for (size_t c = 0; c < numberOfColumns; c++) {
+        columnVec[c] = columns[c].data();
+    }
+    std::vector<T> rows((frames - split) * numberOfColumns);
+    for (size_t n = split; n < frames; n++) {
+        for (size_t c = 0; c < numberOfColumns; c++) {
+            rows[(n - split) * numberOfColumns + c] = columns[c][n];
+        }
+    }
+    BinaryDump<T> dump;
+    size_t failures = !dump.Open(path, numberOfColumns, format, bufferBytes);
+    dump.Write(columnVec.data(), split);
+    dump.WriteRows(rows.data(), frames - split);
+    failures += dump.GetRows() != frames;
+    failures += !dump.Close();
+
+    std::vector<char> file = ReadFile(path);
+    size_t offset = 0;
+    if (format == BinaryDump<T>::npy) {
+        offset = BinaryDump<T>::headerLen;
+        failures += file.size() < offset || std::memcmp(file.data(), "\x93NUMPY\x01\x00", 8) != 0;
+        std::string header(file.data() + 10, offset - 10);
+        std::string shape = "'shape': (" + std::to_string(frames) + ", " + std::to_string(numberOfColumns) + ")";
+        failures += header.find(shape) == std::string::npos;
+        failures += header.find(NpyType<T>::Descr()) == std::string::npos;
+        failures += header[header.size() - 1] != '\n';
+    }
+    failures += file.size() != offset + frames * numberOfColumns * sizeof(T);
+    if (failures == 0) {
+        for (size_t n = 0; n < frames; n++) {
+            for (size_t c = 0; c < numberOfColumns; c++) {
+                T x;
+                std::memcpy(&x, file.data() + offset + (n * numberOfColumns + c) * sizeof(T), sizeof(T));
+                failures += x != columns[c][n];
+            }
+        }
+    }
+    std::remove(path);
+    return failures;
+}
+
+int main() {
+    typedef double real;
+    typedef Limiter<real> LimiterType;
+
+    using std::chrono::high_resolution_clock;
+    using std::chrono::duration;
+
+    std::cout << std::fixed << std::setprecision(3);
+
+    size_t failures = 0;
+    failures += RoundTrip<double>("BinaryDumpTest.npy", BinaryDump<double>::npy, 9, 10007, 4096);
+    failures += RoundTrip<float>("BinaryDumpTest.npy", BinaryDump<float>::npy, 3, 5000, 100);
+    failures += RoundTrip<int16_t>("BinaryDumpTest.raw", BinaryDump<int16_t>::raw, 2, 7777, 1000);
+    failures += RoundTrip<float>("BinaryDumpTest.raw", BinaryDump<float>::raw, 1, 1, 1);
+    std::cout << "Failed round-trip checks: " << failures << std::endl;
+
+    /* Ten seconds of stereo limiting in blocks of 1024 samples, with the
+     * detection signals captured. */
+    const real SR = 48000.0;
+    const size_t vecLen = 1024;
+    const size_t frames = size_t(10.0 * SR) / vecLen * vecLen;
+    const size_t numberOfColumns = 4 + LimiterType::numberOfSignals;
+    std::vector<std::vector<real>> columns(numberOfColumns, std::vector<real>(frames));
+    Generators<real> generators;
+    generators.ProcessNoise(columns[0].data(), frames);
+    generators.ProcessNoise(columns[1].data(), frames);
+    LimiterType limiter(SR, 12.0, .005, .002, .1, -1.0);
+    limiter.Reset();
+    for (size_t offset = 0; offset < frames; offset += vecLen) {
+        const real* xVec[2] = { columns[0].data() + offset, columns[1].data() + offset };
+        real* yVec[2] = { columns[2].data() + offset, columns[3].data() + offset };
+        real* captureVec[LimiterType::numberOfSignals];
+        for (size_t i = 0; i < LimiterType::numberOfSignals; i++) {
+            captureVec[i] = columns[4 + i].data() + offset;
+        }
+        limiter.SetCapture(captureVec);
+        limiter.Process(xVec, yVec, vecLen);
+    }
+    limiter.SetCapture(nullptr);
+    std::vector<const real*> columnVec(numberOfColumns);
+    for (size_t c = 0; c < numberOfColumns; c++) {
+        columnVec[c] = columns[c].data();
+    }
+
+    auto t0 = high_resolution_clock::now();
+    BinaryDump<real> dump;
+    dump.Open("BinaryDumpRender.npy", numberOfColumns);
+    for (size_t offset = 0; offset < frames; offset += vecLen) {
+        const real* block[numberOfColumns];
+        for (size_t c = 0; c < numberOfColumns; c++) {
+            block[c] = columnVec[c] + offset;
+        }
+        dump.Write(block, vecLen);
+    }
+    bool written = dump.Close();
+    auto t1 = high_resolution_clock::now();
+    std::ofstream csvFile("BinaryDumpRender.csv", std::ofstream::trunc);
+    csvFile << std::fixed << std::setprecision(17);
+    for (size_t n = 0; n < frames; n++) {
+        csvFile << n;
+        for (size_t c = 0; c < numberOfColumns; c++) {
+            csvFile << "," << columns[c][n];
+        }
+        csvFile << "\n";
+    }
+    csvFile.close();
+    auto t2 = high_resolution_clock::now();
+    duration<double, std::milli> npyTime = t1 - t0;
+    duration<double, std::milli> csvTime = t2 - t1;
+    std::remove("BinaryDumpRender.npy");
+    std::remove("BinaryDumpRender.csv");
+    std::cout << "Dump of 10 seconds of input, output, and detection signals, NPY / CSV (millisecond): "
+        << npyTime.count() << " / " << csvTime.count() << std::endl;
+
+    bool passed = failures == 0 && written && npyTime.count() < csvTime.count();
+    return passed ? 0 : 1;
+}
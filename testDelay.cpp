@@ -1,10 +1,10 @@
 #include <iostream>
-#include <fstream>
 #include <iomanip>
 #include <cstdint>
 #include <chrono>
 #include "Generators.hpp"
 #include "DelaySmooth.hpp"
+#include "BinaryDump.hpp"
 
 int main() {
     typedef double real;
@@ -14,8 +14,6 @@ int main() {
     using std::chrono::duration;
     using std::chrono::microseconds;
 
-    std::ofstream csvFile("DelaySmooth.csv", std::ofstream::trunc);
-    csvFile << std::fixed << std::setprecision(17);
     std::cout << std::fixed << std::setprecision(17);
 
     const int vecLen = 4096;
@@ -37,13 +35,81 @@ int main() {
     delayline.SetInterpolationTime(delay);
     delayline.Reset();
 
-    /* Fill input and output vectors to generate a CSV file. */
+    /* Fill input and output vectors to generate an NPY file. */
     generators.ProcessNoise(inVec[0], vecLen);
     generators.ProcessNoise(inVec[1], vecLen);
     delayline.Process(inVec, outVec, vecLen);
-    for (size_t i = 0; i < vecLen; i++) {
-	    csvFile << i << "," << inVec[0][i] << "," << inVec[1][i] << "," << outVec[0][i] << "," << outVec[1][i] << "\n";
+    BinaryDump<real> dump;
+    dump.Open("DelaySmooth.npy", 4);
+    const real* columns[4] = { inVec[0], inVec[1], outVec[0], outVec[1] };
+    dump.Write(columns, vecLen);
+    dump.Close();
+
+    /* Check that, once the initial crossfade is completed, writing blocks 
+     * and reading them back as spans matches the per-sample processing. */
+    DelaySmooth<uint16_t, real> spanDelayline(delay, delay);
+    spanDelayline.Reset();
+    spanDelayline.Process(inVec, outVec, vecLen);
+    real maxDifference = .0;
+    for (size_t block = 0; block < 40; block++) {
+        generators.ProcessNoise(inVec[0], vecLen);
+        generators.ProcessNoise(inVec[1], vecLen);
+        delayline.Process(inVec, outVec, vecLen);
+        if (!spanDelayline.IsSteady()) {
+            maxDifference = 1.0;
+            break;
+        }
+        spanDelayline.Write(inVec, vecLen);
+        for (size_t channel = 0; channel < 2; channel++) {
+            DelaySmooth<uint16_t, real>::Span span = 
+                spanDelayline.ReadSpan(channel, delay, vecLen);
+            size_t n = 0;
+            for (size_t part = 0; part < 2; part++) {
+                for (size_t i = 0; i < span.len[part]; i++, n++) {
+                    maxDifference = std::max<real>(maxDifference,
+                        std::fabs(span.data[part][i] - outVec[channel][n]));
+                }
+            }
+        }
+    }
+
+    /* Check the reduced-precision storage types against the quantisation
+     * step of each type. Noise is scaled down as integer storage saturates
+     * at full scale. */
+    DelaySmooth<uint16_t, real, float> floatDelayline(delay, delay);
+    DelaySmooth<uint16_t, real, int16_t> int16Delayline(delay, delay);
+    DelaySmooth<uint16_t, real, Int24> int24Delayline(delay, delay);
+    real maxStorageError[3] = { .0, .0, .0 };
+    real** storageOutVec = new real*[2];
+    for (size_t i = 0; i < 2; i++) {
+        storageOutVec[i] = new real[vecLen];
+    }
+    for (size_t block = 0; block < 4; block++) {
+        generators.ProcessNoise(inVec[0], vecLen);
+        generators.ProcessNoise(inVec[1], vecLen);
+        for (size_t i = 0; i < vecLen; i++) {
+            inVec[0][i] *= .99;
+            inVec[1][i] *= .99;
+        }
+        delayline.Process(inVec, outVec, vecLen);
+        for (size_t type = 0; type < 3; type++) {
+            if (type == 0) {
+                floatDelayline.Process(inVec, storageOutVec, vecLen);
+            } else if (type == 1) {
+                int16Delayline.Process(inVec, storageOutVec, vecLen);
+            } else {
+                int24Delayline.Process(inVec, storageOutVec, vecLen);
+            }
+            for (size_t channel = 0; channel < 2 && block > 0; channel++) {
+                for (size_t i = 0; i < size_t(vecLen); i++) {
+                    maxStorageError[type] = std::max<real>(maxStorageError[type],
+                        std::fabs(storageOutVec[channel][i] - outVec[channel][i]));
+                }
+            }
+        }
     }
+    bool storagePassed = maxStorageError[0] <= std::pow(2.0, -24.0) &&
+        maxStorageError[1] <= std::pow(2.0, -16.0) && maxStorageError[2] <= std::pow(2.0, -24.0);
 
     /* Execution time measurement variables. */
     double averageTime = 0;
@@ -83,11 +149,13 @@ int main() {
     standardDeviation = std::sqrt(standardDeviation);
     standardDeviation /= averageTime;
 
+    std::cout << "Max difference between spans and per-sample processing: " << maxDifference << std::endl;
+    std::cout << "Max error of float, int16, and int24 storage: " << maxStorageError[0] << ", "
+        << maxStorageError[1] << ", " << maxStorageError[2] << std::endl;
     std::cout << "Iterations: " << iterations << std::endl;
     std::cout << "Average execution time (microsecond): " << averageTime << std::endl;
     std::cout << "Relative standard deviation (%): " << (standardDeviation * 100.0) << std::endl;
-    std::cout << "The program has generated the file DelaySmooth.csv containing one vector of input and output samples." << std::endl;
+    std::cout << "The program has generated the file DelaySmooth.npy containing one vector of input and output samples." << std::endl;
 
-    csvFile.close();
-    return 0;
+    return maxDifference == .0 && storagePassed ? 0 : 1;
 }
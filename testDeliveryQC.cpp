@@ -0,0 +1,267 @@
+/*******************************************************************************
+ *
+ * Test of the DeliveryQC class.
+ *
+ * The program measures synthetic signals with known violations, i.e., a
+ * sine at a quarter of the sampling rate whose peaks fall between the
+ * samples, runs of clipped samples of several lengths, some across
+ * sub-blocks or open at the end, and an offset, and checks the report and
+ * the positions of the violations against a direct measurement of the
+ * whole signals. The signals are given in blocks of odd lengths, planar
+ * and interleaved, as floating-point samples and as 16-bit PCM. It then
+ * attaches a DeliveryQC to a limiter and checks that the report and the
+ * violations match those of a second pass over the output. Lastly, it
+ * compares the execution times of the limiter with and without the QC and
+ * of the second pass; the QC adds about the time of the second pass to
+ * the limiter, since it saves a read of the output rather than any of the
+ * measurement.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include <tuple>
+#include <vector>
+#include <algorithm>
+#include "Generators.hpp"
+#include "Limiter.hpp"
+#include "DeliveryQC.hpp"
+
+typedef DeliveryQC<double> QC;
+
+/* True-peak interpolator of ITU-R BS.1770-4, Annex 2, phase by phase. */
+static const double interpolator[4][12] = {
+    { 0.0017089843750, 0.0109863281250, -0.0196533203125, 0.0332031250000, -0.0594482421875, 0.1373291015625,
+        0.9721679687500, -0.1022949218750, 0.0476074218750, -0.0266113281250, 0.0148925781250, -0.0083007812500 },
+    { -0.0291748046875, 0.0292968750000, -0.0517578125000, 0.0891113281250, -0.1665039062500, 0.4650878906250,
+        0.7797851562500, -0.2003173828125, 0.1015625000000, -0.0582275390625, 0.0330810546875, -0.0189208984375 },
+    { -0.0189208984375, 0.0330810546875, -0.0582275390625, 0.1015625000000, -0.2003173828125, 0.7797851562500,
+        0.4650878906250, -0.1665039062500, 0.0891113281250, -0.0517578125000, 0.0292968750000, -0.0291748046875 },
+    { -0.0083007812500, 0.0148925781250, -0.0266113281250, 0.0476074218750, -0.1022949218750, 0.9721679687500,
+        0.1373291015625, -0.0594482421875, 0.0332031250000, -0.0196533203125, 0.0109863281250, 0.0017089843750 }
+};
+
+struct Expected {
+    QC::Report report;
+    std::vector<QC::Violation> violations;
+};
+
+/* Direct measurement of whole channels, sample by sample. */
+static Expected Measure(const std::vector<double>* x, double threshold, double ceiling, double clipLevel,
+        size_t minClipRun) {
+    Expected e = Expected();
+    size_t frames = x[0].size();
+    e.report.frames = frames;
+    for (size_t c = 0; c < 2; c++) {
+        double sum = .0;
+        size_t run = 0;
+        for (size_t n = 0; n < frames; n++) {
+            double level = std::fabs(x[c][n]);
+            sum += x[c][n];
+            e.report.samplePeak[c] = std::max(e.report.samplePeak[c], level);
+            if (level > threshold) {
+                e.report.overs++;
+                e.violations.push_back({ n, uint32_t(c), QC::overViolation, level });
+            }
+            double truePeak = .0;
+            for (size_t p = 0; p < 4; p++) {
+                double y = .0;
+                for (size_t k = 0; k < 12 && k <= n; k++) {
+                    y += interpolator[p][k] * x[c][n - k];
+                }
+                truePeak = std::max(truePeak, std::fabs(y));
+            }
+            e.report.truePeak[c] = std::max(e.report.truePeak[c], truePeak);
+            if (truePeak > ceiling) {
+                e.report.truePeakOvers++;
+                e.violations.push_back({ n > 6 ? n - 6 : 0, uint32_t(c), QC::truePeakViolation, truePeak });
+            }
+            if (level >= clipLevel) {
+                run++;
+            }
+            if (run > 0 && (level < clipLevel || n == frames - 1)) {
+                if (run >= minClipRun) {
+                    e.report.clipRuns++;
+                    e.report.longestClipRun = std::max<uint64_t>(e.report.longestClipRun, run);
+                    if (level < clipLevel) {
+                        e.violations.push_back({ n - run, uint32_t(c), QC::clipRunViolation, double(run) });
+                    }
+                }
+                run = 0;
+            }
+        }
+        e.report.dc[c] = sum / double(frames);
+    }
+    return e;
+}
+
+static void Sort(std::vector<QC::Violation>& violations) {
+    std::sort(violations.begin(), violations.end(), [](const QC::Violation& a, const QC::Violation& b) {
+        return std::make_tuple(a.frame, a.channel, int(a.kind)) < std::make_tuple(b.frame, b.channel, int(b.kind));
+    });
+}
+
+/* Returns the number of differences between two reports and their
+ * violations; levels are compared up to rounding. */
+static size_t Compare(const QC::Report& r, std::vector<QC::Violation> violations, const Expected& e) {
+    const double tolerance = 1e-9;
+    size_t failures = 0;
+    failures += r.frames != e.report.frames;
+    failures += r.overs != e.report.overs;
+    failures += r.truePeakOvers != e.report.truePeakOvers;
+    failures += r.clipRuns != e.report.clipRuns;
+    failures += r.longestClipRun != e.report.longestClipRun;
+    for (size_t c = 0; c < 2; c++) {
+        failures += std::fabs(r.samplePeak[c] - e.report.samplePeak[c]) > tolerance;
+        failures += std::fabs(r.truePeak[c] - e.report.truePeak[c]) > tolerance;
+        failures += std::fabs(r.dc[c] - e.report.dc[c]) > tolerance;
+    }
+    std::vector<QC::Violation> expected = e.violations;
+    Sort(violations);
+    Sort(expected);
+    failures += violations.size() != expected.size();
+    for (size_t i = 0; i < std::min(violations.size(), expected.size()); i++) {
+        failures += violations[i].frame != expected[i].frame;
+        failures += violations[i].channel != expected[i].channel;
+        failures += violations[i].kind != expected[i].kind;
+        failures += std::fabs(violations[i].value - expected[i].value) > tolerance;
+    }
+    return failures;
+}
+
+/* Gives the channels to a QC in blocks of odd lengths, planar or
+ * interleaved, as doubles or as 16-bit PCM, which should hold the
+ * samples exactly. */
+template<size_t stride, typename sample>
+static QC Scan(const std::vector<double>* x, double threshold) {
+    size_t frames = x[0].size();
+    std::vector<sample> y(2 * frames);
+    sample* channels[2] = { y.data(), stride == 1 ? y.data() + frames : y.data() + 1 };
+    for (size_t c = 0; c < 2; c++) {
+        for (size_t n = 0; n < frames; n++) {
+            channels[c][n * stride] = sample(x[c][n] / PcmFormat<sample>::scale);
+        }
+    }
+    QC qc;
+    qc.SetTruePeakCeiling(-.5);
+    qc.SetClipLevel(32767.0 / 32768.0);
+    qc.SetMinClipRun(3);
+    qc.SetMaxViolations(size_t(1) << 20);
+    for (size_t offset = 0, block = 0; offset < frames; block++) {
+        size_t vecLen = std::min(frames - offset, 1 + (block * 389) % 1001);
+        qc.Process<stride>(channels[0] + offset * stride, channels[1] + offset * stride, vecLen, threshold);
+        offset += vecLen;
+    }
+    return qc;
+}
+
+template<typename limiter>
+static void Setup(limiter& l) {
+    l.SetSR(48000.0);
+    l.SetAttTime(.001);
+    l.SetHoldTime(.0);
+    l.SetRelTime(.05);
+    l.SetPreGain(24.0);
+    l.SetThreshold(-1.0);
+    l.Reset();
+}
+
+int main() {
+    using std::chrono::high_resolution_clock;
+    using std::chrono::duration;
+
+    std::cout << std::fixed << std::setprecision(3);
+
+    /* A sine at a quarter of the sampling rate with a phase of 45 degrees,
+     * whose samples stay at -1.4 dBFS while its peaks reach +1.6 dBFS, on the
+     * left; clipping runs of 2 to 700 samples at multiples of 16-bit LSB
+     * over an offset of 1/64 on the right. */
+    const size_t frames = 20000;
+    const double ceiling = std::pow(10.0, -.5 / 20.0);
+    const double clipLevel = 32767.0 / 32768.0;
+    const double threshold = std::pow(10.0, -1.0 / 20.0);
+    std::vector<double> x[2] = { std::vector<double>(frames), std::vector<double>(frames, 1.0 / 64.0) };
+    for (size_t n = 0; n < frames; n++) {
+        x[0][n] = std::round(1.2 * std::sin(M_PI / 2.0 * double(n) + M_PI / 4.0) * 32768.0) / 32768.0;
+    }
+    const size_t runStarts[] = { 100, 1000, 2000, 5100, 9000, 15000, 19990 };
+    const size_t runLens[] = { 2, 3, 10, 700, 3, 1, 10 };
+    for (size_t i = 0; i < 7; i++) {
+        for (size_t n = runStarts[i]; n < runStarts[i] + runLens[i]; n++) {
+            x[1][n] = n % 2 == 0 ? clipLevel : -1.0;
+        }
+    }
+    Expected expected = Measure(x, threshold, ceiling, clipLevel, 3);
+    size_t failures = 0;
+    failures += expected.report.overs != 729;
+    failures += expected.report.clipRuns != 5 || expected.report.longestClipRun != 700;
+    failures += expected.report.samplePeak[0] > .85 || std::fabs(expected.report.truePeak[0] - 1.2) > .05;
+    failures += std::fabs(expected.report.dc[1] - 1.0 / 64.0) > .001;
+    QC qc[4] = { Scan<1, double>(x, threshold), Scan<2, double>(x, threshold),
+        Scan<1, int16_t>(x, threshold), Scan<2, int16_t>(x, threshold) };
+    for (size_t i = 0; i < 4; i++) {
+        failures += Compare(qc[i].GetReport(), qc[i].GetViolations(), expected);
+    }
+    std::cout << qc[0].Summary() << std::endl;
+
+    /* A limited number of violations keeps the first ones. */
+    QC bounded;
+    bounded.SetTruePeakCeiling(-.5);
+    bounded.SetMaxViolations(10);
+    bounded.Process<1>(x[0].data(), x[1].data(), frames, threshold);
+    failures += bounded.GetViolations().size() != 10;
+    failures += bounded.GetReport().droppedViolations != expected.violations.size() - 10;
+    std::cout << "Failed checks of the synthetic signals: " << failures << std::endl;
+
+    /* Ten seconds of noise limited at -1 dBFS with the QC attached, against
+     * a second pass over the output. */
+    const size_t vecLen = 1024;
+    const size_t renderFrames = 480 * vecLen;
+    std::vector<double> input[2] = { std::vector<double>(renderFrames), std::vector<double>(renderFrames) };
+    std::vector<double> output[2] = { std::vector<double>(renderFrames), std::vector<double>(renderFrames) };
+    Generators<double> generators;
+    generators.ProcessNoise(input[0].data(), renderFrames);
+    generators.ProcessNoise(input[1].data(), renderFrames);
+    Limiter<double> limiter[2];
+    QC attached;
+    attached.SetTruePeakCeiling(-1.0);
+    attached.SetMaxViolations(size_t(1) << 20);
+    QC secondPass;
+    secondPass.SetTruePeakCeiling(-1.0);
+    secondPass.SetMaxViolations(size_t(1) << 20);
+    Setup(limiter[0]);
+    Setup(limiter[1]);
+    limiter[1].SetQC(&attached);
+    double times[3] = { .0, .0, .0 };
+    for (size_t offset = 0; offset < renderFrames; offset += vecLen) {
+        const double* xVec[2] = { input[0].data() + offset, input[1].data() + offset };
+        double* yVec[2] = { output[0].data() + offset, output[1].data() + offset };
+        auto t0 = high_resolution_clock::now();
+        limiter[0].Process(xVec, yVec, vecLen);
+        auto t1 = high_resolution_clock::now();
+        limiter[1].Process(xVec, yVec, vecLen);
+        auto t2 = high_resolution_clock::now();
+        secondPass.Process<1>(yVec[0], yVec[1], vecLen, limiter[0].GetCoefficients().linThreshold);
+        auto t3 = high_resolution_clock::now();
+        duration<double, std::milli> plain = t1 - t0;
+        duration<double, std::milli> inPass = t2 - t1;
+        duration<double, std::milli> separate = t3 - t2;
+        times[0] += plain.count();
+        times[1] += inPass.count();
+        times[2] += separate.count();
+    }
+    Expected rendered = { secondPass.GetReport(), secondPass.GetViolations() };
+    size_t mismatches = Compare(attached.GetReport(), attached.GetViolations(), rendered);
+    std::cout << attached.Summary() << std::endl;
+    std::cout << "Mismatches between the attached QC and a second pass: " << mismatches << std::endl;
+    std::cout << "Execution time of 10 seconds of audio, limiter / limiter with QC / second pass (millisecond): "
+        << times[0] << " / " << times[1] << " / " << times[2] << std::endl;
+
+    bool passed = failures == 0 && mismatches == 0 && rendered.report.frames == renderFrames;
+    return passed ? 0 : 1;
+}
@@ -1,10 +1,10 @@
 #include <iostream>
-#include <fstream>
 #include <iomanip>
 #include <cstdint>
 #include <chrono>
 #include "Generators.hpp"
 #include "ExpSmootherCascade.hpp"
+#include "BinaryDump.hpp"
 
 int main() {
     typedef double real;
@@ -14,8 +14,6 @@ int main() {
     using std::chrono::duration;
     using std::chrono::microseconds;
 
-    std::ofstream csvFile("ExpSmootherCascade.csv", std::ofstream::trunc);
-    csvFile << std::fixed << std::setprecision(17);
     std::cout << std::fixed << std::setprecision(17);
 
     const int vecLen = 4096;
@@ -35,12 +33,34 @@ int main() {
     expSmoother.SetRelTime(relTime);
     expSmoother.Reset();
 
-    /* Fill input and output vectors to generate a CSV file. */
+    /* Fill input and output vectors to generate an NPY file. */
     generators.ProcessNoise(inVec, vecLen);
     expSmoother.Process(inVec, outVec, vecLen);
-    for (size_t i = 0; i < vecLen; i++) {
-		csvFile << i << "," << inVec[i] << "," << outVec[i] << "\n";
-	}
+    BinaryDump<real> dump;
+    dump.Open("ExpSmootherCascade.npy", 2);
+    const real* columns[2] = { inVec, outVec };
+    dump.Write(columns, vecLen);
+    dump.Close();
+
+    /* The state stored as float follows the double one within float 
+     * precision. */
+    ExpSmootherCascade<4, real, float> expSmootherFloat(SR, attTime, relTime);
+    real outVecFloat[vecLen] = { 0 };
+    real maxFloatError = 0;
+    expSmoother.Reset();
+    for (size_t block = 0; block < 16; block++) {
+        generators.ProcessNoise(inVec, vecLen);
+        expSmoother.Process(inVec, outVec, vecLen);
+        expSmootherFloat.Process(inVec, outVecFloat, vecLen);
+        for (size_t i = 0; i < vecLen; i++) {
+            maxFloatError = std::max(maxFloatError, std::fabs(outVecFloat[i] - outVec[i]));
+        }
+    }
+    std::cout << "Maximum error with float state: " << maxFloatError << std::endl;
+    if (maxFloatError > 1e-5) {
+        std::cout << "Float state FAILED." << std::endl;
+        return 1;
+    }
 
     /* Execution time measurement variables. */
     double averageTime = 0;
@@ -82,8 +102,7 @@ int main() {
     std::cout << "Iterations: " << iterations << std::endl;
     std::cout << "Average execution time (microsecond): " << averageTime << std::endl;
     std::cout << "Relative standard deviation (%): " << (standardDeviation * 100.0) << std::endl;
-    std::cout << "The program has generated the file ExpSmootherCascade.csv containing one vector of input and output samples." << std::endl;
+    std::cout << "The program has generated the file ExpSmootherCascade.npy containing one vector of input and output samples." << std::endl;
 
-    csvFile.close();
     return 0;
 }
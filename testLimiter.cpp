@@ -1,10 +1,11 @@
 #include <iostream>
-#include <fstream>
 #include <iomanip>
 #include <cstdint>
 #include <chrono>
 #include "Generators.hpp"
 #include "Limiter.hpp"
+#include "AudioBuffer.hpp"
+#include "BinaryDump.hpp"
 
 int main() {
     typedef double real;
@@ -14,18 +15,14 @@ int main() {
     using std::chrono::duration;
     using std::chrono::microseconds;
 
-    std::ofstream csvFile("Limiter.csv", std::ofstream::trunc);
-    csvFile << std::fixed << std::setprecision(17);
     std::cout << std::fixed << std::setprecision(17);
 
     const int vecLen = 4096;
     
-    real** inVec = new real*[2];
-    real** outVec = new real*[2];
-    for (size_t i = 0; i < 2; i++) {
-        inVec[i] = new real[vecLen];
-        outVec[i] = new real[vecLen];
-    }
+    AudioBuffer<real> input(2, vecLen);
+    AudioBuffer<real> output(2, vecLen);
+    real* const* inVec = input.GetChannels();
+    real* const* outVec = output.GetChannels();
 
     real SR = 48000.0;
     real attTime = .01;
@@ -46,13 +43,23 @@ int main() {
     limiter.SetThreshold(threshold);
     limiter.Reset();
 
-    /* Fill input and output vectors to generate a CSV file. */
+    /* Fill input and output vectors, and capture the detection signals, 
+     * to generate an NPY file. */
+    typedef Limiter<real> LimiterType;
+    AudioBuffer<real> signals(LimiterType::numberOfSignals, vecLen);
     generators.ProcessNoise(inVec[0], vecLen);
     generators.ProcessNoise(inVec[1], vecLen);
-    limiter.Process(inVec, outVec, vecLen);
-    for (size_t i = 0; i < vecLen; i++) {
-		csvFile << i << "," << inVec[0][i] << "," << inVec[1][i] << "," << outVec[0][i] << "," << outVec[1][i] << "\n";
-	}
+    limiter.SetCapture(signals.GetChannels());
+    limiter.Process(input.Planar(), output.Planar());
+    limiter.SetCapture(nullptr);
+    BinaryDump<real> dump;
+    dump.Open("Limiter.npy", 4 + LimiterType::numberOfSignals);
+    const real* columns[4 + LimiterType::numberOfSignals] = { inVec[0], inVec[1], outVec[0], outVec[1] };
+    for (size_t i = 0; i < LimiterType::numberOfSignals; i++) {
+        columns[4 + i] = signals.GetChannel(i);
+    }
+    dump.Write(columns, vecLen);
+    dump.Close();
 
     /* Execution time measurement variables. */
     double averageTime = 0;
@@ -67,7 +74,7 @@ int main() {
          * the results and store the single times in an array for later 
          * use. */
         auto t0 = high_resolution_clock::now();
-        limiter.Process(inVec, outVec, vecLen);
+        limiter.Process(input.Planar(), output.Planar());
         auto t1 = high_resolution_clock::now();
         duration<double, std::micro> timeDuration = t1 - t0;
         times[i] = timeDuration.count();
@@ -95,8 +102,7 @@ int main() {
     std::cout << "Iterations: " << iterations << std::endl;
     std::cout << "Average execution time (microsecond): " << averageTime << std::endl;
     std::cout << "Relative standard deviation (%): " << (standardDeviation * 100.0) << std::endl;
-    std::cout << "The program has generated the file Limiter.csv containing one vector of input and output samples." << std::endl;
+    std::cout << "The program has generated the file Limiter.npy containing one vector of input and output samples, followed by the peak, hold, clipped, and smoothed envelopes and the gain." << std::endl;
 
-    csvFile.close();
     return 0;
 }
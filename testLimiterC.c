@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "LimiterC.h"
+
+/* Tests the C interface from C: planar and interleaved in-place processing
+ * must produce the same output for the same input, and an unknown precision
+ * must be rejected. */
+int main(void) {
+    enum { frames = 4096 };
+    static double left[frames], right[frames], interleaved[2 * frames];
+    static float single[frames];
+    float* singlePlanar[2] = { single, single };
+    double* planar[2] = { left, right };
+    unsigned int state = 12345;
+    size_t i;
+    double maxDifference = 0.0;
+    limiter* invalidLimiter;
+
+    limiter* planarLimiter = limiter_create(LIMITER_F64, 48000.0);
+    limiter* interleavedLimiter = limiter_create(LIMITER_F64, 48000.0);
+    if (planarLimiter == NULL || interleavedLimiter == NULL) {
+        printf("Limiter creation failed.\n");
+        return 1;
+    }
+    limiter_set_pre_gain(planarLimiter, 12.0);
+    limiter_set_pre_gain(interleavedLimiter, 12.0);
+
+    for (i = 0; i < frames; i++) {
+        state = state * 1103515245u + 12345u;
+        left[i] = (double)(state >> 8) / 8388608.0 - 1.0;
+        state = state * 1103515245u + 12345u;
+        right[i] = (double)(state >> 8) / 8388608.0 - 1.0;
+        interleaved[2 * i] = left[i];
+        interleaved[2 * i + 1] = right[i];
+    }
+
+    limiter_process_f64(planarLimiter, (const double* const*)planar, planar, frames);
+    limiter_process_interleaved_f64(interleavedLimiter, interleaved, interleaved, frames);
+    for (i = 0; i < frames; i++) {
+        maxDifference = fmax(maxDifference, fabs(left[i] - interleaved[2 * i]));
+        maxDifference = fmax(maxDifference, fabs(right[i] - interleaved[2 * i + 1]));
+    }
+
+    printf("API version: %d\n", limiter_api_version());
+    printf("Latency (samples): %zu\n", limiter_latency(planarLimiter));
+    printf("Precision mismatch detected: %d\n", 
+        limiter_process_f32(planarLimiter, (const float* const*)singlePlanar, 
+            singlePlanar, frames) == LIMITER_ERROR_PRECISION);
+    printf("Max planar/interleaved difference: %g\n", maxDifference);
+    invalidLimiter = limiter_create((limiter_precision)7, 48000.0);
+    printf("Unknown precision rejected: %d\n", invalidLimiter == NULL);
+
+    limiter_destroy(planarLimiter);
+    limiter_destroy(interleavedLimiter);
+    limiter_destroy(invalidLimiter);
+    return maxDifference == 0.0 && invalidLimiter == NULL ? 0 : 1;
+}
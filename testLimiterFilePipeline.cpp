@@ -0,0 +1,82 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include <unistd.h>
+#include <fcntl.h>
+#include "Generators.hpp"
+#include "LimiterFilePipeline.hpp"
+
+/* Writes a noise file, runs it through the pipeline with small blocks, and 
+ * compares the result with the direct processing of the same signal. The
+ * file ends with an incomplete frame, which must be reported. */
+int main() {
+    typedef float real;
+
+    std::cout << std::fixed << std::setprecision(9);
+
+    const size_t frames = 200000;
+    std::vector<real> input(2 * frames);
+    Generators<real> generators;
+    generators.ProcessNoise(input.data(), 2 * frames);
+
+    char inputPath[] = "/tmp/testLimiterFilePipelineInXXXXXX";
+    char outputPath[] = "/tmp/testLimiterFilePipelineOutXXXXXX";
+    int inputFd = mkstemp(inputPath);
+    int outputFd = mkstemp(outputPath);
+    if (inputFd < 0 || outputFd < 0 ||
+            write(inputFd, input.data(), input.size() * sizeof(real)) != 
+                ssize_t(input.size() * sizeof(real)) ||
+            write(inputFd, input.data(), 5) != 5) {
+        std::cout << "Cannot create the temporary files." << std::endl;
+        return 1;
+    }
+    lseek(inputFd, 0, SEEK_SET);
+
+    LimiterFilePipeline<real> pipeline;
+    pipeline.SetBlockFrames(1000);
+    pipeline.SetNumberOfBlocks(3);
+    Limiter<real>& limiter = pipeline.GetLimiter();
+    Limiter<real> reference;
+    for (Limiter<real>* l : { &limiter, &reference }) {
+        l->SetSR(48000.0);
+        l->SetAttTime(.01);
+        l->SetHoldTime(.0);
+        l->SetRelTime(.05);
+        l->SetPreGain(24.0);
+        l->SetThreshold(-.3);
+        l->Reset();
+    }
+    FilePipelineReport report = pipeline.Run(inputFd, outputFd);
+
+    /* Reference: the input followed by latency zeros, with the first 
+     * latency output frames dropped. */
+    size_t latency = reference.GetLatency();
+    std::vector<real> padded(input);
+    padded.resize(2 * (frames + latency), .0);
+    reference.ProcessInterleaved(padded.data(), padded.data(), frames + latency);
+
+    std::vector<real> output(2 * frames);
+    lseek(outputFd, 0, SEEK_SET);
+    ssize_t bytes = read(outputFd, output.data(), output.size() * sizeof(real));
+    close(inputFd);
+    close(outputFd);
+    unlink(inputPath);
+    unlink(outputPath);
+
+    real maxDifference = .0;
+    for (size_t i = 0; i < 2 * frames; i++) {
+        maxDifference = std::max<real>(maxDifference, 
+            std::fabs(output[i] - padded[2 * latency + i]));
+    }
+
+    std::cout << "Frames written: " << report.frames << " of " << frames << std::endl;
+    std::cout << "Max difference from direct processing: " << maxDifference << std::endl;
+    std::cout << "Time (s): " << report.seconds << ", bottleneck: " << report.bottleneck << std::endl;
+    std::cout << "Truncated bytes: " << report.truncatedBytes << std::endl;
+
+    bool passed = !report.error && report.frames == frames && report.truncatedBytes == 5 &&
+        bytes == ssize_t(output.size() * sizeof(real)) && maxDifference == .0;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <ctime>
+#include <thread>
+#include "Generators.hpp"
+#include "LimiterGraph.hpp"
+
+int main() {
+    typedef float real;
+    
+    using std::chrono::high_resolution_clock;
+    using std::chrono::duration;
+
+    std::cout << std::fixed << std::setprecision(6);
+
+    const size_t vecLen = 128;
+    const size_t numberOfBusses = 256;
+    const size_t numberOfGroups = 16;
+    const size_t threads = std::max<size_t>(2, std::thread::hardware_concurrency());
+
+    /* Routing: every bus feeds one of the group busses, and all group 
+     * busses feed the master bus. */
+    LimiterGraph<real> graph(threads);
+    std::vector<size_t> busses;
+    std::vector<size_t> groups;
+    for (size_t i = 0; i < numberOfBusses; i++) {
+        busses.push_back(graph.AddNode());
+    }
+    for (size_t i = 0; i < numberOfGroups; i++) {
+        groups.push_back(graph.AddNode());
+    }
+    size_t master = graph.AddNode();
+    for (size_t i = 0; i < numberOfBusses; i++) {
+        graph.Connect(busses[i], groups[i % numberOfGroups]);
+    }
+    for (size_t i = 0; i < numberOfGroups; i++) {
+        graph.Connect(groups[i], master);
+    }
+    for (size_t i = 0; i < graph.GetNumberOfNodes(); i++) {
+        Limiter<real>& limiter = graph.GetLimiter(i);
+        limiter.SetSR(48000.0);
+        limiter.SetAttTime(.001 * real(1 + i % 10));
+        limiter.SetHoldTime(.0);
+        limiter.SetRelTime(.05);
+        limiter.SetPreGain(6.0);
+        limiter.SetThreshold(-6.0);
+        limiter.Reset();
+    }
+    if (!graph.Prepare(vecLen)) {
+        std::cout << "The routing contains a cycle." << std::endl;
+        return 1;
+    }
+
+    /* Reference: the same graph processed sequentially in topological order. */
+    std::vector<std::unique_ptr<Limiter<real>>> reference;
+    for (size_t i = 0; i < graph.GetNumberOfNodes(); i++) {
+        reference.emplace_back(new Limiter<real>());
+        reference[i]->SetSR(48000.0);
+        reference[i]->SetAttTime(.001 * real(1 + i % 10));
+        reference[i]->SetHoldTime(.0);
+        reference[i]->SetRelTime(.05);
+        reference[i]->SetPreGain(6.0);
+        reference[i]->SetThreshold(-6.0);
+        reference[i]->Reset();
+    }
+    std::vector<std::vector<real>> refOut(graph.GetNumberOfNodes() * 2, std::vector<real>(vecLen));
+    std::vector<real> mix[2] = { std::vector<real>(vecLen), std::vector<real>(vecLen) };
+
+    Generators<real> generators;
+    real maxDifference = .0;
+    for (size_t block = 0; block < 200; block++) {
+        for (size_t i = 0; i < numberOfBusses; i++) {
+            generators.ProcessNoise(graph.GetInput(busses[i], 0), vecLen);
+            generators.ProcessNoise(graph.GetInput(busses[i], 1), vecLen);
+        }
+        graph.Process(vecLen);
+
+        /* Busses have node indices below the groups, and groups below the 
+         * master, so increasing index order is a topological order. */
+        for (size_t i = 0; i < graph.GetNumberOfNodes(); i++) {
+            for (size_t channel = 0; channel < 2; channel++) {
+                const real* input = graph.GetInput(i, channel);
+                std::copy(input, input + vecLen, mix[channel].begin());
+            }
+            if (i >= numberOfBusses) {
+                for (size_t j = 0; j < numberOfBusses + numberOfGroups; j++) {
+                    bool routed = (i == master && j >= numberOfBusses) ||
+                        (i != master && j < numberOfBusses && groups[j % numberOfGroups] == i);
+                    for (size_t channel = 0; routed && channel < 2; channel++) {
+                        for (size_t n = 0; n < vecLen; n++) {
+                            mix[channel][n] += refOut[2 * j + channel][n];
+                        }
+                    }
+                }
+            }
+            real* xVec[2] = { mix[0].data(), mix[1].data() };
+            real* yVec[2] = { refOut[2 * i].data(), refOut[2 * i + 1].data() };
+            reference[i]->Process(xVec, yVec, vecLen);
+            for (size_t channel = 0; channel < 2; channel++) {
+                for (size_t n = 0; n < vecLen; n++) {
+                    maxDifference = std::max<real>(maxDifference,
+                        std::fabs(refOut[2 * i + channel][n] - graph.GetOutput(i, channel)[n]));
+                }
+            }
+        }
+    }
+
+    /* Execution time measurement. */
+    const size_t iterations = 2000;
+    double averageTime = 0;
+    for (size_t i = 0; i < iterations; i++) {
+        auto t0 = high_resolution_clock::now();
+        graph.Process(vecLen);
+        auto t1 = high_resolution_clock::now();
+        duration<double, std::micro> timeDuration = t1 - t0;
+        averageTime += timeDuration.count();
+    }
+    averageTime /= double(iterations);
+
+    /* Idle workers sleep between blocks: the CPU time of the process over
+     * 200 milliseconds without blocks should be negligible. */
+    std::clock_t c0 = std::clock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    double idleTime = 1000.0 * double(std::clock() - c0) / CLOCKS_PER_SEC;
+
+    std::cout << "Threads: " << threads << ", nodes: " << graph.GetNumberOfNodes() << std::endl;
+    std::cout << "Max difference from sequential processing: " << maxDifference << std::endl;
+    std::cout << "Average block execution time (microsecond): " << averageTime << std::endl;
+    std::cout << "Master node cost (nanosecond): " << graph.GetNodeCost(master) << std::endl;
+    std::cout << "CPU time of 200 idle milliseconds (millisecond): " << idleTime << std::endl;
+
+    return maxDifference == .0 && idleTime < 20.0 ? 0 : 1;
+}
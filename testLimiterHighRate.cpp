@@ -0,0 +1,133 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <chrono>
+#include <vector>
+#include "Generators.hpp"
+#include "Limiter.hpp"
+
+/* Runs noise through a limiter at the given sample rate and returns the 
+ * output peak in dB after one second, and the average execution time per 
+ * second of audio. */
+template<typename real>
+static void Measure(Limiter<real>& limiter, real SR, real& peakdB, double& time) {
+    using std::chrono::high_resolution_clock;
+    using std::chrono::duration;
+
+    const size_t vecLen = 512;
+    const size_t blocks = 4 * size_t(SR) / vecLen;
+    std::vector<real> buffers[4];
+    for (size_t i = 0; i < 4; i++) {
+        buffers[i].resize(vecLen);
+    }
+    real* inVec[2] = { buffers[0].data(), buffers[1].data() };
+    real* outVec[2] = { buffers[2].data(), buffers[3].data() };
+    Generators<real> generators;
+    real peak = .0;
+    time = .0;
+    for (size_t block = 0; block < blocks; block++) {
+        generators.ProcessNoise(inVec[0], vecLen);
+        generators.ProcessNoise(inVec[1], vecLen);
+        auto t0 = high_resolution_clock::now();
+        limiter.Process(inVec, outVec, vecLen);
+        auto t1 = high_resolution_clock::now();
+        duration<double, std::micro> timeDuration = t1 - t0;
+        time += timeDuration.count();
+        for (size_t n = 0; n < vecLen && block * vecLen >= size_t(SR); n++) {
+            peak = std::max<real>(peak, std::max(std::fabs(outVec[0][n]), std::fabs(outVec[1][n])));
+        }
+    }
+    time /= double(blocks * vecLen) / SR;
+    peakdB = 20.0 * std::log10(peak);
+}
+
+template<typename real>
+static void Setup(Limiter<real>& limiter, real SR, real attTime) {
+    limiter.SetSR(SR);
+    limiter.SetAttTime(attTime);
+    limiter.SetHoldTime(.0);
+    limiter.SetRelTime(.05);
+    limiter.SetPreGain(12.0);
+    limiter.SetThreshold(-.3);
+    limiter.Reset();
+}
+
+int main() {
+    typedef double real;
+
+    std::cout << std::fixed << std::setprecision(6);
+
+    /* Long look-ahead at 384 kHz: the default buffers clip the delay, while 
+     * SetMaxAttTime sizes them for it. */
+    real SR = 384000.0;
+    Limiter<real> clipped;
+    Setup(clipped, SR, real(.5));
+    Limiter<real> sized;
+    sized.SetSR(SR);
+    sized.SetMaxAttTime(.5);
+    Setup(sized, SR, real(.5));
+    std::cout << "Latency at 384 kHz with 0.5 s attack, default buffers (samples): " 
+        << clipped.GetLatency() << std::endl;
+    std::cout << "Latency at 384 kHz with 0.5 s attack, sized buffers (samples): " 
+        << sized.GetLatency() << std::endl;
+    real peakdB[3];
+    double time[3];
+    Measure(sized, SR, peakdB[0], time[0]);
+    std::cout << "Output peak with 0.5 s attack (dB): " << peakdB[0] << std::endl;
+
+    /* Buffers sized at 384 kHz follow a change to 48 kHz, and the look-ahead
+     * is clipped to them: an impulse below the threshold, given once the
+     * gain has settled after the reset, must come out after GetLatency()
+     * samples. */
+    Limiter<real> resampled;
+    resampled.SetSR(SR);
+    resampled.SetMaxAttTime(.5);
+    Setup(resampled, SR, real(.5));
+    resampled.SetSR(48000.0);
+    resampled.Reset();
+    const size_t impulseStart = 48000;
+    const size_t impulseLen = impulseStart + resampled.GetLatency() + 4096;
+    std::vector<real> impulse[2] = { std::vector<real>(impulseLen), std::vector<real>(impulseLen) };
+    std::vector<real> response[2] = { std::vector<real>(impulseLen), std::vector<real>(impulseLen) };
+    impulse[0][impulseStart] = impulse[1][impulseStart] = .1;
+    for (size_t offset = 0; offset < impulseLen; offset += 512) {
+        size_t vecLen = std::min<size_t>(512, impulseLen - offset);
+        const real* inVec[2] = { impulse[0].data() + offset, impulse[1].data() + offset };
+        real* outVec[2] = { response[0].data() + offset, response[1].data() + offset };
+        resampled.Process(inVec, outVec, vecLen);
+    }
+    size_t impulseDelay = 0;
+    for (size_t n = impulseStart; n < impulseLen; n++) {
+        if (std::fabs(response[0][n]) > std::fabs(response[0][impulseStart + impulseDelay])) {
+            impulseDelay = n - impulseStart;
+        }
+    }
+    std::cout << "Latency after changing from 384 kHz to 48 kHz, reported / measured (samples): " 
+        << resampled.GetLatency() << " / " << impulseDelay << std::endl;
+
+    /* Decimated against full-rate detection at 384 kHz, and 48 kHz for 
+     * reference. */
+    Limiter<real> decimated;
+    Setup(decimated, SR, real(.01));
+    Limiter<real> fullRate;
+    fullRate.SetDecimatedDetection(false);
+    Setup(fullRate, SR, real(.01));
+    Limiter<real> reference;
+    Setup(reference, real(48000.0), real(.01));
+    Measure(decimated, SR, peakdB[1], time[1]);
+    Measure(fullRate, SR, peakdB[2], time[2]);
+    real referencePeakdB;
+    double referenceTime;
+    Measure(reference, real(48000.0), referencePeakdB, referenceTime);
+    std::cout << "Output peak at 384 kHz, decimated / full-rate detection (dB): " 
+        << peakdB[1] << " / " << peakdB[2] << std::endl;
+    std::cout << "Execution time per second of audio at 384 kHz, decimated / full-rate detection (microsecond): " 
+        << time[1] << " / " << time[2] << std::endl;
+    std::cout << "Execution time per second of audio at 48 kHz (microsecond): " 
+        << referenceTime << std::endl;
+
+    bool passed = clipped.GetLatency() < 65536 && sized.GetLatency() == 192000 &&
+        peakdB[0] < -.29 && peakdB[1] < -.29 && peakdB[2] < -.29 &&
+        impulseDelay == resampled.GetLatency();
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <chrono>
+#include <vector>
+#include "Generators.hpp"
+#include "Limiter.hpp"
+
+/* Processes noise with the look-ahead delay reading from the previous block
+ * kept by the caller, and compares the result with the regular processing
+ * through the internal delay buffers, also across attack time changes. */
+int main() {
+    typedef double real;
+
+    using std::chrono::high_resolution_clock;
+    using std::chrono::duration;
+
+    std::cout << std::fixed << std::setprecision(17);
+
+    const size_t vecLen = 512;
+    const size_t blocks = 4000;
+    const size_t settleBlocks = 200; // Pre-gain smoothing differs at the start.
+    real SR = 48000.0;
+    real attTimes[2] = { .01, .005 };
+    real holdTime = .0;
+    real relTime = .05;
+    real preGain = 12.0;
+    real threshold = -.3;
+
+    Limiter<real> history;
+    Limiter<real> reference;
+    for (Limiter<real>* l : { &history, &reference }) {
+        l->SetSR(SR);
+        l->SetAttTime(attTimes[0]);
+        l->SetHoldTime(holdTime);
+        l->SetRelTime(relTime);
+        l->SetPreGain(preGain);
+        l->SetThreshold(threshold);
+        l->Reset();
+    }
+    history.SetHistoryMode(true);
+
+    /* The caller keeps the current and the previous input blocks. */
+    std::vector<real> buffers[8];
+    for (size_t i = 0; i < 8; i++) {
+        buffers[i].assign(vecLen, .0);
+    }
+    real* inVec[2] = { buffers[0].data(), buffers[1].data() };
+    real* previousVec[2] = { buffers[2].data(), buffers[3].data() };
+    real* outVec[2] = { buffers[4].data(), buffers[5].data() };
+    real* refVec[2] = { buffers[6].data(), buffers[7].data() };
+
+    Generators<real> generators;
+    real maxDifference = .0;
+    for (size_t block = 0; block < blocks; block++) {
+        if (block % 500 == 250) {
+            history.SetAttTime(attTimes[(block / 500) % 2 == 0]);
+            reference.SetAttTime(attTimes[(block / 500) % 2 == 0]);
+        }
+        generators.ProcessNoise(inVec[0], vecLen);
+        generators.ProcessNoise(inVec[1], vecLen);
+        history.ProcessHistory(inVec, previousVec, vecLen, outVec, vecLen);
+        reference.Process(inVec, refVec, vecLen);
+        std::swap(inVec[0], previousVec[0]);
+        std::swap(inVec[1], previousVec[1]);
+        for (size_t channel = 0; channel < 2 && block >= settleBlocks; channel++) {
+            for (size_t n = 0; n < vecLen; n++) {
+                maxDifference = std::max<real>(maxDifference,
+                    std::fabs(outVec[channel][n] - refVec[channel][n]));
+            }
+        }
+    }
+
+    /* Execution time measurement of both modes. */
+    double averageTime[2] = { 0, 0 };
+    for (size_t i = 0; i < blocks; i++) {
+        auto t0 = high_resolution_clock::now();
+        history.ProcessHistory(inVec, previousVec, vecLen, outVec, vecLen);
+        auto t1 = high_resolution_clock::now();
+        reference.Process(inVec, refVec, vecLen);
+        auto t2 = high_resolution_clock::now();
+        duration<double, std::micro> historyDuration = t1 - t0;
+        duration<double, std::micro> referenceDuration = t2 - t1;
+        averageTime[0] += historyDuration.count();
+        averageTime[1] += referenceDuration.count();
+        std::swap(inVec[0], previousVec[0]);
+        std::swap(inVec[1], previousVec[1]);
+        generators.ProcessNoise(inVec[0], vecLen);
+        generators.ProcessNoise(inVec[1], vecLen);
+    }
+
+    std::cout << "Max difference from the internal delay buffers: " << maxDifference << std::endl;
+    std::cout << "Average execution time with caller history (microsecond): "
+        << averageTime[0] / double(blocks) << std::endl;
+    std::cout << "Average execution time with internal buffers (microsecond): "
+        << averageTime[1] / double(blocks) << std::endl;
+
+    return maxDifference < 1e-12 ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <chrono>
+#include <ctime>
+#include <thread>
+#include <vector>
+#include "Generators.hpp"
+#include "Limiter.hpp"
+#include "LimiterMultichannel.hpp"
+
+/* Processes a 128-channel signal made of copies of a stereo pair, whose
+ * linked detection equals that of the pair, and compares every channel with
+ * the stereo Limiter class. The execution time is then measured for one
+ * and for several threads. */
+int main() {
+    typedef double real;
+
+    using std::chrono::high_resolution_clock;
+    using std::chrono::duration;
+
+    std::cout << std::fixed << std::setprecision(17);
+
+    const size_t numberOfChannels = 128;
+    const size_t vecLen = 512;
+    const size_t blocks = 1000;
+    real SR = 48000.0;
+    real attTime = .01;
+    real holdTime = .0;
+    real relTime = .05;
+    real preGain = 12.0;
+    real threshold = -.3;
+
+    size_t threadCounts[2] = { 1, std::max<size_t>(2, std::thread::hardware_concurrency()) };
+
+    std::vector<std::vector<real>> inBuffers(numberOfChannels, std::vector<real>(vecLen));
+    std::vector<std::vector<real>> outBuffers(numberOfChannels, std::vector<real>(vecLen));
+    std::vector<real*> inVec(numberOfChannels);
+    std::vector<real*> outVec(numberOfChannels);
+    for (size_t c = 0; c < numberOfChannels; c++) {
+        inVec[c] = inBuffers[c].data();
+        outVec[c] = outBuffers[c].data();
+    }
+    std::vector<real> refBuffers[2] = { std::vector<real>(vecLen), std::vector<real>(vecLen) };
+    real* refVec[2] = { refBuffers[0].data(), refBuffers[1].data() };
+
+    real maxDifference = .0;
+    double averageTime[2] = { 0, 0 };
+    double idleTime = .0;
+    for (size_t t = 0; t < 2; t++) {
+        LimiterMultichannel<real> multichannel(numberOfChannels, vecLen, threadCounts[t]);
+        Limiter<real> reference;
+        multichannel.SetSR(SR);
+        multichannel.SetAttTime(attTime);
+        multichannel.SetHoldTime(holdTime);
+        multichannel.SetRelTime(relTime);
+        multichannel.SetPreGain(preGain);
+        multichannel.SetThreshold(threshold);
+        multichannel.Reset();
+        reference.SetSR(SR);
+        reference.SetAttTime(attTime);
+        reference.SetHoldTime(holdTime);
+        reference.SetRelTime(relTime);
+        reference.SetPreGain(preGain);
+        reference.SetThreshold(threshold);
+        reference.Reset();
+
+        Generators<real> generators;
+        for (size_t block = 0; block < blocks; block++) {
+            generators.ProcessNoise(inVec[0], vecLen);
+            generators.ProcessNoise(inVec[1], vecLen);
+            for (size_t c = 2; c < numberOfChannels; c++) {
+                std::copy(inVec[c % 2], inVec[c % 2] + vecLen, inVec[c]);
+            }
+            reference.Process(inVec.data(), refVec, vecLen);
+            auto t0 = high_resolution_clock::now();
+            multichannel.Process(inVec.data(), outVec.data(), vecLen);
+            auto t1 = high_resolution_clock::now();
+            duration<double, std::micro> timeDuration = t1 - t0;
+            averageTime[t] += timeDuration.count();
+            for (size_t c = 0; c < numberOfChannels; c++) {
+                for (size_t n = 0; n < vecLen; n++) {
+                    maxDifference = std::max<real>(maxDifference,
+                        std::fabs(outVec[c][n] - refVec[c % 2][n]));
+                }
+            }
+        }
+        averageTime[t] /= double(blocks);
+
+        /* Idle workers sleep between blocks: the CPU time of the process
+         * over 200 milliseconds without blocks should be negligible. */
+        std::clock_t c0 = std::clock();
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        idleTime = std::max(idleTime, 1000.0 * double(std::clock() - c0) / CLOCKS_PER_SEC);
+    }
+
+    std::cout << "Channels: " << numberOfChannels << std::endl;
+    std::cout << "Max difference from the stereo Limiter: " << maxDifference << std::endl;
+    for (size_t t = 0; t < 2; t++) {
+        std::cout << "Average execution time with " << threadCounts[t]
+            << " thread(s) (microsecond): " << averageTime[t] << std::endl;
+    }
+
+    std::cout << "CPU time of 200 idle milliseconds (millisecond): " << std::setprecision(3) << idleTime << std::endl;
+
+    return maxDifference == .0 && idleTime < 20.0 ? 0 : 1;
+}
@@ -0,0 +1,352 @@
+/*******************************************************************************
+ *
+ * Test of the integer PCM input and output of the Limiter class.
+ *
+ * The program processes int16_t, Int24, and int32_t noise with Process and
+ * ProcessInterleaved directly, and after converting it to floating point
+ * in a separate pass, and checks that the outputs are identical, for float
+ * and double limiters, with full-rate and decimated detection and with
+ * fixed-point delay storage. It then compares the execution times of the
+ * two approaches.
+ *
+ * For the integer outputs, it checks that the undithered output is the
+ * rounded floating-point output, that the planar and interleaved outputs
+ * are identical, that the error of the TPDF-dithered output has zero mean
+ * and a variance of 1/4 LSB^2, that noise shaping lowers the error at low
+ * frequencies, and that saturated samples do not wrap around. It then
+ * compares the execution time of the fused quantisation with that of a
+ * separate pass.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <chrono>
+#include <vector>
+#include "Generators.hpp"
+#include "Limiter.hpp"
+
+static void Store(int32_t i, int16_t& y) { y = int16_t(i); }
+static void Store(int32_t i, int32_t& y) { y = i; }
+static void Store(int32_t i, Int24& y) {
+    y = Int24{ { uint8_t(i), uint8_t(i >> 8), uint8_t(i >> 16) } };
+}
+
+/* Quantises noise in [-1; 1) to the given format, the second channel 
+ * continuing the sequence of the first one. */
+template<typename sample>
+static void MakeNoise(std::vector<sample> pcm[2], size_t len) {
+    std::vector<double> noise(2 * len);
+    Generators<double> generators;
+    generators.ProcessNoise(noise.data(), 2 * len);
+    const double full = 1.0 / PcmFormat<sample>::scale;
+    for (size_t c = 0; c < 2; c++) {
+        pcm[c].resize(len);
+        for (size_t n = 0; n < len; n++) {
+            double v = std::max(-full, std::min(full - 1.0, std::floor(noise[c * len + n] * full)));
+            Store(int32_t(v), pcm[c][n]);
+        }
+    }
+}
+
+template<typename sample, typename real>
+static void Convert(const sample* x, real* y, size_t len) {
+    for (size_t n = 0; n < len; n++) {
+        y[n] = PcmFormat<sample>::template Read<real>(x[n]) * real(PcmFormat<sample>::scale);
+    }
+}
+
+template<typename limiter>
+static void Setup(limiter& l, double SR) {
+    l.SetSR(SR);
+    l.SetAttTime(.004);
+    l.SetHoldTime(.002);
+    l.SetRelTime(.05);
+    l.SetPreGain(18.0);
+    l.SetThreshold(-1.0);
+    l.Reset();
+}
+
+/* Returns the number of samples that differ between the direct integer
+ * input and the converted input, planar and interleaved. */
+template<typename limiter, typename real, typename sample>
+static size_t Compare(double SR) {
+    const size_t vecLen = 300;
+    const size_t blocks = 200;
+    std::vector<sample> pcm[2];
+    MakeNoise(pcm, vecLen * blocks);
+    std::vector<sample> interleaved(2 * vecLen * blocks);
+    for (size_t n = 0; n < vecLen * blocks; n++) {
+        interleaved[2 * n] = pcm[0][n];
+        interleaved[2 * n + 1] = pcm[1][n];
+    }
+    limiter direct;
+    limiter converted;
+    limiter directInterleaved;
+    Setup(direct, SR);
+    Setup(converted, SR);
+    Setup(directInterleaved, SR);
+    std::vector<real> buffers[5];
+    for (size_t i = 0; i < 5; i++) {
+        buffers[i].resize(2 * vecLen);
+    }
+    size_t mismatches = 0;
+    for (size_t block = 0; block < blocks; block++) {
+        const sample* xPcm[2] = { pcm[0].data() + block * vecLen, pcm[1].data() + block * vecLen };
+        real* yDirect[2] = { buffers[0].data(), buffers[1].data() };
+        real* xConverted[2] = { buffers[2].data(), buffers[3].data() };
+        real* yInterleaved = buffers[4].data();
+        direct.Process(xPcm, yDirect, vecLen);
+        Convert(xPcm[0], xConverted[0], vecLen);
+        Convert(xPcm[1], xConverted[1], vecLen);
+        converted.Process(xConverted, xConverted, vecLen);
+        directInterleaved.ProcessInterleaved(interleaved.data() + 2 * block * vecLen, yInterleaved, vecLen);
+        for (size_t n = 0; n < vecLen; n++) {
+            for (size_t c = 0; c < 2; c++) {
+                mismatches += yDirect[c][n] != xConverted[c][n];
+                mismatches += yInterleaved[2 * n + c] != xConverted[c][n];
+            }
+        }
+    }
+    return mismatches;
+}
+
+/* Processes noise with a floating-point limiter and with identical 
+ * limiters writing integer PCM, planar and interleaved. It returns the 
+ * number of integer samples differing between the planar and interleaved
+ * outputs or wrapping around, plus those differing from the rounded 
+ * floating-point output when rounded is true, and stores the error of the
+ * planar output in LSB. The error is only taken after the first 20 blocks, 
+ * as the output exceeds full scale while the envelope settles after the
+ * reset. */
+template<typename limiter, typename real, typename sample>
+static size_t CompareOutput(double SR, double threshold, bool ditherOn, NoiseShaping noiseShaping, 
+        bool rounded, std::vector<double>& error) {
+    const size_t vecLen = 300;
+    const size_t blocks = 200;
+    std::vector<real> noise[2];
+    for (size_t c = 0; c < 2; c++) {
+        noise[c].resize(vecLen * blocks);
+    }
+    Generators<real> generators;
+    generators.ProcessNoise(noise[0].data(), vecLen * blocks);
+    generators.ProcessNoise(noise[1].data(), vecLen * blocks);
+    limiter reference;
+    limiter planar;
+    limiter interleaved;
+    limiter* integer[2] = { &planar, &interleaved };
+    Setup(reference, SR);
+    reference.SetThreshold(threshold);
+    for (size_t i = 0; i < 2; i++) {
+        Setup(*integer[i], SR);
+        integer[i]->SetThreshold(threshold);
+        integer[i]->SetDither(ditherOn);
+        integer[i]->SetNoiseShaping(noiseShaping);
+    }
+    std::vector<real> xInterleaved(2 * vecLen);
+    std::vector<real> yReference[2] = { std::vector<real>(vecLen), std::vector<real>(vecLen) };
+    std::vector<sample> yPlanar[2] = { std::vector<sample>(vecLen), std::vector<sample>(vecLen) };
+    std::vector<sample> yInterleaved(2 * vecLen);
+    const double full = 1.0 / PcmFormat<sample>::scale;
+    size_t mismatches = 0;
+    error.clear();
+    for (size_t block = 0; block < blocks; block++) {
+        const real* xVec[2] = { noise[0].data() + block * vecLen, noise[1].data() + block * vecLen };
+        real* yVec[2] = { yReference[0].data(), yReference[1].data() };
+        sample* yPcm[2] = { yPlanar[0].data(), yPlanar[1].data() };
+        for (size_t n = 0; n < vecLen; n++) {
+            xInterleaved[2 * n] = xVec[0][n];
+            xInterleaved[2 * n + 1] = xVec[1][n];
+        }
+        reference.Process(xVec, yVec, vecLen);
+        planar.Process(xVec, yPcm, vecLen);
+        interleaved.ProcessInterleaved(xInterleaved.data(), yInterleaved.data(), vecLen);
+        for (size_t n = 0; n < vecLen; n++) {
+            for (size_t c = 0; c < 2; c++) {
+                int32_t y = int32_t(PcmFormat<sample>::template Read<double>(yPcm[c][n]));
+                mismatches += y != int32_t(PcmFormat<sample>::template Read<double>(yInterleaved[2 * n + c]));
+                if (rounded) {
+                    sample r = PcmFormat<sample>::template Write<real>(yVec[c][n] * real(full));
+                    mismatches += y != int32_t(PcmFormat<sample>::template Read<double>(r));
+                }
+                double exact = double(yVec[c][n]) * full;
+                mismatches += std::fabs(exact) > .5 * full && (y < 0) != (exact < .0);
+                if (block >= 20) {
+                    error.push_back(double(y) - exact);
+                }
+            }
+        }
+    }
+    return mismatches;
+}
+
+/* Mean and variance of the error and power of its low-frequency part, 
+ * taken as the average of 32 consecutive samples of each channel. */
+static void Statistics(const std::vector<double>& error, double& mean, double& variance, double& lowPower) {
+    mean = .0;
+    for (size_t n = 0; n < error.size(); n++) {
+        mean += error[n];
+    }
+    mean /= double(error.size());
+    variance = .0;
+    for (size_t n = 0; n < error.size(); n++) {
+        variance += (error[n] - mean) * (error[n] - mean);
+    }
+    variance /= double(error.size());
+    const size_t len = 32;
+    size_t count = 0;
+    lowPower = .0;
+    for (size_t c = 0; c < 2; c++) {
+        for (size_t start = c; start + 2 * len <= error.size(); start += 2 * len) {
+            double sum = .0;
+            for (size_t n = 0; n < len; n++) {
+                sum += error[start + 2 * n];
+            }
+            lowPower += (sum / double(len)) * (sum / double(len));
+            count++;
+        }
+    }
+    lowPower /= double(count);
+}
+
+int main() {
+    using std::chrono::high_resolution_clock;
+    using std::chrono::duration;
+
+    std::cout << std::fixed << std::setprecision(3);
+
+    size_t mismatches[4] = { 0 };
+    mismatches[0] += Compare<Limiter<float>, float, int16_t>(48000.0);
+    mismatches[0] += Compare<Limiter<float>, float, Int24>(48000.0);
+    mismatches[0] += Compare<Limiter<float>, float, int32_t>(48000.0);
+    mismatches[1] += Compare<Limiter<double>, double, int16_t>(48000.0);
+    mismatches[1] += Compare<Limiter<double>, double, Int24>(48000.0);
+    mismatches[1] += Compare<Limiter<double>, double, int32_t>(48000.0);
+    mismatches[2] += Compare<Limiter<double>, double, Int24>(192000.0);
+
+    /* The mixed-precision detection reads 32-bit samples with more 
+     * precision than the float conversion, hence 24-bit samples, which 
+     * float holds exactly, are used for the comparison. */
+    mismatches[2] += Compare<LimiterMixedPrecision<>, float, Int24>(192000.0);
+    mismatches[3] += Compare<Limiter<double, 8, 4, int16_t>, double, int16_t>(48000.0);
+    std::cout << "Mismatches against converted input, float: " << mismatches[0] << std::endl;
+    std::cout << "Mismatches against converted input, double: " << mismatches[1] << std::endl;
+    std::cout << "Mismatches against converted input, decimated detection: " << mismatches[2] << std::endl;
+    std::cout << "Mismatches against converted input, 16-bit delay storage: " << mismatches[3] << std::endl;
+
+    /* Execution time of one second of 24-bit input in blocks of 512
+     * samples, with and without the conversion pass. */
+    const size_t vecLen = 512;
+    const size_t blocks = 48000 / vecLen;
+    std::vector<Int24> pcm[2];
+    MakeNoise(pcm, vecLen * blocks);
+    std::vector<float> buffers[4];
+    for (size_t i = 0; i < 4; i++) {
+        buffers[i].resize(vecLen);
+    }
+    Limiter<float> limiter;
+    Setup(limiter, 48000.0);
+    double times[2] = { .0, .0 };
+    const size_t iterations = 50;
+    for (size_t i = 0; i < iterations; i++) {
+        for (size_t block = 0; block < blocks; block++) {
+            const Int24* xPcm[2] = { pcm[0].data() + block * vecLen, pcm[1].data() + block * vecLen };
+            float* xVec[2] = { buffers[0].data(), buffers[1].data() };
+            float* yVec[2] = { buffers[2].data(), buffers[3].data() };
+            auto t0 = high_resolution_clock::now();
+            Convert(xPcm[0], xVec[0], vecLen);
+            Convert(xPcm[1], xVec[1], vecLen);
+            limiter.Process(xVec, yVec, vecLen);
+            auto t1 = high_resolution_clock::now();
+            limiter.Process(xPcm, yVec, vecLen);
+            auto t2 = high_resolution_clock::now();
+            duration<double, std::micro> converted = t1 - t0;
+            duration<double, std::micro> direct = t2 - t1;
+            times[0] += converted.count();
+            times[1] += direct.count();
+        }
+    }
+    std::cout << "Execution time per second of 24-bit audio, conversion pass / direct input (microsecond): "
+        << times[0] / double(iterations) << " / " << times[1] / double(iterations) << std::endl;
+
+    /* Undithered integer outputs. */
+    std::vector<double> error;
+    size_t outputMismatches = 0;
+    outputMismatches += CompareOutput<Limiter<float>, float, int16_t>(48000.0, -1.0, false, noNoiseShaping, true, error);
+    outputMismatches += CompareOutput<Limiter<float>, float, Int24>(48000.0, -1.0, false, noNoiseShaping, true, error);
+    outputMismatches += CompareOutput<Limiter<double>, double, int32_t>(48000.0, -1.0, false, noNoiseShaping, true, error);
+    outputMismatches += CompareOutput<Limiter<double>, double, Int24>(192000.0, -1.0, false, noNoiseShaping, true, error);
+    outputMismatches += CompareOutput<Limiter<double, 8, 4, int16_t>, double, int16_t>(48000.0, -1.0, false, noNoiseShaping, true, error);
+    std::cout << "Mismatches of the undithered integer output against the rounded output: " << outputMismatches << std::endl;
+
+    /* Dithered and noise-shaped outputs. */
+    double mean;
+    double variance;
+    double lowPower[3];
+    const NoiseShaping shapings[3] = { noNoiseShaping, firstOrderNoiseShaping, eWeightedNoiseShaping };
+    const char* shapingNames[3] = { "none", "first order", "E-weighted" };
+    double maxError[3] = { .0, .0, .0 };
+    bool ditherPassed = true;
+    for (size_t i = 0; i < 3; i++) {
+        outputMismatches += CompareOutput<Limiter<double>, double, int16_t>(48000.0, -1.0, true, shapings[i], false, error);
+        Statistics(error, mean, variance, lowPower[i]);
+        for (size_t n = 0; n < error.size(); n++) {
+            maxError[i] = std::max(maxError[i], std::fabs(error[n]));
+        }
+        std::cout << "Dithered 16-bit output, noise shaping " << shapingNames[i] << ", error mean / variance / low-frequency power (LSB^2) / peak (LSB): " 
+            << mean << " / " << variance << " / " << lowPower[i] << " / " << maxError[i] << std::endl;
+        ditherPassed = ditherPassed && std::fabs(mean) < .02 && maxError[i] < 16.0;
+        if (i == 0) {
+            ditherPassed = ditherPassed && std::fabs(variance - .25) < .02 && maxError[i] < 1.5;
+        }
+    }
+    ditherPassed = ditherPassed && lowPower[1] < .5 * lowPower[0] && lowPower[2] < .5 * lowPower[0];
+
+    /* Output at full scale with noise shaping, where the rounding saturates;
+     * the samples must not wrap around and the errors must stay within the
+     * shaped noise. */
+    outputMismatches += CompareOutput<Limiter<float>, float, int16_t>(48000.0, .0, true, eWeightedNoiseShaping, false, error);
+    double saturatedError = .0;
+    for (size_t n = 0; n < error.size(); n++) {
+        saturatedError = std::max(saturatedError, std::fabs(error[n]));
+    }
+    std::cout << "Peak error of the saturated output (LSB): " << saturatedError << std::endl;
+    std::cout << "Mismatches between the planar and interleaved integer outputs: " << outputMismatches << std::endl;
+
+    /* Execution time of one second of 16-bit dithered output in blocks of 
+     * 512 samples, with a separate quantisation pass and fused. */
+    std::vector<int16_t> output[2] = { std::vector<int16_t>(vecLen), std::vector<int16_t>(vecLen) };
+    Dither<float> dither;
+    double outputTimes[2] = { .0, .0 };
+    for (size_t i = 0; i < iterations; i++) {
+        for (size_t block = 0; block < blocks; block++) {
+            const Int24* xPcm[2] = { pcm[0].data() + block * vecLen, pcm[1].data() + block * vecLen };
+            float* yVec[2] = { buffers[2].data(), buffers[3].data() };
+            int16_t* yPcm[2] = { output[0].data(), output[1].data() };
+            auto t0 = high_resolution_clock::now();
+            limiter.Process(xPcm, yVec, vecLen);
+            for (size_t c = 0; c < 2; c++) {
+                for (size_t n = 0; n < vecLen; n++) {
+                    yPcm[c][n] = dither.Quantise<int16_t>(yVec[c][n] * 32768.0f, dither.GetFrame() + uint32_t(n), c);
+                }
+            }
+            dither.Advance(vecLen);
+            auto t1 = high_resolution_clock::now();
+            limiter.Process(xPcm, yPcm, vecLen);
+            auto t2 = high_resolution_clock::now();
+            duration<double, std::micro> separate = t1 - t0;
+            duration<double, std::micro> fused = t2 - t1;
+            outputTimes[0] += separate.count();
+            outputTimes[1] += fused.count();
+        }
+    }
+    std::cout << "Execution time per second of 16-bit dithered output, separate / fused quantisation (microsecond): "
+        << outputTimes[0] / double(iterations) << " / " << outputTimes[1] / double(iterations) << std::endl;
+
+    bool passed = mismatches[0] == 0 && mismatches[1] == 0 && mismatches[2] == 0 && mismatches[3] == 0 && 
+        outputMismatches == 0 && ditherPassed && saturatedError < 16.0;
+    return passed ? 0 : 1;
+}
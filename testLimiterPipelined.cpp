@@ -0,0 +1,105 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <chrono>
+#include <vector>
+#include <ctime>
+#include <thread>
+#include "Generators.hpp"
+#include "LimiterPipelined.hpp"
+
+int main() {
+    typedef double real;
+    
+    using std::chrono::high_resolution_clock;
+    using std::chrono::duration;
+
+    std::cout << std::fixed << std::setprecision(17);
+
+    const size_t vecLen = 128;
+    const size_t blocks = 2000;
+    real SR = 48000.0;
+    real attTime = .01;
+    real holdTime = .0;
+    real relTime = .05;
+    real preGain = 12.0;
+    real threshold = -.3;
+
+    LimiterPipelined<real> pipelined(vecLen);
+    pipelined.SetSR(SR);
+    pipelined.SetAttTime(attTime);
+    pipelined.SetHoldTime(holdTime);
+    pipelined.SetRelTime(relTime);
+    pipelined.SetPreGain(preGain);
+    pipelined.SetThreshold(threshold);
+
+    /* Single-threaded reference of the pipeline: the gains of each block
+     * are applied at the next block. */
+    Limiter<real> reference;
+    reference.SetLookaheadSlack(vecLen);
+    reference.SetSR(SR);
+    reference.SetAttTime(attTime);
+    reference.SetHoldTime(holdTime);
+    reference.SetRelTime(relTime);
+    reference.SetPreGain(preGain);
+    reference.SetThreshold(threshold);
+    reference.Reset();
+    std::vector<real> previousGain(vecLen, 1.0);
+    std::vector<real> currentGain(vecLen);
+
+    std::vector<real> buffers[6];
+    for (size_t i = 0; i < 6; i++) {
+        buffers[i].resize(vecLen);
+    }
+    real* inVec[2] = { buffers[0].data(), buffers[1].data() };
+    real* outVec[2] = { buffers[2].data(), buffers[3].data() };
+    real* refVec[2] = { buffers[4].data(), buffers[5].data() };
+
+    Generators<real> generators;
+    real maxDifference = .0;
+    real peak = .0;
+    for (size_t block = 0; block < blocks; block++) {
+        generators.ProcessNoise(inVec[0], vecLen);
+        generators.ProcessNoise(inVec[1], vecLen);
+        pipelined.Process(inVec, outVec, vecLen);
+        reference.ProcessGain(inVec, currentGain.data(), vecLen);
+        reference.ApplyGain(inVec, previousGain.data(), refVec, vecLen);
+        previousGain.swap(currentGain);
+        for (size_t channel = 0; channel < 2; channel++) {
+            for (size_t n = 0; n < vecLen; n++) {
+                maxDifference = std::max<real>(maxDifference, 
+                    std::fabs(outVec[channel][n] - refVec[channel][n]));
+                if (block > 10) {
+                    peak = std::max<real>(peak, std::fabs(outVec[channel][n]));
+                }
+            }
+        }
+    }
+
+    /* Execution time measurement of the calling thread. */
+    double averageTime = 0;
+    for (size_t i = 0; i < blocks; i++) {
+        auto t0 = high_resolution_clock::now();
+        pipelined.Process(inVec, outVec, vecLen);
+        auto t1 = high_resolution_clock::now();
+        duration<double, std::micro> timeDuration = t1 - t0;
+        averageTime += timeDuration.count();
+        generators.ProcessNoise(inVec[0], vecLen);
+        generators.ProcessNoise(inVec[1], vecLen);
+    }
+    averageTime /= double(blocks);
+
+    /* The idle detector sleeps: the CPU time of the process over 200
+     * milliseconds without blocks should be negligible. */
+    std::clock_t c0 = std::clock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    double idleTime = 1000.0 * double(std::clock() - c0) / CLOCKS_PER_SEC;
+
+    std::cout << "Latency (samples): " << pipelined.GetLatency() << std::endl;
+    std::cout << "Max difference from the single-threaded pipeline: " << maxDifference << std::endl;
+    std::cout << "Output peak (dB): " << 20.0 * std::log10(peak) << std::endl;
+    std::cout << "Average execution time of the calling thread (microsecond): " << averageTime << std::endl;
+    std::cout << "CPU time of 200 idle milliseconds (millisecond): " << idleTime << std::endl;
+
+    return maxDifference == .0 && idleTime < 20.0 ? 0 : 1;
+}
@@ -0,0 +1,241 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <type_traits>
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include "Generators.hpp"
+#include "Limiter.hpp"
+
+/* Processes noise with instances attached to a shared preset and with 
+ * independently configured instances, also across parameter changes, and 
+ * compares the outputs. The cost of reconfiguring a bank of instances is 
+ * then measured for both approaches. */
+int main() {
+    typedef double real;
+
+    /* Instances can be assigned, e.g., to duplicate a configured limiter,
+     * in which case the copies share the coefficients until modified. */
+    static_assert(std::is_copy_assignable<Limiter<real>>::value, "Limiter must be assignable.");
+
+    using std::chrono::high_resolution_clock;
+    using std::chrono::duration;
+
+    std::cout << std::fixed << std::setprecision(17);
+
+    const size_t numberOfInstances = 8;
+    const size_t vecLen = 512;
+    const size_t blocks = 2000;
+    real SR = 48000.0;
+    real attTimes[2] = { .01, .005 };
+    real relTimes[2] = { .05, .2 };
+    real preGain = 12.0;
+    real threshold = -.3;
+
+    Limiter<real>::Preset preset;
+    preset.SetSR(SR);
+    preset.SetAttTime(attTimes[0]);
+    preset.SetHoldTime(.0);
+    preset.SetRelTime(relTimes[0]);
+    preset.SetPreGain(preGain);
+    preset.SetThreshold(threshold);
+
+    std::vector<std::unique_ptr<Limiter<real>>> shared;
+    std::vector<std::unique_ptr<Limiter<real>>> independent;
+    for (size_t i = 0; i < numberOfInstances; i++) {
+        shared.emplace_back(new Limiter<real>());
+        shared.back()->SetPreset(&preset);
+        shared.back()->Reset();
+        independent.emplace_back(new Limiter<real>());
+        Limiter<real>& l = *independent.back();
+        l.SetSR(SR);
+        l.SetAttTime(attTimes[0]);
+        l.SetHoldTime(.0);
+        l.SetRelTime(relTimes[0]);
+        l.SetPreGain(preGain);
+        l.SetThreshold(threshold);
+        l.Reset();
+    }
+
+    std::vector<real> buffers[6];
+    for (size_t i = 0; i < 6; i++) {
+        buffers[i].assign(vecLen, .0);
+    }
+    real* inVec[2] = { buffers[0].data(), buffers[1].data() };
+    real* outVec[2] = { buffers[2].data(), buffers[3].data() };
+    real* refVec[2] = { buffers[4].data(), buffers[5].data() };
+
+    Generators<real> generators;
+    real maxDifference = .0;
+    for (size_t block = 0; block < blocks; block++) {
+        if (block % 500 == 250) {
+            size_t setting = (block / 500) % 2 == 0;
+            preset.SetAttTime(attTimes[setting]);
+            preset.SetRelTime(relTimes[setting]);
+            for (auto& l : independent) {
+                l->SetAttTime(attTimes[setting]);
+                l->SetRelTime(relTimes[setting]);
+            }
+        }
+        for (size_t i = 0; i < numberOfInstances; i++) {
+            generators.ProcessNoise(inVec[0], vecLen);
+            generators.ProcessNoise(inVec[1], vecLen);
+            shared[i]->Process(inVec, outVec, vecLen);
+            independent[i]->Process(inVec, refVec, vecLen);
+            for (size_t channel = 0; channel < 2; channel++) {
+                for (size_t n = 0; n < vecLen; n++) {
+                    maxDifference = std::max<real>(maxDifference,
+                        std::fabs(outVec[channel][n] - refVec[channel][n]));
+                }
+            }
+        }
+    }
+
+    /* A setter called on an attached instance detaches it with a private 
+     * copy, which leaves the preset and the other instances unaltered. */
+    shared[0]->SetThreshold(-6.0);
+    bool detached = shared[0]->GetCoefficients().dBThreshold == real(-6.0) && 
+        shared[1]->GetCoefficients().dBThreshold == real(threshold) &&
+        preset.GetSettings().dBThreshold == real(threshold);
+
+    /* Reset clears the signal state only: instances reset after processing
+     * a sine and silence respectively produce the same output, as their
+     * smoothed parameters have settled to the same values, while a new 
+     * instance still ramps its parameters from zero. */
+    Limiter<real> processed;
+    Limiter<real> silent;
+    Limiter<real> fresh;
+    for (Limiter<real>* l : { &processed, &silent, &fresh }) {
+        l->SetSR(SR);
+        l->SetPreGain(preGain);
+        l->SetThreshold(threshold);
+    }
+    std::vector<real> sine[2];
+    std::vector<real> silence[2];
+    std::vector<real> resetOut[6];
+    const size_t resetLen = size_t(SR);
+    for (size_t channel = 0; channel < 2; channel++) {
+        sine[channel].resize(resetLen);
+        silence[channel].assign(resetLen, .0);
+        for (size_t n = 0; n < resetLen; n++) {
+            sine[channel][n] = std::sin(2.0 * M_PI * 440.0 * real(n) / SR);
+        }
+    }
+    for (size_t i = 0; i < 6; i++) {
+        resetOut[i].resize(resetLen);
+    }
+    real* sineVec[2] = { sine[0].data(), sine[1].data() };
+    real* silenceVec[2] = { silence[0].data(), silence[1].data() };
+    real* processedOut[2] = { resetOut[0].data(), resetOut[1].data() };
+    real* silentOut[2] = { resetOut[2].data(), resetOut[3].data() };
+    real* freshOut[2] = { resetOut[4].data(), resetOut[5].data() };
+    processed.Process(sineVec, processedOut, resetLen);
+    processed.Reset();
+    processed.Process(sineVec, processedOut, resetLen);
+    silent.Process(silenceVec, silentOut, resetLen);
+    silent.Reset();
+    silent.Process(sineVec, silentOut, resetLen);
+    fresh.Process(sineVec, freshOut, resetLen);
+    real resetDifference = .0;
+    real freshDifference = .0;
+    for (size_t channel = 0; channel < 2; channel++) {
+        for (size_t n = 0; n < resetLen; n++) {
+            resetDifference = std::max<real>(resetDifference,
+                std::fabs(processedOut[channel][n] - silentOut[channel][n]));
+            freshDifference = std::max<real>(freshDifference,
+                std::fabs(processedOut[channel][n] - freshOut[channel][n]));
+        }
+    }
+
+    /* Execution time of the reconfiguration of a bank of instances, where
+     * the instances attached to the preset pick up the new block as they 
+     * would at the start of their next Process call. */
+    const size_t bankSize = 1000;
+    const size_t iterations = 20;
+    std::vector<std::unique_ptr<Limiter<real>>> bank[2];
+    for (size_t i = 0; i < bankSize; i++) {
+        bank[0].emplace_back(new Limiter<real>());
+        bank[0].back()->SetPreset(&preset);
+        bank[1].emplace_back(new Limiter<real>());
+    }
+    double averageTime[2] = { 0, 0 };
+    for (size_t i = 0; i < iterations; i++) {
+        real attack = attTimes[i % 2];
+        real release = relTimes[i % 2];
+        auto t0 = high_resolution_clock::now();
+        preset.SetAttTime(attack);
+        preset.SetRelTime(release);
+        preset.SetThreshold(-1.0 - real(i % 2));
+        for (auto& l : bank[0]) {
+            l->UpdatePreset();
+        }
+        auto t1 = high_resolution_clock::now();
+        for (auto& l : bank[1]) {
+            l->SetAttTime(attack);
+            l->SetRelTime(release);
+            l->SetThreshold(-1.0 - real(i % 2));
+        }
+        auto t2 = high_resolution_clock::now();
+        duration<double, std::micro> presetDuration = t1 - t0;
+        duration<double, std::micro> independentDuration = t2 - t1;
+        averageTime[0] += presetDuration.count();
+        averageTime[1] += independentDuration.count();
+    }
+
+    /* A configuring thread publishes blocks while the attached instances
+     * pick them up in Process. Once the instances are detached, every 
+     * retired block can be deleted. */
+    std::atomic<bool> configuring(true);
+    std::thread configurator([&]() {
+        for (size_t i = 0; i < 20000; i++) {
+            preset.SetThreshold(-1.0 - real(i % 7));
+        }
+        configuring = false;
+    });
+    size_t concurrentBlocks = 0;
+    while (configuring || concurrentBlocks == 0) {
+        for (auto& l : shared) {
+            generators.ProcessNoise(inVec[0], vecLen);
+            generators.ProcessNoise(inVec[1], vecLen);
+            l->Process(inVec, outVec, vecLen);
+        }
+        concurrentBlocks++;
+    }
+    configurator.join();
+    size_t blocksInUse = preset.Reclaim();
+    for (auto& l : shared) {
+        l->SetPreset(nullptr);
+    }
+    for (auto& l : bank[0]) {
+        l->SetPreset(nullptr);
+    }
+    size_t blocksLeft = preset.Reclaim();
+
+    /* Restoring the default maximum attack time restores the default
+     * length of the delay buffers. */
+    Limiter<real> resized;
+    resized.SetMaxAttTime(2.0);
+    size_t resizedLen = resized.GetCoefficients().delayBufferLen;
+    resized.SetMaxAttTime(.0);
+    bool restored = resizedLen > Limiter<real>::Coefficients::defaultDelayBufferLen && 
+        resized.GetCoefficients().delayBufferLen == Limiter<real>::Coefficients::defaultDelayBufferLen;
+
+    std::cout << "Max difference between shared and independent settings: " << maxDifference << std::endl;
+    std::cout << "Setter detaches the instance from the preset: " << (detached ? "yes" : "no") << std::endl;
+    std::cout << "Max difference between instances reset after a sine and after silence: " << resetDifference << std::endl;
+    std::cout << "Max difference between a reset and a new instance: " << freshDifference << std::endl;
+    std::cout << "Retired blocks in use while attached: " << blocksInUse << ", after detaching: " << blocksLeft << std::endl;
+    std::cout << "Default delay buffers restored: " << (restored ? "yes" : "no") << std::endl;
+    std::cout << "Size of the shared coefficients (byte): " << sizeof(Limiter<real>::Coefficients) << std::endl;
+    std::cout << "Average reconfiguration time of " << bankSize << " instances with a preset (microsecond): "
+        << averageTime[0] / double(iterations) << std::endl;
+    std::cout << "Average reconfiguration time of " << bankSize << " independent instances (microsecond): "
+        << averageTime[1] / double(iterations) << std::endl;
+
+    return maxDifference == .0 && detached && resetDifference == .0 && freshDifference > .0 &&
+        blocksLeft == 0 && restored ? 0 : 1;
+}
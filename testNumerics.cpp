@@ -0,0 +1,153 @@
+/*******************************************************************************
+ *
+ * Reproducibility test for the numerics policies.
+ *
+ * The program hashes the output of limiters with StrictNumerics and
+ * compares it with reference hashes, and it checks that FastNumerics stays
+ * close to the strict output, also for dithered 16-bit output, where the
+ * policy covers the scaling and the dither sum before quantisation. For the
+ * strict output to be the same across
+ * instruction sets, build it for each of them, e.g.:
+ *
+ *   g++ -O3 -std=gnu++17 -march=x86-64 testNumerics.cpp -o testNumerics
+ *   g++ -O3 -std=gnu++17 -march=haswell testNumerics.cpp -o testNumerics
+ *   g++ -O3 -std=gnu++17 -march=skylake-avx512 testNumerics.cpp -o testNumerics
+ *
+ * Each build must print the same hashes and return 0. Note that GNU mode
+ * contracts products and additions into fused multiply-adds by default on
+ * FMA targets, which StrictNumerics prevents. The reference hashes were
+ * computed with glibc's exp and pow.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <chrono>
+#include <vector>
+#include "Generators.hpp"
+#include "Limiter.hpp"
+
+/* Renders noise through a limiter with full-rate detection at 48 kHz and
+ * decimated detection at 192 kHz, with varying block sizes and an attack
+ * change that crossfades the delay lines, and returns the FNV-1a hash of
+ * the output samples and the execution time in microseconds. The output
+ * is in the sample type, dithered if it is an integer. */
+template<typename real, typename numerics, typename sample = real>
+static uint64_t Render(std::vector<double>& output, double& time) {
+    using std::chrono::high_resolution_clock;
+    using std::chrono::duration;
+
+    const size_t maxVecLen = 1000;
+    std::vector<real> inBuffers[2];
+    std::vector<sample> outBuffers[2];
+    for (size_t i = 0; i < 2; i++) {
+        inBuffers[i].resize(maxVecLen);
+        outBuffers[i].resize(maxVecLen);
+    }
+    real* inVec[2] = { inBuffers[0].data(), inBuffers[1].data() };
+    sample* outVec[2] = { outBuffers[0].data(), outBuffers[1].data() };
+    uint64_t hash = 14695981039346656037ull;
+    output.clear();
+    time = .0;
+    const real rates[2] = { 48000.0, 192000.0 };
+    for (size_t r = 0; r < 2; r++) {
+        Generators<real> generators;
+        Limiter<real, 8, 4, real, std::allocator<real>, real, numerics> limiter;
+        limiter.SetSR(rates[r]);
+        limiter.SetAttTime(.004);
+        limiter.SetHoldTime(.002);
+        limiter.SetRelTime(.08);
+        limiter.SetPreGain(20.0);
+        limiter.SetThreshold(-1.0);
+        limiter.SetDitherSeed(12345);
+        limiter.Reset();
+        for (size_t block = 0; block < 400; block++) {
+            size_t vecLen = 1 + (block * 37) % maxVecLen;
+            if (block == 200) {
+                limiter.SetAttTime(.006);
+            }
+            generators.ProcessNoise(inVec[0], vecLen);
+            generators.ProcessNoise(inVec[1], vecLen);
+            auto t0 = high_resolution_clock::now();
+            limiter.Process(inVec, outVec, vecLen);
+            auto t1 = high_resolution_clock::now();
+            duration<double, std::micro> timeDuration = t1 - t0;
+            time += timeDuration.count();
+            for (size_t n = 0; n < vecLen; n++) {
+                for (size_t c = 0; c < 2; c++) {
+                    output.push_back(outVec[c][n]);
+                    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&outVec[c][n]);
+                    for (size_t k = 0; k < sizeof(sample); k++) {
+                        hash = (hash ^ bytes[k]) * 1099511628211ull;
+                    }
+                }
+            }
+        }
+    }
+    return hash;
+}
+
+/* Compares the strict and fast outputs and prints the results. */
+template<typename real>
+static bool Check(const char* name, uint64_t referenceHash, double tolerance) {
+    std::vector<double> strictOutput;
+    std::vector<double> fastOutput;
+    double strictTime;
+    double fastTime;
+    uint64_t hash = Render<real, StrictNumerics>(strictOutput, strictTime);
+    Render<real, FastNumerics>(fastOutput, fastTime);
+
+    /* The error is relative to the strict output above full scale, which 
+     * is reached while the envelope settles after the reset. */
+    double maxError = .0;
+    for (size_t n = 0; n < strictOutput.size(); n++) {
+        double error = std::fabs(fastOutput[n] - strictOutput[n]) / 
+            std::max<double>(1.0, std::fabs(strictOutput[n]));
+        maxError = std::max(maxError, error);
+    }
+    std::cout << name << " strict output hash: " << std::hex << hash << std::dec
+        << (hash == referenceHash ? " (matches the reference)" : " (DIFFERS from the reference)") << std::endl;
+    std::cout << name << " maximum relative difference between fast and strict output: " << maxError << std::endl;
+    std::cout << name << " execution time, strict / fast (microsecond): "
+        << strictTime << " / " << fastTime << std::endl;
+    return hash == referenceHash && maxError < tolerance;
+}
+
+/* Compares the strict and fast dithered 16-bit outputs, which may only 
+ * differ by one LSB where the unrounded values fall on either side of a
+ * rounding boundary. */
+template<typename real>
+static bool CheckPcm(const char* name, uint64_t referenceHash) {
+    std::vector<double> strictOutput;
+    std::vector<double> fastOutput;
+    double strictTime;
+    double fastTime;
+    uint64_t hash = Render<real, StrictNumerics, int16_t>(strictOutput, strictTime);
+    Render<real, FastNumerics, int16_t>(fastOutput, fastTime);
+    double maxError = .0;
+    size_t mismatches = 0;
+    for (size_t n = 0; n < strictOutput.size(); n++) {
+        double error = std::fabs(fastOutput[n] - strictOutput[n]);
+        maxError = std::max(maxError, error);
+        mismatches += error > .0;
+    }
+    std::cout << name << " 16-bit strict output hash: " << std::hex << hash << std::dec
+        << (hash == referenceHash ? " (matches the reference)" : " (DIFFERS from the reference)") << std::endl;
+    std::cout << name << " 16-bit samples differing between fast and strict output: " << mismatches
+        << " of " << strictOutput.size() << ", by at most " << maxError << " LSB" << std::endl;
+    std::cout << name << " 16-bit execution time, strict / fast (microsecond): "
+        << strictTime << " / " << fastTime << std::endl;
+    return hash == referenceHash && maxError <= 1.0;
+}
+
+int main() {
+    std::cout << std::setprecision(6);
+
+    bool passed = Check<double>("Double", 0x86801d29599c03f7ull, 1e-9);
+    passed = Check<float>("Float", 0x2b2ae0e5595c9e3bull, 1e-4) && passed;
+    passed = CheckPcm<float>("Float", 0x17c19c217b018061ull) && passed;
+    return passed ? 0 : 1;
+}
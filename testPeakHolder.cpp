@@ -1,10 +1,10 @@
 #include <iostream>
-#include <fstream>
 #include <iomanip>
 #include <cstdint>
 #include <chrono>
 #include "Generators.hpp"
 #include "PeakHoldCascade.hpp"
+#include "BinaryDump.hpp"
 
 int main() {
     typedef double real;
@@ -14,8 +14,6 @@ int main() {
     using std::chrono::duration;
     using std::chrono::microseconds;
 
-    std::ofstream csvFile("PeakHoldCascade.csv", std::ofstream::trunc);
-    csvFile << std::fixed << std::setprecision(17);
     std::cout << std::fixed << std::setprecision(17);
 
     const int vecLen = 4096;
@@ -33,12 +31,43 @@ int main() {
     peakHolder.SetHoldTime(holdTime);
     peakHolder.Reset();
 
-    /* Fill input and output vectors to generate a CSV file. */
+    /* Fill input and output vectors to generate an NPY file. */
     generators.ProcessNoise(inVec, vecLen);
     peakHolder.Process(inVec, outVec, vecLen);
-    for (size_t i = 0; i < vecLen; i++) {
-		csvFile << i << "," << inVec[i] << "," << outVec[i] << "\n";
-	}
+    BinaryDump<real> dump;
+    dump.Open("PeakHoldCascade.npy", 2);
+    const real* columns[2] = { inVec, outVec };
+    dump.Write(columns, vecLen);
+    dump.Close();
+
+    /* The compact timer types must give the same output as size_t, while
+     * float peaks may only differ by the float rounding of the input. */
+    PeakHoldCascade<8, real, uint32_t> peakHolder32(SR, holdTime);
+    PeakHoldCascade<8, real, uint16_t> peakHolder16(SR, holdTime);
+    PeakHoldCascade<8, real, uint16_t, float> peakHolderFloat(SR, holdTime);
+    real outVec32[vecLen] = { 0 };
+    real outVec16[vecLen] = { 0 };
+    real outVecFloat[vecLen] = { 0 };
+    size_t timerMismatches = 0;
+    real maxFloatError = 0;
+    peakHolder.Reset();
+    for (size_t block = 0; block < 16; block++) {
+        generators.ProcessNoise(inVec, vecLen);
+        peakHolder.Process(inVec, outVec, vecLen);
+        peakHolder32.Process(inVec, outVec32, vecLen);
+        peakHolder16.Process(inVec, outVec16, vecLen);
+        peakHolderFloat.Process(inVec, outVecFloat, vecLen);
+        for (size_t i = 0; i < vecLen; i++) {
+            timerMismatches += outVec32[i] != outVec[i] || outVec16[i] != outVec[i];
+            maxFloatError = std::max(maxFloatError, std::fabs(outVecFloat[i] - outVec[i]));
+        }
+    }
+    std::cout << "Timer type mismatches (uint32_t, uint16_t): " << timerMismatches << std::endl;
+    std::cout << "Maximum error with float peaks: " << maxFloatError << std::endl;
+    if (timerMismatches != 0 || maxFloatError > std::numeric_limits<float>::epsilon()) {
+        std::cout << "Compact state types FAILED." << std::endl;
+        return 1;
+    }
 
     /* Execution time measurement variables. */
     double averageTime = 0;
@@ -80,8 +109,7 @@ int main() {
     std::cout << "Iterations: " << iterations << std::endl;
     std::cout << "Average execution time (microsecond): " << averageTime << std::endl;
     std::cout << "Relative standard deviation (%): " << (standardDeviation * 100.0) << std::endl;
-    std::cout << "The program has generated the file PeakHoldCascade.csv containing one vector of input and output samples." << std::endl;
+    std::cout << "The program has generated the file PeakHoldCascade.npy containing one vector of input and output samples." << std::endl;
 
-    csvFile.close();
     return 0;
 }
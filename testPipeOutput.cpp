@@ -0,0 +1,98 @@
+/*******************************************************************************
+ *
+ * Test of the PipeOutput class.
+ *
+ * A writer thread commits a counting sequence to a pipe in small chunks,
+ * e.g., 64 stereo frames of 32-bit samples as limitPipe produces them from
+ * short reads, and flushes a partial buffer every now and then. The reader
+ * starts late and reads slowly in small pieces, so that the writer keeps
+ * blocking on a full pipe and the buffer ring wraps around many times
+ * while the pipe still references spliced pages. The sequence read back
+ * must be intact.
+ *
+ * Copyright (c) 2022 Dario Sanfilippo - sanfilippodario@gmail.com
+ *
+ * ****************************************************************************/
+
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "PipeOutput.hpp"
+
+int main() {
+    const size_t chunkWords = 128; // 64 stereo frames.
+    const size_t numberOfChunks = 16384; // 8 MiB in total.
+    const size_t bufferBytes = 16384;
+
+    int fds[2];
+    if (pipe(fds) != 0) {
+        std::cout << "Cannot create a pipe." << std::endl;
+        return 1;
+    }
+
+    PipeOutput output;
+    output.Init(fds[1], bufferBytes);
+    bool splicing = output.IsSplicing();
+    bool writeOk = true;
+    std::thread writer([&]() {
+        uint32_t counter = 0;
+        for (size_t chunk = 0; chunk < numberOfChunks && writeOk; chunk++) {
+            size_t words = chunkWords;
+            while (words > 0 && writeOk) {
+                size_t space;
+                uint8_t* y = output.GetSpace(space);
+                size_t len = std::min(words, space / sizeof(uint32_t));
+                for (size_t i = 0; i < len; i++) {
+                    std::memcpy(y + i * sizeof(uint32_t), &counter, sizeof(uint32_t));
+                    counter++;
+                }
+                writeOk = output.Commit(len * sizeof(uint32_t));
+                words -= len;
+            }
+            if (chunk % 397 == 0) {
+                writeOk = writeOk && output.Flush();
+            }
+        }
+        writeOk = writeOk && output.Flush();
+        close(fds[1]);
+    });
+
+    /* Slow reader. */
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    std::vector<uint8_t> piece(4096);
+    std::vector<uint8_t> carry;
+    uint32_t expected = 0;
+    size_t mismatches = 0;
+    size_t reads = 0;
+    while (true) {
+        ssize_t result = read(fds[0], piece.data(), piece.size());
+        if (result <= 0) {
+            break;
+        }
+        carry.insert(carry.end(), piece.begin(), piece.begin() + result);
+        size_t words = carry.size() / sizeof(uint32_t);
+        for (size_t i = 0; i < words; i++) {
+            uint32_t value;
+            std::memcpy(&value, carry.data() + i * sizeof(uint32_t), sizeof(uint32_t));
+            mismatches += value != expected;
+            expected++;
+        }
+        carry.erase(carry.begin(), carry.begin() + words * sizeof(uint32_t));
+        if (++reads % 64 == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    writer.join();
+    close(fds[0]);
+
+    const size_t total = numberOfChunks * chunkWords;
+    std::cout << "Splicing: " << (splicing ? "yes" : "no") << std::endl;
+    std::cout << "Words read: " << expected << " of " << total << std::endl;
+    std::cout << "Mismatching words: " << mismatches << std::endl;
+
+    return writeOk && expected == total && carry.empty() && mismatches == 0 ? 0 : 1;
+}